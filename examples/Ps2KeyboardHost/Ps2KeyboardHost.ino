@@ -24,7 +24,6 @@ typedef ps2::SimpleDiagnostics<254> Diagnostics_;
 static Diagnostics_ diagnostics;
 static ps2::AnsiTranslator<Diagnostics_> keyMapping(diagnostics);
 static ps2::Keyboard<3,2,1, Diagnostics_> ps2Keyboard(diagnostics);
-static ps2::KeyboardLeds lastLedSent = ps2::KeyboardLeds::none;
 
 void setup() {
     ps2Keyboard.begin();
@@ -37,7 +36,6 @@ void setup() {
     diagnostics.reset();
 
     ps2Keyboard.sendLedStatus(ps2::KeyboardLeds::numLock);
-    lastLedSent = ps2::KeyboardLeds::numLock;
 }
 
 void loop() {
@@ -67,9 +65,7 @@ void loop() {
         ps2::KeyboardLeds newLeds =
               (keyMapping.getCapsLock() ? ps2::KeyboardLeds::capsLock : ps2::KeyboardLeds::none)
             | (keyMapping.getNumLock() ? ps2::KeyboardLeds::numLock : ps2::KeyboardLeds::none);
-        if (newLeds != lastLedSent) {
-            ps2Keyboard.sendLedStatus(newLeds);
-            lastLedSent = newLeds;
-        }
+        // Nothing is sent unless the LEDs actually change.
+        ps2Keyboard.sendLedStatus(newLeds);
     }
 }
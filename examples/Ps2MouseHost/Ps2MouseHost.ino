@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#include "ps2_Mouse.h"
+#include "ps2_SimpleDiagnostics.h"
+
+typedef ps2::SimpleDiagnostics<254> Diagnostics_;
+static Diagnostics_ diagnostics;
+static ps2::Mouse<3,2,16, Diagnostics_> ps2Mouse(diagnostics);
+
+static uint32_t lastPacketMilliseconds;
+
+static void startMouse() {
+    while (!ps2Mouse.initialize(100)) {
+        Serial.println("No mouse, or it didn't respond; trying again.");
+        delay(1000);
+    }
+    Serial.print(ps2Mouse.hasFiveButtons() ? "5-button wheel mouse" : ps2Mouse.hasWheel() ? "Wheel mouse" : "Mouse");
+    Serial.println(" ready.");
+    lastPacketMilliseconds = millis();
+}
+
+void setup() {
+    Serial.begin(115200);
+    ps2Mouse.begin();
+    startMouse();
+}
+
+void loop() {
+    diagnostics.setLedIndicator<LED_BUILTIN_RX>();
+
+    ps2::MousePacket packet;
+    while (ps2Mouse.readPacket(packet)) {
+        lastPacketMilliseconds = millis();
+        Serial.print("x=");
+        Serial.print(packet.x);
+        Serial.print(" y=");
+        Serial.print(packet.y);
+        Serial.print(" wheel=");
+        Serial.print(packet.wheel);
+        Serial.print(" buttons=");
+        Serial.println((uint8_t)packet.buttons, BIN);
+    }
+
+    // A mouse that's been unplugged and plugged back in stays quiet until it's set up again.
+    //  A mouse that's sitting still is quiet too, so this waits a good while before assuming
+    //  the worst; setting it up again takes about half a second.
+    if (millis() - lastPacketMilliseconds > 10000) {
+        startMouse();
+    }
+}
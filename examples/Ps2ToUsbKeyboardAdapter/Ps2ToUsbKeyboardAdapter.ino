@@ -43,7 +43,6 @@ public:
 static Diagnostics diagnostics;
 static ps2::UsbTranslator<Diagnostics> keyMapping(diagnostics);
 static ps2::Keyboard<3,2,1, Diagnostics> ps2Keyboard(diagnostics);
-static ps2::UsbKeyboardLeds ledValueLastSentToPs2 = ps2::UsbKeyboardLeds::none;
 
 // This example demonstrates how to create keyboard translations (in this case, how the caps lock
 //  and other modifier keys are laid out).  The example reads switch1Pin to toggle whether this
@@ -107,12 +106,10 @@ static KeyboardKeycode capsLockToControl(KeyboardKeycode usbKeystroke)
 
 
 void loop() {
+    // This only sends anything if the LEDs changed, and it doesn't wait for the keyboard - the
+    //  command goes out from readScanCode.
     ps2::UsbKeyboardLeds newLedState = (ps2::UsbKeyboardLeds)BootKeyboard.getLeds();
-    if (newLedState != ledValueLastSentToPs2)
-    {
-        ps2Keyboard.sendLedStatus(keyMapping.translateLeds(newLedState));
-        ledValueLastSentToPs2 = newLedState;
-    }
+    ps2Keyboard.queueLedStatus(keyMapping.translateLeds(newLedState));
 
     bool isRemapMode = digitalRead(switch1Pin) != 0;
 
@@ -121,7 +118,10 @@ void loop() {
     diagnostics.setLedIndicator<LED_BUILTIN_RX, ps2::DiagnosticsLedBlink::blinkOnError>();
 
     ps2::KeyboardOutput scanCode = ps2Keyboard.readScanCode();
-    if (scanCode != ps2::KeyboardOutput::none && scanCode != ps2::KeyboardOutput::garbled)
+    if (scanCode == ps2::KeyboardOutput::garbled) {
+        keyMapping.reset();
+    }
+    else if (scanCode != ps2::KeyboardOutput::none)
     {
         ps2::UsbKeyAction action = keyMapping.translatePs2Keycode(scanCode);
         KeyboardKeycode hidCode = (KeyboardKeycode)action.hidCode;
@@ -16,8 +16,11 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
+#include <util/crc16.h>
 #include "ps2_Keyboard.h"
 #include "ps2_NeutralTranslator.h"
+#include "ps2_UsbTranslator.h"
+#include "ps2_AnsiTranslator.h"
 #include "ps2_SimpleDiagnostics.h"
 
 // This example is really a testbed for the features of PS2 keyboards and this library.
@@ -30,7 +33,8 @@ USA
 //
 // If you need to submit a change to the library, please use this program to shake it down
 // before creating a pull request.  Typing "qwer" is a good quick test to ensure that bidirectional
-// communications work.  "t" is a must if you change the buffer code.  But a good shakedown
+// communications work.  "t" is a must if you change the buffer code, and "y" if you change a
+// translator.  But a good shakedown
 // would include using all the facilities in this example and making new ones if you've got
 // a new scenario.
 
@@ -58,7 +62,7 @@ static ps2::NeutralTranslator translator;
 
 void waitForUnmake(ps2::KeyboardOutput key)
 {
-    long stopAtMs = millis() + 1000;
+    unsigned long stopAtMs = millis() + 1000;
 
     bool gotUnmake = false;
     bool stop = false;
@@ -147,6 +151,119 @@ static void testQueue()
     }
 }
 
+// testTranslators runs every set-2 sequence through each translator - each byte on its own, with
+//  an F0 (break) prefix, with E0 (extended), with E0 F0, plus Pause and Print Screen - and compares
+//  a checksum of the results with the checksums below.  The AnsiTranslator is run 16 times, once
+//  for each combination of shift, ctrl, caps lock and num lock.  A fresh translator is used for
+//  each sequence, so one sequence can't affect the next.
+//
+// If you change what a translator produces on purpose, run the test and paste the new checksums
+//  it prints in here.  If you're only making it faster, they had better not change.
+static const uint16_t expectedUsbChecksum = 0x4b87;
+static const uint16_t expectedAnsiChecksums[16] = {
+    0xa1cc, 0xe3bc, 0x167d, 0xe3bc, 0x0ca2, 0x4ed2, 0x0ca2, 0xf963,
+    0xd141, 0xb545, 0x66f0, 0xb545, 0x7c2f, 0x182b, 0x7c2f, 0xaf9a,
+};
+static const uint16_t expectedNeutralChecksum = 0xe23c;
+
+static const uint16_t numTranslatorTestSequences = 4 * 256 + 2;
+
+// Gets the n'th test sequence and returns its length.
+static uint8_t getTranslatorTestSequence(uint16_t n, ps2::KeyboardOutput *sequence)
+{
+    static const byte pause[] = { 0xe1, 0x14, 0x77, 0xe1, 0xf0, 0x14, 0xf0, 0x77 };
+    static const byte printScreen[] = { 0xe0, 0x12, 0xe0, 0x7c, 0xe0, 0xf0, 0x7c, 0xe0, 0xf0, 0x12 };
+    const byte *source;
+    uint8_t length;
+    byte prefixed[3];
+    if (n == 4 * 256) {
+        source = pause;
+        length = sizeof(pause);
+    }
+    else if (n == 4 * 256 + 1) {
+        source = printScreen;
+        length = sizeof(printScreen);
+    }
+    else {
+        length = 0;
+        if (n & 0x200) {
+            prefixed[length++] = 0xe0;
+        }
+        if (n & 0x100) {
+            prefixed[length++] = 0xf0;
+        }
+        prefixed[length++] = n & 0xff;
+        source = prefixed;
+    }
+    for (uint8_t i = 0; i < length; ++i) {
+        sequence[i] = (ps2::KeyboardOutput)source[i];
+    }
+    return length;
+}
+
+static void checkTranslatorChecksum(const char *name, int8_t variant, uint16_t actual, uint16_t expected)
+{
+    if (actual != expected) {
+        Serial.print("testTranslators: ");
+        Serial.print(name);
+        if (variant >= 0) {
+            Serial.print("[");
+            Serial.print(variant);
+            Serial.print("]");
+        }
+        Serial.print(" checksum 0x");
+        Serial.print(actual, HEX);
+        Serial.print(", expected 0x");
+        Serial.println(expected, HEX);
+    }
+}
+
+static void testTranslators()
+{
+    ps2::NullDiagnostics nullDiagnostics;
+    ps2::KeyboardOutput sequence[10];
+    uint16_t usbChecksum = 0;
+    uint16_t ansiChecksums[16] = {};
+    uint16_t neutralChecksum = 0;
+
+    for (uint16_t n = 0; n < numTranslatorTestSequences; ++n) {
+        uint8_t length = getTranslatorTestSequence(n, sequence);
+
+        ps2::UsbTranslator<> usbTranslator(nullDiagnostics);
+        ps2::NeutralTranslator neutralTranslator;
+        for (uint8_t i = 0; i < length; ++i) {
+            ps2::UsbKeyAction action = usbTranslator.translatePs2Keycode(sequence[i]);
+            usbChecksum = _crc16_update(usbChecksum, action.hidCode);
+            usbChecksum = _crc16_update(usbChecksum, (uint8_t)action.gesture);
+
+            uint16_t keyCode = neutralTranslator.translatePs2Keycode(sequence[i]);
+            neutralChecksum = _crc16_update(neutralChecksum, keyCode & 0xff);
+            neutralChecksum = _crc16_update(neutralChecksum, keyCode >> 8);
+        }
+
+        for (uint8_t state = 0; state < 16; ++state) {
+            ps2::AnsiTranslator<> ansiTranslator(nullDiagnostics);
+            if (state & 1) {
+                ansiTranslator.translatePs2Keycode(ps2::KeyboardOutput::sc2_leftShift);
+            }
+            if (state & 2) {
+                ansiTranslator.translatePs2Keycode(ps2::KeyboardOutput::sc2_leftCtrl);
+            }
+            ansiTranslator.setCapsLock(state & 4);
+            ansiTranslator.setNumLock(state & 8);
+            for (uint8_t i = 0; i < length; ++i) {
+                ansiChecksums[state] = _crc16_update(ansiChecksums[state], ansiTranslator.translatePs2Keycode(sequence[i]));
+            }
+        }
+    }
+
+    checkTranslatorChecksum("UsbTranslator", -1, usbChecksum, expectedUsbChecksum);
+    for (uint8_t state = 0; state < 16; ++state) {
+        checkTranslatorChecksum("AnsiTranslator", state, ansiChecksums[state], expectedAnsiChecksums[state]);
+    }
+    checkTranslatorChecksum("NeutralTranslator", -1, neutralChecksum, expectedNeutralChecksum);
+}
+
 static byte f1_f4[4] = { 0x07, 0x0f, 0x17, 0x1f };
 static byte f7_f8[4] = { 0x37, 0x3f };
 
@@ -286,6 +403,29 @@ void loop() {
                 Serial.println("testQueue done");
                 break;
             }
+            case ps2::KeyboardOutput::sc2_y: {
+                waitForUnmake(scanCode);
+                testTranslators();
+                Serial.println("testTranslators done");
+                break;
+            }
+            case ps2::KeyboardOutput::sc2_p: {
+                waitForUnmake(scanCode);
+                // The same questions the reset switch asks, but in the background.
+                unsigned long startMs = millis();
+                ps2Keyboard.enableProbing();
+                while (ps2Keyboard.isProbing() && millis() - startMs < 2000) {
+                    ps2Keyboard.readScanCode();
+                }
+                const ps2::DeviceProfile &profile = ps2Keyboard.getDeviceProfile();
+                Serial.print("probe took ");
+                Serial.print(millis() - startMs);
+                Serial.print("ms, id: ");
+                Serial.print(profile.id, HEX);
+                Serial.print(", scan code sets: ");
+                Serial.println(profile.scanCodeSets, BIN);
+                break;
+            }
             case ps2::KeyboardOutput::sc2_tab: {
                 waitForUnmake(scanCode);
                 diagnostics.sendReport(Serial);
@@ -310,7 +450,10 @@ void loop() {
                 diagnostics.sendReport(Serial);
                 diagnostics.reset();
                 Serial.println();
+                break;
             }
+            default:
+                break;
         }
 
         ps2::KeyCode translated = translator.translatePs2Keycode(scanCode);
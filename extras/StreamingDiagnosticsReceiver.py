@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+# USA
+
+"""Decodes the event stream written by ps2::StreamingDiagnostics.
+
+Usage:
+    StreamingDiagnosticsReceiver.py /dev/ttyACM0 [baud]    (needs pyserial)
+    StreamingDiagnosticsReceiver.py capture.bin             (a file saved earlier)
+    StreamingDiagnosticsReceiver.py -                       (standard input)
+
+Each event is printed on its own line.  Every few seconds, and at the end, it prints
+the number of events per second, the number of events the device reported as lost and
+the number of frames that failed their CRC.  With --summary first, it prints only that.
+"""
+
+import sys
+import time
+
+FRAME_END = 0xC0
+FRAME_ESCAPE = 0xDB
+ESCAPED_FRAME_END = 0xDC
+ESCAPED_FRAME_ESCAPE = 0xDD
+
+# Keep these in sync with ps2::DiagnosticsCode in ps2_SimpleDiagnostics.h
+EVENT_NAMES = {
+    0: "packetDidNotStartWithZero",
+    1: "parityError",
+    2: "packetDidNotEndWithOne",
+    3: "packetIncomplete",
+    4: "sendFrameError",
+    5: "bufferOverflow",
+    6: "incorrectResponse",
+    7: "noResponse",
+    8: "noTranslationForKey",
+    9: "startupFailure",
+    16: "sentByte",
+    17: "receivedByte",
+    18: "pause",
+    19: "clockLineGlitch",
+    20: "eventsLost",
+    21: "sendRetried",
+}
+EVENTS_LOST = 20
+
+
+def crc8_ibutton(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8C if crc & 1 else crc >> 1
+    return crc
+
+
+class Decoder:
+    """Turns a byte stream into (code, data) events, resynchronizing at each frame end."""
+
+    def __init__(self):
+        self.frame = bytearray()
+        self.escaped = False
+        self.in_frame = False
+        self.bad_frames = 0
+
+    def feed(self, chunk):
+        for b in chunk:
+            if b == FRAME_END:
+                if self.in_frame and self.frame:
+                    event = self._decode(bytes(self.frame))
+                    if event is not None:
+                        yield event
+                self.frame.clear()
+                self.escaped = False
+                self.in_frame = True
+            elif not self.in_frame:
+                continue  # Joined mid-frame; wait for the next delimiter.
+            elif self.escaped:
+                self.escaped = False
+                if b == ESCAPED_FRAME_END:
+                    self.frame.append(FRAME_END)
+                elif b == ESCAPED_FRAME_ESCAPE:
+                    self.frame.append(FRAME_ESCAPE)
+                else:
+                    self.bad_frames += 1
+                    self.in_frame = False
+            elif b == FRAME_ESCAPE:
+                self.escaped = True
+            else:
+                self.frame.append(b)
+
+    def _decode(self, frame):
+        header = frame[0]
+        num_data = header & 0x3
+        if len(frame) != num_data + 2 or crc8_ibutton(frame[:-1]) != frame[-1]:
+            self.bad_frames += 1
+            return None
+        return header >> 2, frame[1:-1]
+
+
+def open_source(args):
+    if args[0] == "-":
+        return sys.stdin.buffer
+    try:
+        return open(args[0], "rb")
+    except OSError:
+        import serial  # pyserial; only needed for a live port
+        baud = int(args[1]) if len(args) > 1 else 1000000
+        return serial.Serial(args[0], baud, timeout=0.1)
+
+
+def main(args):
+    is_summary_only = bool(args) and args[0] == "--summary"
+    if is_summary_only:
+        args = args[1:]
+    if not args:
+        print(__doc__)
+        return 2
+
+    source = open_source(args)
+    decoder = Decoder()
+    num_events = 0
+    num_lost = 0
+    start = time.monotonic()
+    last_summary = start
+
+    def summary():
+        elapsed = max(time.monotonic() - start, 1e-6)
+        print("# %d events in %.1fs (%.0f/s), %d lost on the device, %d bad frames"
+              % (num_events, elapsed, num_events / elapsed, num_lost, decoder.bad_frames))
+
+    try:
+        while True:
+            chunk = source.read(4096)
+            if not chunk:
+                if hasattr(source, "in_waiting"):
+                    continue  # Live port with nothing to say right now
+                break
+            for code, data in decoder.feed(chunk):
+                num_events += 1
+                if code == EVENTS_LOST:
+                    num_lost += (data[0] << 8) | data[1]
+                if not is_summary_only:
+                    name = EVENT_NAMES.get(code, "app%d" % code)
+                    print(name, " ".join("%02x" % b for b in data))
+            if time.monotonic() - last_summary > 5:
+                summary()
+                last_summary = time.monotonic()
+    except KeyboardInterrupt:
+        pass
+    summary()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,329 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Firmware for the cycle-count benchmarks in RunBench.py.  It isn't a sketch you'd upload:  it
+//  has its own main (so nothing but the code being measured runs), it drives the data pin
+//  itself, and it reports through registers that only mean something to CycleCounter, which
+//  runs it under simavr:
+//
+//   - Each character written to GPIOR0 is printed.  Lines are "begin <name>" and "end".
+//   - Writing 1 to GPIOR1 starts a sample and 2 ends it.  CycleCounter notes the cycle count
+//     at each, so a sample is exact, down to the cycle.
+//
+//  PS2_BENCH picks the benchmark (RunBench.py lists them), so that each is built on its own
+//  and the difference between its size and that of the image with PS2_BENCH=0 is its
+//  footprint.
+
+#include <avr/sleep.h>
+#include "ps2_Keyboard.h"
+#include "ps2_KeyboardOutputBuffer.h"
+#include "ps2_AnsiTranslator.h"
+#include "ps2_UsbTranslator.h"
+#include "ps2_NeutralTranslator.h"
+#include "ps2_SimpleDiagnostics.h"
+#include "ps2_NullDiagnostics.h"
+
+#ifndef PS2_BENCH
+#define PS2_BENCH 0
+#endif
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+static const uint8_t samplesPerBenchmark = 64;
+
+// The compiler is free to move code across a write to a register, unless it's told otherwise.
+#define BENCH_START() do { cli(); asm volatile("" ::: "memory"); GPIOR1 = 1; asm volatile("" ::: "memory"); } while (0)
+#define BENCH_STOP() do { asm volatile("" ::: "memory"); GPIOR1 = 2; asm volatile("" ::: "memory"); sei(); } while (0)
+
+// Somewhere to put results so they aren't optimized away.
+static volatile uint16_t sink;
+
+static void print(const char *text) {
+    while (*text != '\0') {
+        GPIOR0 = *text++;
+    }
+}
+
+// A bit of everything:  plain keys, shift, extended keys and Pause, each made and unmade.
+static const ps2::KeyboardOutput typing[] = {
+    ps2::KeyboardOutput::sc2_a, ps2::KeyboardOutput::unmake, ps2::KeyboardOutput::sc2_a,
+    ps2::KeyboardOutput::sc2_leftShift, ps2::KeyboardOutput::sc2_b, ps2::KeyboardOutput::unmake, ps2::KeyboardOutput::sc2_b,
+    ps2::KeyboardOutput::unmake, ps2::KeyboardOutput::sc2_leftShift,
+    ps2::KeyboardOutput::extend, ps2::KeyboardOutput::sc2ex_leftArrow,
+    ps2::KeyboardOutput::extend, ps2::KeyboardOutput::unmake, ps2::KeyboardOutput::sc2ex_leftArrow,
+    ps2::KeyboardOutput::sc2_enter, ps2::KeyboardOutput::unmake, ps2::KeyboardOutput::sc2_enter,
+    ps2::KeyboardOutput::extend1, (ps2::KeyboardOutput)0x14, (ps2::KeyboardOutput)0x77,
+    ps2::KeyboardOutput::extend1, ps2::KeyboardOutput::unmake, (ps2::KeyboardOutput)0x14,
+    ps2::KeyboardOutput::unmake, (ps2::KeyboardOutput)0x77,
+};
+static const uint8_t typingLength = sizeof(typing) / sizeof(typing[0]);
+
+#if (PS2_BENCH >= 1 && PS2_BENCH <= 6) || PS2_BENCH >= 12
+static ps2::NullDiagnostics nullDiagnostics;
+#endif
+
+#if PS2_BENCH == 1 || PS2_BENCH == 4 || PS2_BENCH >= 9
+// Exposes the interrupt handler, which is what gets timed rather than the interrupt itself,
+//  since the cost of getting into an ISR doesn't depend on the library.
+template <typename Diagnostics>
+class BenchKeyboard : public ps2::Keyboard<dataPin, clockPin, 16, Diagnostics> {
+    typedef ps2::Keyboard<dataPin, clockPin, 16, Diagnostics> base;
+
+public:
+    BenchKeyboard(Diagnostics &diagnostics) : base(diagnostics) {}
+    using base::readInterruptHandler;
+};
+
+// Clocks one byte in, as the keyboard would, 80us per bit.  If timeEachBit is set, each call
+//  to the interrupt handler is a sample.
+template <typename Keyboard>
+static void clockIn(Keyboard &keyboard, uint8_t value, bool timeEachBit) {
+    uint8_t parity = 1;
+    for (uint8_t bit = 0; bit < 11; ++bit) {
+        uint8_t level;
+        if (bit == 0) {
+            level = 0;
+        }
+        else if (bit <= 8) {
+            level = (value >> (bit - 1)) & 1;
+            parity ^= level;
+        }
+        else if (bit == 9) {
+            level = parity;
+        }
+        else {
+            level = 1;
+        }
+        digitalWrite(dataPin, level);
+        delayMicroseconds(80);
+        if (timeEachBit) {
+            BENCH_START();
+            keyboard.readInterruptHandler();
+            BENCH_STOP();
+        }
+        else {
+            cli();
+            keyboard.readInterruptHandler();
+            sei();
+        }
+    }
+}
+
+template <typename Keyboard>
+static void startKeyboard(Keyboard &keyboard) {
+    keyboard.begin();
+    // Drive the data pin ourselves; reading it back gives what was written.  Nothing drives
+    //  the clock pin, so the real interrupt never fires.
+    pinMode(dataPin, OUTPUT);
+    digitalWrite(dataPin, HIGH);
+}
+#endif
+
+#if PS2_BENCH == 1 || PS2_BENCH >= 9
+// Times the interrupt handler for each bit of enough bytes to make up the samples.
+template <typename Diagnostics>
+static void benchReceive(Diagnostics &diagnostics) {
+    BenchKeyboard<Diagnostics> keyboard(diagnostics);
+    startKeyboard(keyboard);
+    for (uint8_t i = 0; i < samplesPerBenchmark / 11 + 1; ++i) {
+        clockIn(keyboard, (uint8_t)typing[i % typingLength], true);
+        sink = (uint16_t)keyboard.readScanCode();
+    }
+}
+#endif
+
+#if PS2_BENCH == 1
+static void benchReadInterruptHandler() {
+    print("begin readInterruptHandler\n");
+    benchReceive(nullDiagnostics);
+    print("end\n");
+}
+#elif PS2_BENCH == 2
+static void benchBufferPush() {
+    print("begin KeyboardOutputBuffer::push\n");
+    ps2::KeyboardOutputBuffer<16, ps2::NullDiagnostics> buffer(nullDiagnostics);
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+        buffer.push(typing[i % typingLength]);
+        BENCH_STOP();
+        sink = (uint16_t)buffer.pop();
+    }
+    print("end\n");
+}
+#elif PS2_BENCH == 3
+static void benchBufferPop() {
+    print("begin KeyboardOutputBuffer::pop\n");
+    ps2::KeyboardOutputBuffer<16, ps2::NullDiagnostics> buffer(nullDiagnostics);
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        buffer.push(typing[i % typingLength]);
+        ps2::KeyboardOutput code;
+        BENCH_START();
+        bool isAvailable = buffer.pop(code);
+        BENCH_STOP();
+        sink = (uint16_t)code + isAvailable;
+    }
+    print("end\n");
+}
+#elif PS2_BENCH == 4
+static void benchReadScanCode() {
+    print("begin readScanCode\n");
+    BenchKeyboard<ps2::NullDiagnostics> keyboard(nullDiagnostics);
+    startKeyboard(keyboard);
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        clockIn(keyboard, (uint8_t)typing[i % typingLength], false);
+        BENCH_START();
+        ps2::KeyboardOutput code = keyboard.readScanCode();
+        BENCH_STOP();
+        sink = (uint16_t)code;
+    }
+    print("end\n");
+}
+#elif PS2_BENCH == 5
+static void benchAnsiTranslator() {
+    print("begin AnsiTranslator::translatePs2Keycode\n");
+    ps2::AnsiTranslator<ps2::NullDiagnostics> translator(nullDiagnostics);
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+        char c = translator.translatePs2Keycode(typing[i % typingLength]);
+        BENCH_STOP();
+        sink = (uint16_t)c;
+    }
+    print("end\n");
+}
+#elif PS2_BENCH == 6
+static void benchUsbTranslator() {
+    print("begin UsbTranslator::translatePs2Keycode\n");
+    ps2::UsbTranslator<ps2::NullDiagnostics> translator(nullDiagnostics);
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+        ps2::UsbKeyAction action = translator.translatePs2Keycode(typing[i % typingLength]);
+        BENCH_STOP();
+        sink = action.hidCode + (uint16_t)action.gesture;
+    }
+    print("end\n");
+}
+#elif PS2_BENCH == 7
+static void benchNeutralTranslator() {
+    print("begin NeutralTranslator::translatePs2Keycode\n");
+    ps2::NeutralTranslator translator;
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+        uint16_t keyCode = translator.translatePs2Keycode(typing[i % typingLength]);
+        BENCH_STOP();
+        sink = keyCode;
+    }
+    print("end\n");
+}
+#elif PS2_BENCH == 8
+static void benchSimpleDiagnostics() {
+    print("begin SimpleDiagnostics::push\n");
+    // receivedByte is a two-byte record, which is most of what gets recorded.  The ring
+    //  wraps several times over the samples.
+    ps2::SimpleDiagnostics<32> diagnostics;
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+        diagnostics.receivedByte((byte)typing[i % typingLength]);
+        BENCH_STOP();
+    }
+    print("end\n");
+}
+#elif PS2_BENCH >= 9 && PS2_BENCH <= 11
+// The interrupt handler again, with SimpleDiagnostics recording errors only, errors and the
+//  application's events (which the handler never makes) and everything.  These are the
+//  configurations in the SimpleDiagnostics documentation.
+static void benchFilteredDiagnostics() {
+#if PS2_BENCH == 9
+    print("begin readInterruptHandler, errors recorded\n");
+    static ps2::SimpleDiagnostics<64, 30, ps2::DiagnosticsEvents::errors> diagnostics;
+#elif PS2_BENCH == 10
+    print("begin readInterruptHandler, errors and application events recorded\n");
+    static ps2::SimpleDiagnostics<64, 30, ps2::DiagnosticsEvents::errors | ps2::DiagnosticsEvents::applicationEvents> diagnostics;
+#else
+    print("begin readInterruptHandler, everything recorded\n");
+    static ps2::SimpleDiagnostics<64, 30> diagnostics;
+#endif
+    benchReceive(diagnostics);
+    print("end\n");
+}
+#elif PS2_BENCH == 12 || PS2_BENCH == 13
+// What loop() pays to find out there's nothing to do, which is most of what polling costs
+//  while nobody's typing.  A byte goes through first, so the keyboard is past starting up.
+static void benchIdleCall() {
+#if PS2_BENCH == 12
+    print("begin readScanCode, nothing waiting\n");
+#else
+    print("begin dispatch, nothing waiting\n");
+#endif
+    BenchKeyboard<ps2::NullDiagnostics> keyboard(nullDiagnostics);
+    startKeyboard(keyboard);
+    clockIn(keyboard, (uint8_t)ps2::KeyboardOutput::sc2_a, false);
+    sink = (uint16_t)keyboard.readScanCode();
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+#if PS2_BENCH == 12
+        ps2::KeyboardOutput code = keyboard.readScanCode();
+#else
+        uint8_t code = keyboard.dispatch([](ps2::KeyboardOutput c) { sink = (uint16_t)c; });
+#endif
+        BENCH_STOP();
+        sink = (uint16_t)code;
+    }
+    print("end\n");
+}
+#endif
+
+int main() {
+    init();
+    sei();
+
+    // What it costs to take a sample of nothing at all; CycleCounter takes it off the rest.
+    print("begin overhead\n");
+    for (uint8_t i = 0; i < samplesPerBenchmark; ++i) {
+        BENCH_START();
+        BENCH_STOP();
+    }
+    print("end\n");
+
+#if PS2_BENCH == 1
+    benchReadInterruptHandler();
+#elif PS2_BENCH == 2
+    benchBufferPush();
+#elif PS2_BENCH == 3
+    benchBufferPop();
+#elif PS2_BENCH == 4
+    benchReadScanCode();
+#elif PS2_BENCH == 5
+    benchAnsiTranslator();
+#elif PS2_BENCH == 6
+    benchUsbTranslator();
+#elif PS2_BENCH == 7
+    benchNeutralTranslator();
+#elif PS2_BENCH == 8
+    benchSimpleDiagnostics();
+#elif PS2_BENCH >= 9 && PS2_BENCH <= 11
+    benchFilteredDiagnostics();
+#elif PS2_BENCH == 12 || PS2_BENCH == 13
+    benchIdleCall();
+#endif
+
+    // Sleeping with interrupts off is how simavr knows the program is done.
+    cli();
+    sleep_enable();
+    sleep_cpu();
+    return 0;
+}
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+# USA
+
+"""Builds sketches for AVR boards and measures them.  Shared by RunBench.py and Footprint.py.
+
+Sketches are built with arduino-cli against this copy of the library, so the Arduino AVR core
+has to be installed (arduino-cli core install arduino:avr).  The sizes come from avr-size.
+"""
+
+import os
+import re
+import subprocess
+import tempfile
+
+REPO = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
+
+# The parts the library ships on, and a board for each.
+BOARDS = {
+    "atmega328p": "arduino:avr:uno",
+    "atmega32u4": "arduino:avr:leonardo",
+}
+
+
+def build(sketch, mcu, defines=(), output=None):
+    """Builds the sketch in the given directory for the given part and returns its .elf."""
+    output = output or tempfile.mkdtemp(prefix="ps2avr-")
+    flags = " ".join("-D" + d for d in defines)
+    subprocess.run(
+        ["arduino-cli", "compile", "--fqbn", BOARDS[mcu], "--library", REPO,
+         "--build-property", "compiler.cpp.extra_flags=" + flags,
+         "--output-dir", output, sketch],
+        check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(output, os.path.basename(os.path.normpath(sketch)) + ".ino.elf")
+
+
+def size(elf):
+    """Flash and SRAM used by an image, in bytes, as a dict."""
+    sections = {}
+    listing = subprocess.run(["avr-size", "-A", elf], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    for line in listing.splitlines():
+        match = re.match(r"^(\.\w+)\s+(\d+)\s+\d+", line)
+        if match:
+            sections[match.group(1)] = int(match.group(2))
+    data = sections.get(".data", 0)
+    return {"flash": sections.get(".text", 0) + data, "sram": data + sections.get(".bss", 0)}
+
+
+def symbols(elf):
+    """The size of each symbol in an image, as (name, section type, bytes), demangled."""
+    listing = subprocess.run(["avr-nm", "--size-sort", "-C", "-S", elf], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    result = []
+    for line in listing.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4:
+            result.append((parts[3], parts[2], int(parts[1], 16)))
+    return result
@@ -0,0 +1,144 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Runs an AvrBench image under simavr and prints the cycle count of each of its samples as
+//  JSON, one line per benchmark:
+//
+//   {"name": "readScanCode", "samples": 64, "min": 41, "mean": 55.2, "max": 120}
+//
+//  The "overhead" benchmark (what it costs to take an empty sample) is taken off the others
+//  and isn't printed.  See AvrBench/AvrBench.ino for how the firmware reports.
+//
+//  Usage:  CycleCounter <mcu> <image.elf>   (e.g. atmega328p, atmega32u4)
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+namespace {
+    // Data-space addresses of the general purpose I/O registers, the same on both parts.
+    const avr_io_addr_t gpior0 = 0x3e;
+    const avr_io_addr_t gpior1 = 0x4a;
+
+    struct Benchmark {
+        std::string name;
+        bool isActive = false;
+        uint32_t samples = 0;
+        uint64_t min = UINT64_MAX;
+        uint64_t max = 0;
+        uint64_t total = 0;
+        uint64_t startedAt = 0;
+        uint64_t overhead = 0;
+        std::string line;
+        bool failed = false;
+
+        void report() {
+            if (this->samples == 0) {
+                return;
+            }
+            if (this->name == "overhead") {
+                this->overhead = this->min;
+                return;
+            }
+            double mean = (double)this->total / this->samples - this->overhead;
+            printf("{\"name\": \"%s\", \"samples\": %u, \"min\": %llu, \"mean\": %.1f, \"max\": %llu}\n",
+                this->name.c_str(), this->samples, (unsigned long long)(this->min - this->overhead),
+                mean, (unsigned long long)(this->max - this->overhead));
+        }
+    };
+
+    void consoleWrite(avr_t *, avr_io_addr_t, uint8_t value, void *param) {
+        Benchmark &benchmark = *(Benchmark *)param;
+        if (value != '\n') {
+            benchmark.line += (char)value;
+            return;
+        }
+        if (benchmark.line.compare(0, 6, "begin ") == 0) {
+            benchmark.name = benchmark.line.substr(6);
+            benchmark.isActive = true;
+            benchmark.samples = 0;
+            benchmark.min = UINT64_MAX;
+            benchmark.max = 0;
+            benchmark.total = 0;
+        }
+        else if (benchmark.line == "end" && benchmark.isActive) {
+            benchmark.report();
+            benchmark.isActive = false;
+        }
+        else {
+            fprintf(stderr, "%s\n", benchmark.line.c_str());
+        }
+        benchmark.line.clear();
+    }
+
+    void sampleWrite(avr_t *avr, avr_io_addr_t, uint8_t value, void *param) {
+        Benchmark &benchmark = *(Benchmark *)param;
+        if (value == 1) {
+            benchmark.startedAt = avr->cycle;
+        }
+        else if (value == 2 && benchmark.isActive) {
+            uint64_t cycles = avr->cycle - benchmark.startedAt;
+            ++benchmark.samples;
+            benchmark.total += cycles;
+            benchmark.min = cycles < benchmark.min ? cycles : benchmark.min;
+            benchmark.max = cycles > benchmark.max ? cycles : benchmark.max;
+        }
+        else {
+            benchmark.failed = true;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <mcu> <image.elf>\n", argv[0]);
+        return 2;
+    }
+
+    elf_firmware_t firmware = {};
+    if (elf_read_firmware(argv[2], &firmware) != 0) {
+        fprintf(stderr, "%s: can't read %s\n", argv[0], argv[2]);
+        return 2;
+    }
+    avr_t *avr = avr_make_mcu_by_name(argv[1]);
+    if (avr == nullptr) {
+        fprintf(stderr, "%s: simavr doesn't know %s\n", argv[0], argv[1]);
+        return 2;
+    }
+    avr_init(avr);
+    avr->frequency = 16000000;
+    avr_load_firmware(avr, &firmware);
+
+    Benchmark benchmark;
+    avr_register_io_write(avr, gpior0, consoleWrite, &benchmark);
+    avr_register_io_write(avr, gpior1, sampleWrite, &benchmark);
+
+    int state;
+    do {
+        state = avr_run(avr);
+    } while (state != cpu_Done && state != cpu_Crashed);
+
+    if (state == cpu_Crashed || benchmark.isActive || benchmark.failed) {
+        fprintf(stderr, "%s: %s didn't run to the end\n", argv[0], argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+# USA
+
+"""Reports the flash and SRAM each configuration of the library takes on AVR, and checks
+it against the budget in FootprintBudget.txt.
+
+Usage:
+    Footprint.py [--mcu atmega328p] [--budget FILE] [--write-budget] [--output results.json]
+
+Each configuration in CONFIGURATIONS is built from Footprint/Footprint.ino.  Its size is
+broken down by group, from the symbol table:  the translator tables, the keyboard (which is
+mostly its buffers), the diagnostics ring, the interrupt handler and the rest of the library.
+Library code that the compiler inlined into the sketch counts as the sketch's, along with
+the Arduino core.
+
+It fails if any configuration's flash or SRAM is over its budget, or if a configuration
+has no budget.  After a change that is meant to make something bigger, or one that adds a
+configuration, --write-budget records the new sizes as the budget.
+Needs arduino-cli with the arduino:avr core, avr-size and avr-nm.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+import AvrBuild
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SKETCH = os.path.join(HERE, "Footprint")
+BUDGET = os.path.join(HERE, "FootprintBudget.txt")
+
+# name -> the defines Footprint.ino takes (see there).
+CONFIGURATIONS = {
+    "minimal": ["PS2_BUFFER_SIZE=1"],
+    "ansi": ["PS2_BUFFER_SIZE=16", "PS2_TRANSLATOR=1"],
+    "usb": ["PS2_BUFFER_SIZE=16", "PS2_TRANSLATOR=2"],
+    "neutral": ["PS2_BUFFER_SIZE=16", "PS2_TRANSLATOR=3"],
+    "ansi-diagnostics": ["PS2_BUFFER_SIZE=16", "PS2_TRANSLATOR=1", "PS2_DIAGNOSTICS_SIZE=60", "PS2_LAST_ERROR_SIZE=30"],
+    # As in the Ps2ToUsbKeyboardAdapter example, then with the RecordedEvents masks in the
+    #  SimpleDiagnostics documentation:  errors only, and errors plus the keys sent to the host.
+    "usb-adapter": ["PS2_BUFFER_SIZE=1", "PS2_TRANSLATOR=2", "PS2_DIAGNOSTICS_SIZE=512", "PS2_LAST_ERROR_SIZE=60"],
+    "usb-adapter-errors": ["PS2_BUFFER_SIZE=1", "PS2_TRANSLATOR=2", "PS2_DIAGNOSTICS_SIZE=512", "PS2_LAST_ERROR_SIZE=60",
+                           "PS2_RECORDED_EVENTS=ps2::DiagnosticsEvents::errors"],
+    "usb-adapter-keys": ["PS2_BUFFER_SIZE=1", "PS2_TRANSLATOR=2", "PS2_DIAGNOSTICS_SIZE=512", "PS2_LAST_ERROR_SIZE=60",
+                         "PS2_RECORDED_EVENTS=ps2::DiagnosticsEvents::errors|ps2::DiagnosticsEvents::applicationEvents"],
+}
+
+# The first group whose pattern matches a symbol's (demangled) name gets it.  Functions and
+#  data are told apart by the parameter list in a function's name (interrupt vectors have none).
+GROUPS = [
+    ("translator tables", False, r"ps2ToAsciiMap|ps2ToUsbMap|extPs2ToUsbMap|pauseKeySequence"),
+    ("keyboard/buffers", False, r"^keyboard$"),
+    ("diagnostics ring", False, r"^diagnostics$"),
+    ("interrupt handler", True, r"InterruptHandler|receiveBit|__vector_"),
+    ("translator code", True, r"Translator"),
+    ("diagnostics code", True, r"Diagnostics"),
+    ("other library", None, r"\bps2::"),
+]
+OTHER = "sketch and core"
+
+
+def group_of(name):
+    is_function = "(" in name or name.startswith("__vector_")
+    for group, wants_function, pattern in GROUPS:
+        if (wants_function is None or wants_function == is_function) and re.search(pattern, name):
+            return group
+    return OTHER
+
+
+def measure(mcu, name, defines):
+    elf = AvrBuild.build(SKETCH, mcu, defines)
+    result = {"mcu": mcu, "configuration": name, "groups": {}}
+    result.update(AvrBuild.size(elf))
+    for symbol, kind, size in AvrBuild.symbols(elf):
+        group = result["groups"].setdefault(group_of(symbol), {"flash": 0, "sram": 0})
+        # Initialized data takes room in both:  the initial values are copied out of flash.
+        if kind in "tTwWdD":
+            group["flash"] += size
+        if kind in "bBdD":
+            group["sram"] += size
+    return result
+
+
+def read_budget(path):
+    budget = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            for line in f:
+                fields = line.split("#", 1)[0].split()
+                if len(fields) == 4:
+                    budget[(fields[0], fields[1])] = {"flash": int(fields[2]), "sram": int(fields[3])}
+    return budget
+
+
+def write_budget(path, results):
+    with open(path, "w") as f:
+        f.write("# The most flash and SRAM, in bytes, each configuration in Footprint.py may take.\n")
+        f.write("# Written by Footprint.py --write-budget.\n")
+        f.write("#\n# %-10s %-18s %6s %5s\n" % ("mcu", "configuration", "flash", "sram"))
+        for r in results:
+            f.write("%-12s %-18s %6d %5d\n" % (r["mcu"], r["configuration"], r["flash"], r["sram"]))
+
+
+def report(result):
+    print("%s %s:  %d bytes flash, %d bytes SRAM" % (result["mcu"], result["configuration"], result["flash"], result["sram"]))
+    for group in sorted(result["groups"], key=lambda g: -result["groups"][g]["flash"] - result["groups"][g]["sram"]):
+        sizes = result["groups"][group]
+        print("    %-20s %6d %5d" % (group, sizes["flash"], sizes["sram"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flash and SRAM of each configuration of the library on AVR.")
+    parser.add_argument("--mcu", action="append", choices=sorted(AvrBuild.BOARDS), help="the parts to build for (default: all)")
+    parser.add_argument("--budget", default=BUDGET, help="the budget to check against")
+    parser.add_argument("--write-budget", action="store_true", help="record these sizes as the budget")
+    parser.add_argument("--output", help="where to write the results as JSON")
+    args = parser.parse_args()
+
+    results = []
+    for mcu in args.mcu or sorted(AvrBuild.BOARDS):
+        for name in sorted(CONFIGURATIONS):
+            results.append(measure(mcu, name, CONFIGURATIONS[name]))
+            report(results[-1])
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=1)
+            f.write("\n")
+
+    if args.write_budget:
+        write_budget(args.budget, results)
+        return
+
+    budget = read_budget(args.budget)
+    failed = False
+    for result in results:
+        limit = budget.get((result["mcu"], result["configuration"]))
+        if limit is None:
+            print("%s %s has no budget; run with --write-budget to record one" % (result["mcu"], result["configuration"]))
+            failed = True
+            continue
+        for key in ("flash", "sram"):
+            if result[key] > limit[key]:
+                print("%s %s is over budget:  %d bytes of %s, %d allowed" % (result["mcu"], result["configuration"], result[key], key, limit[key]))
+                failed = True
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
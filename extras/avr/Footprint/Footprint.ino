@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// One configuration of the library, for Footprint.py to measure.  It's an ordinary sketch that
+//  reads the keyboard and translates what it gets, set up by these:
+//
+//   PS2_BUFFER_SIZE         the BufferSize of the Keyboard
+//   PS2_DIAGNOSTICS_SIZE    0 for NullDiagnostics, or the Size of a SimpleDiagnostics
+//   PS2_LAST_ERROR_SIZE     the LastErrorSize of that SimpleDiagnostics
+//   PS2_RECORDED_EVENTS     its RecordedEvents (all of them if not given)
+//   PS2_TRANSLATOR          0 for none, 1 AnsiTranslator, 2 UsbTranslator, 3 NeutralTranslator
+//
+//  The objects are named so that Footprint.py can find them in the symbol table.  Results go to
+//  a volatile, so the translation isn't optimized away, rather than to Serial, which would
+//  take more room than the library.
+
+#include "ps2_Keyboard.h"
+#include "ps2_NullDiagnostics.h"
+#include "ps2_SimpleDiagnostics.h"
+#include "ps2_AnsiTranslator.h"
+#include "ps2_UsbTranslator.h"
+#include "ps2_NeutralTranslator.h"
+
+#ifndef PS2_BUFFER_SIZE
+#define PS2_BUFFER_SIZE 16
+#endif
+#ifndef PS2_DIAGNOSTICS_SIZE
+#define PS2_DIAGNOSTICS_SIZE 0
+#endif
+#ifndef PS2_LAST_ERROR_SIZE
+#define PS2_LAST_ERROR_SIZE 30
+#endif
+#ifndef PS2_RECORDED_EVENTS
+#define PS2_RECORDED_EVENTS ps2::DiagnosticsEvents::all
+#endif
+#ifndef PS2_TRANSLATOR
+#define PS2_TRANSLATOR 0
+#endif
+
+#if PS2_DIAGNOSTICS_SIZE == 0
+typedef ps2::NullDiagnostics Diagnostics;
+#else
+// With the events the Ps2ToUsbKeyboardAdapter example adds.
+class Diagnostics
+    : public ps2::SimpleDiagnostics<PS2_DIAGNOSTICS_SIZE, PS2_LAST_ERROR_SIZE, PS2_RECORDED_EVENTS>
+{
+    typedef ps2::SimpleDiagnostics<PS2_DIAGNOSTICS_SIZE, PS2_LAST_ERROR_SIZE, PS2_RECORDED_EVENTS> base;
+
+public:
+    void sentUsbKeyDown(byte b) { this->push((uint8_t)base::firstUnusedInfoCode, b); }
+    void sentUsbKeyUp(byte b) { this->push((uint8_t)(base::firstUnusedInfoCode + 1), b); }
+};
+#endif
+
+static Diagnostics diagnostics;
+static ps2::Keyboard<4, 3, PS2_BUFFER_SIZE, Diagnostics> keyboard(diagnostics);
+#if PS2_TRANSLATOR == 1
+static ps2::AnsiTranslator<Diagnostics> translator(diagnostics);
+#elif PS2_TRANSLATOR == 2
+static ps2::UsbTranslator<Diagnostics> translator(diagnostics);
+#elif PS2_TRANSLATOR == 3
+static ps2::NeutralTranslator translator;
+#endif
+
+static volatile uint16_t sink;
+
+void setup() {
+    keyboard.begin();
+}
+
+void loop() {
+    ps2::KeyboardOutput code = keyboard.readScanCode();
+    if (code == ps2::KeyboardOutput::none) {
+        return;
+    }
+#if PS2_TRANSLATOR == 1
+    sink = (uint16_t)translator.translatePs2Keycode(code);
+#elif PS2_TRANSLATOR == 2
+    ps2::UsbKeyAction action = translator.translatePs2Keycode(code);
+#if PS2_DIAGNOSTICS_SIZE != 0
+    if (action.gesture == ps2::UsbKeyAction::KeyDown) {
+        diagnostics.sentUsbKeyDown(action.hidCode);
+    }
+    else if (action.gesture == ps2::UsbKeyAction::KeyUp) {
+        diagnostics.sentUsbKeyUp(action.hidCode);
+    }
+#endif
+    sink = action.hidCode + (uint16_t)action.gesture;
+#elif PS2_TRANSLATOR == 3
+    sink = translator.translatePs2Keycode(code);
+#else
+    sink = (uint16_t)code;
+#endif
+}
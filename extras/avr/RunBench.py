@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+# USA
+
+"""Counts the cycles the library's hot paths take on AVR, and what each adds to the image.
+
+Usage:
+    RunBench.py --counter PATH [--mcu atmega328p] [--output results.json]
+                [--baseline FILE] [--write-baseline] [--tolerance PERCENT]
+
+Each benchmark in AvrBench/AvrBench.ino is built on its own and run under simavr by
+CycleCounter (built by CMake when simavr is installed), which times each sample to the
+cycle.  The result is a JSON list, one entry per part and benchmark:
+
+    {"mcu": "atmega328p", "name": "readScanCode", "samples": 64,
+     "min": 41, "mean": 55.2, "max": 120, "flash": 310, "sram": 40}
+
+Cycles are with the cost of taking a sample taken off.  flash and sram are what the
+benchmark adds to an image that has just main() and the Arduino core, so they include
+whatever part of the core the benchmark pulls in.
+
+It fails if any of the cycle counts or sizes grew by more than the tolerance (default 5%)
+over the baseline, AvrBenchBaseline.json unless --baseline says otherwise, or if the
+baseline is missing or has no entry for a benchmark.  After a change that is meant to make
+something slower or bigger, or one that adds a benchmark, --write-baseline records these
+results as the baseline.  Needs arduino-cli with the arduino:avr core, avr-size and simavr.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+import AvrBuild
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SKETCH = os.path.join(HERE, "AvrBench")
+BASELINE = os.path.join(HERE, "AvrBenchBaseline.json")
+
+# PS2_BENCH goes from 1 to this; keep it in step with AvrBench.ino.
+BENCHMARK_COUNT = 13
+
+
+def run(counter, mcu):
+    results = []
+    base = AvrBuild.size(AvrBuild.build(SKETCH, mcu, ["PS2_BENCH=0"]))
+    for n in range(1, BENCHMARK_COUNT + 1):
+        elf = AvrBuild.build(SKETCH, mcu, ["PS2_BENCH=%d" % n])
+        footprint = AvrBuild.size(elf)
+        output = subprocess.run([counter, mcu, elf], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+        for line in output.splitlines():
+            result = {"mcu": mcu}
+            result.update(json.loads(line))
+            result["flash"] = footprint["flash"] - base["flash"]
+            result["sram"] = footprint["sram"] - base["sram"]
+            results.append(result)
+            print("%-11s %-42s %5d %8.1f %5d  %6d %5d" % (mcu, result["name"], result["min"], result["mean"], result["max"], result["flash"], result["sram"]))
+    return results
+
+
+def compare(results, baseline, tolerance):
+    """Lists what got worse than the baseline by more than tolerance percent."""
+    earlier = {(r["mcu"], r["name"]): r for r in baseline}
+    regressions = []
+    for result in results:
+        before = earlier.get((result["mcu"], result["name"]))
+        if before is None:
+            regressions.append("%s %s has no baseline; run with --write-baseline to record one" % (result["mcu"], result["name"]))
+            continue
+        for key in ("min", "mean", "max", "flash", "sram"):
+            if result[key] > before[key] * (1 + tolerance / 100.0) and result[key] > before[key] + 1:
+                regressions.append("%s %s: %s went from %s to %s" % (result["mcu"], result["name"], key, before[key], result[key]))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Cycle counts and footprint of the library's hot paths on AVR.")
+    parser.add_argument("--counter", required=True, help="the CycleCounter program")
+    parser.add_argument("--mcu", action="append", choices=sorted(AvrBuild.BOARDS), help="the parts to run on (default: all)")
+    parser.add_argument("--output", help="where to write the results as JSON")
+    parser.add_argument("--baseline", default=BASELINE, help="results from an earlier run to check against")
+    parser.add_argument("--write-baseline", action="store_true", help="record these results as the baseline")
+    parser.add_argument("--tolerance", type=float, default=5, help="percent growth allowed over the baseline")
+    args = parser.parse_args()
+
+    print("%-11s %-42s %5s %8s %5s  %6s %5s" % ("mcu", "benchmark", "min", "mean", "max", "flash", "sram"))
+    results = []
+    for mcu in args.mcu or sorted(AvrBuild.BOARDS):
+        results += run(args.counter, mcu)
+
+    for path in [args.output, args.baseline if args.write_baseline else None]:
+        if path:
+            with open(path, "w") as f:
+                json.dump(results, f, indent=1)
+                f.write("\n")
+    if args.write_baseline:
+        return
+
+    if not os.path.exists(args.baseline):
+        print("There's no baseline at %s; run with --write-baseline to record one" % args.baseline)
+        sys.exit(1)
+    with open(args.baseline) as f:
+        regressions = compare(results, json.load(f), args.tolerance)
+    for regression in regressions:
+        print(regression)
+    if regressions:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
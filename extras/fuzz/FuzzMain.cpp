@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// A stand-in for libFuzzer's main(), for compilers that don't have it (and for ctest).  It
+//  runs the target over each file it's given, or each file in each directory it's given, and
+//  then, if asked, over that many random mutations of them:
+//
+//      TranslatorFuzz extras/fuzz/corpus/translators --mutations 100000
+//
+//  It prints the number of runs per second at the end, and with --min-execs-per-second, fails
+//  if that's below the given number.  A failed check aborts, as it would
+//  under libFuzzer, and the input that failed is saved as crash-input in the current
+//  directory, so it can be run on its own.
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace {
+    typedef std::vector<uint8_t> Input;
+
+    const Input *currentInput = nullptr;
+
+    void saveCurrentInput(int signalNumber) {
+        if (currentInput != nullptr) {
+            FILE *file = fopen("crash-input", "wb");
+            if (file != nullptr) {
+                fwrite(currentInput->data(), 1, currentInput->size(), file);
+                fclose(file);
+                fprintf(stderr, "saved the input as crash-input\n");
+            }
+        }
+        signal(signalNumber, SIG_DFL);
+        raise(signalNumber);
+    }
+
+    void run(const Input &input) {
+        currentInput = &input;
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        currentInput = nullptr;
+    }
+
+    bool readFile(const std::string &path, Input &input) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        input.clear();
+        uint8_t buffer[4096];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            input.insert(input.end(), buffer, buffer + count);
+        }
+        fclose(file);
+        return true;
+    }
+
+    void addInputs(const std::string &path, std::vector<Input> &inputs) {
+        DIR *directory = opendir(path.c_str());
+        if (directory == nullptr) {
+            Input input;
+            if (!readFile(path, input)) {
+                fprintf(stderr, "can't read %s\n", path.c_str());
+                exit(2);
+            }
+            inputs.push_back(input);
+            return;
+        }
+        while (dirent *entry = readdir(directory)) {
+            if (entry->d_name[0] != '.') {
+                addInputs(path + "/" + entry->d_name, inputs);
+            }
+        }
+        closedir(directory);
+    }
+
+    // Flips, replaces, inserts or deletes a few bytes, or splices in part of another input.
+    Input mutate(const std::vector<Input> &inputs, uint32_t &seed) {
+        auto next = [&seed]() {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            return seed;
+        };
+        Input input = inputs[next() % inputs.size()];
+        uint32_t changes = 1 + next() % 4;
+        for (uint32_t i = 0; i < changes; ++i) {
+            size_t at = input.empty() ? 0 : next() % input.size();
+            switch (next() % 5) {
+            case 0:
+                if (!input.empty()) input[at] ^= (uint8_t)(1 << (next() % 8));
+                break;
+            case 1:
+                if (!input.empty()) input[at] = (uint8_t)next();
+                break;
+            case 2:
+                input.insert(input.begin() + at, (uint8_t)next());
+                break;
+            case 3:
+                if (!input.empty()) input.erase(input.begin() + at);
+                break;
+            case 4: {
+                const Input &other = inputs[next() % inputs.size()];
+                if (!other.empty()) {
+                    size_t from = next() % other.size();
+                    size_t length = 1 + next() % (other.size() - from);
+                    input.insert(input.begin() + at, other.begin() + from, other.begin() + from + length);
+                }
+                break;
+            }
+            }
+        }
+        return input;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<Input> inputs;
+    unsigned long mutations = 0;
+    double minExecsPerSecond = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--mutations") == 0 && i + 1 < argc) {
+            mutations = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--min-execs-per-second") == 0 && i + 1 < argc) {
+            minExecsPerSecond = atof(argv[++i]);
+        }
+        else {
+            addInputs(argv[i], inputs);
+        }
+    }
+    if (inputs.empty()) {
+        fprintf(stderr, "usage: %s <file or directory>... [--mutations N] [--min-execs-per-second N]\n", argv[0]);
+        return 2;
+    }
+
+    signal(SIGABRT, saveCurrentInput);
+    signal(SIGSEGV, saveCurrentInput);
+    auto start = std::chrono::steady_clock::now();
+    for (const Input &input : inputs) {
+        run(input);
+    }
+    uint32_t seed = 1;
+    for (unsigned long i = 0; i < mutations; ++i) {
+        run(mutate(inputs, seed));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned long runs = inputs.size() + mutations;
+    double execsPerSecond = seconds > 0 ? runs / seconds : 0.0;
+    printf("%lu runs, %.0f execs/s\n", runs, execsPerSecond);
+    if (execsPerSecond < minExecsPerSecond) {
+        printf("expected at least %.0f execs/s\n", minExecsPerSecond);
+        return 1;
+    }
+    return 0;
+}
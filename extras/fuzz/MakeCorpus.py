@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+# USA
+
+"""Writes the seed corpus for the fuzz targets in this directory.
+
+Usage:
+    MakeCorpus.py [directory]    (defaults to corpus/ next to this script)
+
+The seeds are real set-2 sequences:  typing, modifiers, the extended keys, Pause and
+Print Screen, keys held down, and the same with a byte missing or a stray one in the
+middle, as happens after a glitch.  TranslatorFuzz takes them as they are.  ReceiveFuzz
+takes the same sequences as a list of frames (see the comment at the top of
+ReceiveFuzz.cpp), mostly good ones with readScanCode called after each, plus one of each
+kind of bad frame.
+"""
+
+import os
+import sys
+
+A, S, D, F = 0x1C, 0x1B, 0x23, 0x2B
+LEFT_SHIFT, LEFT_CTRL, CAPS_LOCK, NUM_LOCK = 0x12, 0x14, 0x58, 0x77
+UNMAKE, EXTEND, EXTEND1 = 0xF0, 0xE0, 0xE1
+
+
+def press(*codes):
+    """The make and then the break of each key in turn."""
+    result = []
+    for code in codes:
+        result += [code, UNMAKE, code]
+    return result
+
+
+def extended(code):
+    return [EXTEND, code, EXTEND, UNMAKE, code]
+
+
+PAUSE = [EXTEND1, 0x14, 0x77, EXTEND1, UNMAKE, 0x14, UNMAKE, 0x77]
+PRINT_SCREEN = [EXTEND, 0x12, EXTEND, 0x7C, EXTEND, UNMAKE, 0x7C, EXTEND, UNMAKE, 0x12]
+
+SEQUENCES = {
+    "typing": press(0x33, 0x24, 0x4B, 0x4B, 0x44, 0x29, 0x1D, 0x44, 0x2D, 0x4B, 0x23),
+    "shifted": [LEFT_SHIFT] + press(A, S) + [UNMAKE, LEFT_SHIFT],
+    "ctrl": [LEFT_CTRL] + press(0x21) + [UNMAKE, LEFT_CTRL],
+    "caps_lock": press(CAPS_LOCK, A, CAPS_LOCK, A),
+    "keypad": press(NUM_LOCK, 0x69, 0x72, 0x7A, NUM_LOCK, 0x69) + extended(0x5A),
+    "arrows": extended(0x75) + extended(0x72) + extended(0x6B) + extended(0x74),
+    "navigation": extended(0x70) + extended(0x71) + extended(0x6C) + extended(0x69) + extended(0x7D) + extended(0x7A),
+    "right_modifiers": [EXTEND, 0x14, EXTEND, 0x11] + press(A) + [EXTEND, UNMAKE, 0x11, EXTEND, UNMAKE, 0x14],
+    "gui": extended(0x1F) + extended(0x27) + extended(0x2F),
+    "pause": PAUSE,
+    "print_screen": PRINT_SCREEN,
+    "pause_then_key": PAUSE + press(A),
+    "rollover": [A, S, D, F, UNMAKE, A, UNMAKE, S, UNMAKE, D, UNMAKE, F],
+    "held_key": [A] * 12 + [UNMAKE, A],
+    "held_extended": [EXTEND, 0x75] * 8 + [EXTEND, UNMAKE, 0x75],
+    "function_keys": press(0x05, 0x06, 0x04, 0x0C, 0x03, 0x0B, 0x83, 0x0A, 0x01, 0x09, 0x78, 0x07),
+    "bat_and_ack": [0xAA, 0xFA, 0xEE, 0xFE] + press(A),
+    "pause_missing_byte": PAUSE[:2] + PAUSE[3:] + press(A),
+    "pause_interrupted": PAUSE[:3] + extended(0x14) + press(A),
+    "stray_extend": [EXTEND, EXTEND1, A, UNMAKE, A],
+    "print_screen_missing_byte": PRINT_SCREEN[:3] + PRINT_SCREEN[4:] + press(A),
+    "double_unmake": [UNMAKE, UNMAKE, A, A, UNMAKE, A],
+}
+
+
+def frames(sequence):
+    """As ReceiveFuzz input:  each byte as a good frame, then readScanCode, then a short gap."""
+    result = []
+    for b in sequence:
+        result += [0x18, b]
+    return result
+
+
+def write(path, data):
+    with open(path, "wb") as f:
+        f.write(bytes(data))
+
+
+def main():
+    root = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus")
+    for target in ("translators", "receive"):
+        os.makedirs(os.path.join(root, target), exist_ok=True)
+
+    for name, sequence in sorted(SEQUENCES.items()):
+        write(os.path.join(root, "translators", name), sequence)
+        write(os.path.join(root, "receive", name), frames(sequence))
+
+    # One of each kind of bad frame (see ReceiveFuzz.cpp) in among good ones.
+    typing = frames(press(A, S))
+    for kind, name in ((4, "parity"), (5, "stop_bit"), (6, "start_bit"), (0x57, "cut_off")):
+        write(os.path.join(root, "receive", "bad_" + name), typing + [kind | 0x08, D] + typing)
+    # Frames with no readScanCode in between, so the buffer fills.
+    write(os.path.join(root, "receive", "burst"), [x for b in PAUSE + PRINT_SCREEN for x in (0x00, b)] + [0x08, A])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,195 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Fuzz target for the receive path:  the clock interrupt handler, the input buffer and
+//  Keyboard::readScanCode, driven through the pins of the host shim.  The input is a list of
+//  two-byte steps, a control byte and a data byte.  The low three bits of the control byte
+//  say what goes on the wire:
+//
+//      0-3  a good frame carrying the data byte
+//      4    the same with the parity bit wrong
+//      5    the same with the stop bit 0
+//      6    the same with the start bit 1
+//      7    a frame cut off after 1 to 10 bits (the top four bits of the control, mod 10, plus 1),
+//           as if the rest of its edges were missed
+//
+//  Bit 3 says to call readScanCode until it returns none after the frame, and the top four
+//  bits are how long the wire is quiet afterwards, in steps of 100us.  After a frame that was
+//  cut off, it's quiet for at least 5 clock periods:  that's how long Keyboard waits before it
+//  decides the frame has stopped, and if the next one starts sooner, there's no telling its
+//  bits from the missing ones.  Before each frame, the
+//  harness does what a keyboard has to:  it clocks in any byte the host is waiting to send
+//  (a resend request, or a command), and holds off while the host holds the clock low.  It
+//  doesn't otherwise answer, so the host sees no reply to anything it sends.
+//
+//  The checks are that readScanCode only returns bytes that went out in good frames, in the
+//  order they went out (it may drop some), that no call to it takes longer than a frame or
+//  two, and that once the wire has been quiet for a while, a good frame gets through.
+//  The shim steps through every simulated microsecond, so this is much slower than the
+//  translator target:  about 3,000 execs/s, or 2,000 with the sanitizers on.  ctest fails the
+//  run below 300, which would mean readScanCode or the handler has started to spin.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+    const int dataPin = 4;
+    const int clockPin = 3;
+    const uint32_t clockPeriod = 80;
+    // Long enough for a frame going out to time out, if the keyboard never clocks it.
+    const uint32_t maxReadMicroseconds = 3000;
+
+    void require(bool isOk, const char *what) {
+        if (!isOk) {
+            fprintf(stderr, "ReceiveFuzz: %s\n", what);
+            abort();
+        }
+    }
+
+    void clockOut(const uint8_t *bits, uint8_t count) {
+        for (uint8_t i = 0; i < count; ++i) {
+            host::pullLow(dataPin, bits[i] == 0);
+            host::advance(clockPeriod / 4);
+            host::pullLow(clockPin, true);
+            host::advance(clockPeriod / 2);
+            host::pullLow(clockPin, false);
+            host::advance(clockPeriod / 4);
+        }
+        host::pullLow(dataPin, false);
+    }
+
+    // Clocks in a byte the host wants to send, if it wants to, and acknowledges it.
+    void acceptHostByte() {
+        if (!host::isHigh(clockPin) || host::isHigh(dataPin)) {
+            return;
+        }
+        // The host puts out the start bit, data, parity and stop bit on the first 11 falling
+        //  edges, and looks for the acknowledge on the 12th.
+        for (int i = 0; i < 12; ++i) {
+            host::advance(clockPeriod / 4);
+            if (i == 11) {
+                host::pullLow(dataPin, true);
+            }
+            host::pullLow(clockPin, true);
+            host::advance(clockPeriod / 2);
+            host::pullLow(clockPin, false);
+            host::advance(clockPeriod / 4);
+        }
+        host::pullLow(dataPin, false);
+        host::advance(clockPeriod);
+    }
+
+    // Returns false if the host held the clock low for too long to send anything.
+    bool waitToSend() {
+        for (int i = 0; i < 50 && !host::isHigh(clockPin); ++i) {
+            host::advance(100);
+        }
+        acceptHostByte();
+        return host::isHigh(clockPin);
+    }
+
+    void sendFrame(uint8_t kind, uint8_t length, byte b) {
+        uint8_t bits[11];
+        uint8_t parity = 1;
+        bits[0] = 0;
+        for (int i = 0; i < 8; ++i) {
+            bits[1 + i] = (b >> i) & 1;
+            parity ^= bits[1 + i];
+        }
+        bits[9] = parity;
+        bits[10] = 1;
+        switch (kind) {
+        case 4: bits[9] = !parity; break;
+        case 5: bits[10] = 0; break;
+        case 6: bits[0] = 1; break;
+        case 7: clockOut(bits, length); return;
+        }
+        clockOut(bits, 11);
+    }
+
+    const int bufferSize = 16;
+    typedef ps2::Keyboard<dataPin, clockPin, bufferSize> FuzzKeyboard;
+
+    // Reads until the buffer is empty, checking each byte against the good frames sent.  A 0
+    //  byte comes out of readScanCode as none, so one none doesn't mean the buffer is empty,
+    //  but more nones in a row than the buffer holds does.
+    void drain(FuzzKeyboard &keyboard, const std::vector<byte> &goodBytes, size_t &matched) {
+        for (int nonesInARow = 0; nonesInARow <= bufferSize; ) {
+            uint32_t start = host::now();
+            ps2::KeyboardOutput code = keyboard.readScanCode();
+            require(host::now() - start <= maxReadMicroseconds, "readScanCode took too long");
+            if (code == ps2::KeyboardOutput::none) {
+                ++nonesInARow;
+                continue;
+            }
+            nonesInARow = 0;
+            if (code == ps2::KeyboardOutput::garbled) {
+                continue;
+            }
+            while (matched < goodBytes.size() && goodBytes[matched] != (byte)code) {
+                ++matched;
+            }
+            require(matched < goodBytes.size(), "readScanCode returned a byte that wasn't sent");
+            ++matched;
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    host::reset();
+    // NullDiagnostics::defaultInstance is a null pointer, which is fine on the board but not
+    //  under the undefined-behavior sanitizer.
+    ps2::NullDiagnostics diagnostics;
+    FuzzKeyboard keyboard(diagnostics);
+    keyboard.begin();
+
+    std::vector<byte> goodBytes;
+    size_t matched = 0;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint8_t control = data[i];
+        byte b = data[i + 1];
+        uint8_t kind = control & 7;
+        if (waitToSend()) {
+            sendFrame(kind, 1 + (control >> 4) % 10, b);
+            if (kind < 4) {
+                goodBytes.push_back(b);
+            }
+        }
+        uint32_t quiet = 20 + 100 * (control >> 4);
+        host::advance(kind == 7 && quiet < 6 * clockPeriod ? 6 * clockPeriod : quiet);
+        if (control & 8) {
+            drain(keyboard, goodBytes, matched);
+        }
+    }
+
+    // Let anything in progress time out and read what's left.  Then a good frame has to get
+    //  through.
+    host::advance(50000);
+    drain(keyboard, goodBytes, matched);
+    matched = goodBytes.size();
+    require(waitToSend(), "the host held the clock low for good");
+    sendFrame(0, 11, 0x1c);
+    goodBytes.push_back(0x1c);
+    host::advance(1000);
+    drain(keyboard, goodBytes, matched);
+    require(matched == goodBytes.size(), "a good frame didn't get through after the wire went quiet");
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Fuzz target for the three translators.  The input is a stream of bytes from the keyboard,
+//  garbage included, and it goes through UsbTranslator, AnsiTranslator and NeutralTranslator
+//  one byte at a time.  Out-of-bounds table lookups are the sanitizers' job; this checks that
+//  whatever state the garbage left behind, reset() followed by a complete sequence (A down,
+//  A up, A down) puts each translator back to translating normally.
+//
+//  Each byte is a table lookup or two, so the translators are limited by how fast the harness
+//  can call them:  several hundred thousand execs/s with the sanitizers on, and millions
+//  without.  ctest fails the run if it drops below 50,000 execs/s, which would mean something
+//  has started doing real work per byte.
+
+#include "Arduino.h"
+#include "ps2_UsbTranslator.h"
+#include "ps2_AnsiTranslator.h"
+#include "ps2_NeutralTranslator.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+namespace {
+    void require(bool isOk, const char *what) {
+        if (!isOk) {
+            fprintf(stderr, "TranslatorFuzz: %s\n", what);
+            abort();
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    ps2::NullDiagnostics diagnostics;
+    ps2::UsbTranslator<> usb(diagnostics);
+    ps2::AnsiTranslator<> ansi(diagnostics);
+    ps2::NeutralTranslator neutral;
+
+    for (size_t i = 0; i < size; ++i) {
+        ps2::KeyboardOutput code = (ps2::KeyboardOutput)data[i];
+        ps2::UsbKeyAction action = usb.translatePs2Keycode(code);
+        require(action.gesture == ps2::UsbKeyAction::KeyUp
+            || action.gesture == ps2::UsbKeyAction::KeyDown
+            || action.gesture == ps2::UsbKeyAction::None, "UsbTranslator returned a bad gesture");
+        ansi.translatePs2Keycode(code);
+        neutral.translatePs2Keycode(code);
+    }
+
+    usb.reset();
+    ansi.reset();
+    neutral.reset();
+
+    ps2::UsbKeyAction down = usb.translatePs2Keycode(ps2::KeyboardOutput::sc2_a);
+    require(down.gesture == ps2::UsbKeyAction::KeyDown && down.hidCode == 0x04, "UsbTranslator didn't recover");
+    usb.translatePs2Keycode(ps2::KeyboardOutput::unmake);
+    ps2::UsbKeyAction up = usb.translatePs2Keycode(ps2::KeyboardOutput::sc2_a);
+    require(up.gesture == ps2::UsbKeyAction::KeyUp && up.hidCode == 0x04, "UsbTranslator didn't translate A up");
+    down = usb.translatePs2Keycode(ps2::KeyboardOutput::sc2_a);
+    require(down.gesture == ps2::UsbKeyAction::KeyDown && down.hidCode == 0x04, "UsbTranslator didn't return to idle");
+
+    // Shift, Ctrl and Caps Lock survive reset(), so A can come out any of these ways.
+    for (int i = 0; i < 2; ++i) {
+        char c = ansi.translatePs2Keycode(ps2::KeyboardOutput::sc2_a);
+        require(c == 'a' || c == 'A' || c == 1, i == 0 ? "AnsiTranslator didn't recover" : "AnsiTranslator didn't return to idle");
+        require(ansi.translatePs2Keycode(ps2::KeyboardOutput::unmake) == '\0', "AnsiTranslator translated F0");
+        require(ansi.translatePs2Keycode(ps2::KeyboardOutput::sc2_a) == '\0', "AnsiTranslator translated A up");
+    }
+
+    // So do the modifiers NeutralTranslator reports, which are in the upper byte.
+    for (int i = 0; i < 2; ++i) {
+        ps2::KeyCode key = neutral.translatePs2Keycode(ps2::KeyboardOutput::sc2_a);
+        require(((uint16_t)key & 0xff) == ps2::KeyCode::PS2_KEY_A, i == 0 ? "NeutralTranslator didn't recover" : "NeutralTranslator didn't return to idle");
+        require(neutral.translatePs2Keycode(ps2::KeyboardOutput::unmake) == ps2::KeyCode::PS2_NONE, "NeutralTranslator translated F0");
+        require(neutral.translatePs2Keycode(ps2::KeyboardOutput::sc2_a) == ps2::KeyCode::PS2_NONE, "NeutralTranslator translated A up");
+    }
+    return 0;
+}
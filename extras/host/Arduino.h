@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+// A stand-in for the parts of the Arduino core this library and its examples use, for building
+//  them on a PC.  See HostShim.h for how the simulated hardware behaves.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "HostShim.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// The pin numbers of the LEDs on a Leonardo.
+#define LED_BUILTIN 13
+#define LED_BUILTIN_RX 17
+#define LED_BUILTIN_TX 30
+#define NOT_AN_INTERRUPT -1
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long milliseconds);
+void delayMicroseconds(unsigned int microseconds);
+
+void attachInterrupt(uint8_t interruptNumber, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interruptNumber);
+void interrupts();
+void noInterrupts();
+
+// Every pin can interrupt, and each pin is bit 0 of a port of its own.
+#define digitalPinToInterrupt(p) ((p) < host::pinCount ? (p) : NOT_AN_INTERRUPT)
+#define digitalPinToPort(p) (p)
+#define digitalPinToBitMask(p) 1
+#define portInputRegister(port) (&host::pinRegisters[port])
+
+// Timer 0 counts at 250kHz, as it does on a 16MHz board.  Timer 1 counts at 16MHz, as it
+//  does once PerfDiagnostics::begin has set it up; its control registers are just stored.
+#define TCNT0 (host::timer0())
+#define TCNT1 (host::timer1())
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+#define CS10 0
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class Print {
+    size_t printNumber(unsigned long n, uint8_t base);
+
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return str == nullptr ? 0 : this->write((const uint8_t *)str, strlen(str)); }
+    size_t write(const char *buffer, size_t size) { return this->write((const uint8_t *)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+
+    size_t print(const __FlashStringHelper *s) { return this->print(reinterpret_cast<const char *>(s)); }
+    size_t print(const char s[]) { return this->write(s); }
+    size_t print(char c) { return this->write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return this->print((unsigned long)n, base); }
+    size_t print(int n, int base = DEC) { return this->print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return this->print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println() { return this->write("\r\n"); }
+    template<typename T> size_t println(T value) { size_t n = this->print(value); return n + this->println(); }
+    template<typename T> size_t println(T value, int format) { size_t n = this->print(value, format); return n + this->println(); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud);
+    void end();
+    operator bool() { return true; }
+    void flush();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    int availableForWrite() override;
+    size_t write(uint8_t c) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,449 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include "Arduino.h"
+#include <avr/eeprom.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+namespace host {
+    volatile uint8_t pinRegisters[pinCount];
+
+    namespace {
+        // The simulated time, and whether devices are being stepped (an interrupt handler run
+        //  from a device's step can read the clock, but mustn't step the devices again).
+        uint32_t microseconds = 0;
+        bool isStepping = false;
+        std::vector<Device *> devices;
+
+        struct Pin {
+            uint8_t mode;
+            uint8_t portBit;    // the value last written, or whether the pull-up is on
+            bool isDeviceLow;
+            bool level;
+            void (*handler)();
+            int handlerMode;
+            bool isPending;
+        };
+        Pin pins[pinCount];
+
+        bool isInterruptEnabled = true;
+        bool isDispatching = false;
+
+        std::string output;
+        std::deque<char> input;
+        unsigned long baud = 0;
+        uint64_t transmitterBusyUntilNanoseconds = 0;
+        const int transmitBufferSize = 64;
+
+        const uint16_t eepromSize = E2END + 1;
+        const uint32_t eepromWriteMicroseconds = 3400;
+        uint8_t eeprom[eepromSize];
+        uint32_t eepromWrites[eepromSize];
+        uint32_t eepromBusyUntil = 0;
+        bool isEepromInitialized = false;
+
+        void runPendingHandlers() {
+            // A handler can cause an edge of its own (e.g. by pulling the clock low), which then
+            //  waits for it to finish, as on the board.
+            if (isDispatching) {
+                return;
+            }
+            isDispatching = true;
+            for (bool isAnyPending = true; isAnyPending && isInterruptEnabled; ) {
+                isAnyPending = false;
+                for (uint8_t i = 0; i < pinCount && isInterruptEnabled; ++i) {
+                    if (pins[i].isPending && pins[i].handler != nullptr) {
+                        pins[i].isPending = false;
+                        isAnyPending = true;
+                        isInterruptEnabled = false;
+                        isDispatching = false;
+                        pins[i].handler();
+                        isDispatching = true;
+                        isInterruptEnabled = true;
+                    }
+                }
+            }
+            isDispatching = false;
+        }
+
+        void updateLine(uint8_t pin) {
+            Pin &p = pins[pin];
+            bool isHostLow = p.mode == OUTPUT && p.portBit == LOW;
+            bool level = !isHostLow && !p.isDeviceLow;
+            if (level == p.level) {
+                return;
+            }
+
+            p.level = level;
+            pinRegisters[pin] = level ? 1 : 0;
+            if (p.handler != nullptr
+                && (p.handlerMode == CHANGE || (p.handlerMode == FALLING) == !level)) {
+                p.isPending = true;
+                runPendingHandlers();
+            }
+        }
+
+        void tick() {
+            ++microseconds;
+            if (!isStepping) {
+                isStepping = true;
+                for (size_t i = 0; i < devices.size(); ++i) {
+                    devices[i]->step(microseconds);
+                }
+                isStepping = false;
+            }
+        }
+
+        uint64_t byteTimeInNanoseconds() {
+            // A start bit, 8 data bits and a stop bit.
+            return 10000000000ULL / baud;
+        }
+
+        int bytesWaitingToTransmit() {
+            uint64_t nowNanoseconds = (uint64_t)microseconds * 1000;
+            if (baud == 0 || transmitterBusyUntilNanoseconds <= nowNanoseconds) {
+                return 0;
+            }
+            uint64_t byteTime = byteTimeInNanoseconds();
+            return (int)((transmitterBusyUntilNanoseconds - nowNanoseconds + byteTime - 1) / byteTime);
+        }
+
+        void initializeEeprom() {
+            if (!isEepromInitialized) {
+                eraseEeprom();
+            }
+        }
+
+        void waitForEeprom() {
+            initializeEeprom();
+            while ((int32_t)(microseconds - eepromBusyUntil) < 0) {
+                tick();
+            }
+        }
+
+        void programEeprom(uint16_t address, uint8_t value) {
+            waitForEeprom();
+            address &= E2END;
+            eeprom[address] = value;
+            ++eepromWrites[address];
+            eepromBusyUntil = microseconds + eepromWriteMicroseconds;
+        }
+    }
+
+    uint32_t now() {
+        return microseconds;
+    }
+
+    void advance(uint32_t us) {
+        for (uint32_t i = 0; i < us; ++i) {
+            tick();
+        }
+    }
+
+    void attach(Device &device) {
+        devices.push_back(&device);
+    }
+
+    void detach(Device &device) {
+        devices.erase(std::remove(devices.begin(), devices.end(), &device), devices.end());
+    }
+
+    void pullLow(uint8_t pin, bool isLow) {
+        pins[pin].isDeviceLow = isLow;
+        updateLine(pin);
+    }
+
+    bool isHigh(uint8_t pin) {
+        return pins[pin].level;
+    }
+
+    bool areInterruptsEnabled() {
+        return isInterruptEnabled;
+    }
+
+    bool disableInterrupts() {
+        bool wasEnabled = isInterruptEnabled;
+        isInterruptEnabled = false;
+        return wasEnabled;
+    }
+
+    void enableInterrupts() {
+        isInterruptEnabled = true;
+        runPendingHandlers();
+    }
+
+    uint8_t timer0() {
+        return (uint8_t)(microseconds / 4);
+    }
+
+    uint16_t timer1() {
+        return (uint16_t)(microseconds * 16);
+    }
+
+    std::string &serialOutput() {
+        return output;
+    }
+
+    void serialInput(const char *text) {
+        input.insert(input.end(), text, text + strlen(text));
+    }
+
+    uint32_t eepromWriteCount(uint16_t address) {
+        initializeEeprom();
+        return eepromWrites[address & E2END];
+    }
+
+    void eraseEeprom() {
+        memset(eeprom, 0xff, sizeof(eeprom));
+        memset(eepromWrites, 0, sizeof(eepromWrites));
+        isEepromInitialized = true;
+    }
+
+    void reset() {
+        microseconds = 0;
+        isStepping = false;
+        devices.clear();
+        for (uint8_t i = 0; i < pinCount; ++i) {
+            pins[i] = Pin{ INPUT, LOW, false, true, nullptr, 0, false };
+            pinRegisters[i] = 1;
+        }
+        isInterruptEnabled = true;
+        isDispatching = false;
+        output.clear();
+        input.clear();
+        baud = 0;
+        transmitterBusyUntilNanoseconds = 0;
+        eepromBusyUntil = 0;
+    }
+
+    namespace {
+        struct PowerOn {
+            PowerOn() { reset(); }
+        } powerOn;
+    }
+}
+
+using namespace host;
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= pinCount) {
+        return;
+    }
+    pins[pin].mode = mode == OUTPUT ? OUTPUT : INPUT;
+    if (mode == INPUT_PULLUP) {
+        pins[pin].portBit = HIGH;
+    }
+    else if (mode == INPUT) {
+        pins[pin].portBit = LOW;
+    }
+    updateLine(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= pinCount) {
+        return;
+    }
+    pins[pin].portBit = value == LOW ? LOW : HIGH;
+    updateLine(pin);
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < pinCount && pins[pin].level ? HIGH : LOW;
+}
+
+unsigned long micros() {
+    tick();
+    return microseconds;
+}
+
+unsigned long millis() {
+    tick();
+    return microseconds / 1000;
+}
+
+void delay(unsigned long milliseconds) {
+    advance(milliseconds * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    advance(us);
+}
+
+void attachInterrupt(uint8_t interruptNumber, void (*handler)(), int mode) {
+    if (interruptNumber < pinCount) {
+        pins[interruptNumber].handler = handler;
+        pins[interruptNumber].handlerMode = mode;
+        pins[interruptNumber].isPending = false;
+    }
+}
+
+void detachInterrupt(uint8_t interruptNumber) {
+    if (interruptNumber < pinCount) {
+        pins[interruptNumber].handler = nullptr;
+        pins[interruptNumber].isPending = false;
+    }
+}
+
+void interrupts() {
+    enableInterrupts();
+}
+
+void noInterrupts() {
+    disableInterrupts();
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        n += this->write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    if (base < 2) {
+        base = 10;
+    }
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return this->write(str);
+}
+
+size_t Print::print(long n, int base) {
+    if (base == 0) {
+        return this->write((uint8_t)n);
+    }
+    else if (base == 10 && n < 0) {
+        return this->print('-') + this->printNumber(-(unsigned long)n, 10);
+    }
+    return this->printNumber((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    if (base == 0) {
+        return this->write((uint8_t)n);
+    }
+    return this->printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return this->write(buf);
+}
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baudRate) {
+    baud = baudRate;
+    transmitterBusyUntilNanoseconds = 0;
+}
+
+void HardwareSerial::end() {
+    this->flush();
+    baud = 0;
+}
+
+void HardwareSerial::flush() {
+    while (bytesWaitingToTransmit() > 0) {
+        tick();
+    }
+}
+
+int HardwareSerial::available() {
+    return (int)input.size();
+}
+
+int HardwareSerial::read() {
+    if (input.empty()) {
+        return -1;
+    }
+    char c = input.front();
+    input.pop_front();
+    return (uint8_t)c;
+}
+
+int HardwareSerial::peek() {
+    return input.empty() ? -1 : (uint8_t)input.front();
+}
+
+int HardwareSerial::availableForWrite() {
+    // The Arduino core keeps one slot of its ring buffer empty.
+    return transmitBufferSize - 1 - std::min(bytesWaitingToTransmit(), transmitBufferSize - 1);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (baud != 0) {
+        while (this->availableForWrite() == 0) {
+            tick();
+        }
+        uint64_t nowNanoseconds = (uint64_t)microseconds * 1000;
+        transmitterBusyUntilNanoseconds = std::max(transmitterBusyUntilNanoseconds, nowNanoseconds) + byteTimeInNanoseconds();
+    }
+    output.push_back((char)c);
+    return 1;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address) {
+    initializeEeprom();
+    return eeprom[(uintptr_t)address & E2END];
+}
+
+uint16_t eeprom_read_word(const uint16_t *address) {
+    const uint8_t *p = (const uint8_t *)address;
+    return eeprom_read_byte(p) | (eeprom_read_byte(p + 1) << 8);
+}
+
+void eeprom_write_byte(uint8_t *address, uint8_t value) {
+    programEeprom((uint16_t)(uintptr_t)address, value);
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value) {
+    if (eeprom_read_byte(address) != value) {
+        eeprom_write_byte(address, value);
+    }
+}
+
+void eeprom_write_word(uint16_t *address, uint16_t value) {
+    uint8_t *p = (uint8_t *)address;
+    eeprom_write_byte(p, (uint8_t)value);
+    eeprom_write_byte(p + 1, (uint8_t)(value >> 8));
+}
+
+void eeprom_update_word(uint16_t *address, uint16_t value) {
+    uint8_t *p = (uint8_t *)address;
+    eeprom_update_byte(p, (uint8_t)value);
+    eeprom_update_byte(p + 1, (uint8_t)(value >> 8));
+}
+
+bool eeprom_is_ready() {
+    initializeEeprom();
+    return (int32_t)(microseconds - eepromBusyUntil) >= 0;
+}
@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+// Everything a test or simulation uses to drive the stand-in for the Arduino core in this
+//  directory.  The library itself never includes this; it only sees Arduino.h, util/atomic.h
+//  and the rest, which behave closely enough to the real thing that the library's headers
+//  compile and run unmodified.
+//
+//  Time is virtual.  It starts at 0 and only moves when something asks it to:  every call to
+//  micros() or millis() takes 1us (so the library's busy-waits make progress), delay and
+//  delayMicroseconds take as long as they say, and a test can call host::advance.  Whenever
+//  time moves, each attached host::Device gets a step() call for every microsecond, which is
+//  where a simulated keyboard or mouse drives its clock and data lines.
+//
+//  The pins are open-collector lines with pull-ups, as on a PS2 port:  a line is low if
+//  either the sketch (with pinMode OUTPUT and digitalWrite LOW) or a device (host::pullLow)
+//  holds it low.  An edge on a pin with an attachInterrupt handler runs the handler straight
+//  away, or, if interrupts are off, as soon as they're turned back on, as an AVR would.
+//  Handlers run with interrupts off, so they don't nest unless they turn interrupts on
+//  themselves.
+//
+//  Serial output is kept in host::serialOutput().  Once Serial.begin has been called, writing
+//  takes as long as it would at that baud rate and availableForWrite reports the room left
+//  in a 64-byte transmit buffer.  The EEPROM starts erased (all 0xff), takes 3.4ms to program
+//  a byte, and counts the writes to each cell.
+
+#include <stdint.h>
+#include <string>
+
+namespace host {
+    static const uint8_t pinCount = 32;
+
+    /** \brief A simulated piece of hardware on the other end of the pins. */
+    class Device {
+    public:
+        /** \brief Called once for each microsecond of virtual time, after the clock moves. */
+        virtual void step(uint32_t nowMicroseconds) = 0;
+    };
+
+    /** \brief Returns the virtual time in microseconds. */
+    uint32_t now();
+
+    /** \brief Moves virtual time forward, stepping the attached devices as it goes. */
+    void advance(uint32_t microseconds);
+
+    void attach(Device &device);
+    void detach(Device &device);
+
+    /** \brief Holds a line low from the device side, or lets it go. */
+    void pullLow(uint8_t pin, bool isLow);
+
+    /** \brief Returns true if nothing is holding the line low. */
+    bool isHigh(uint8_t pin);
+
+    /** \brief Returns true if interrupts are on, i.e. not in a handler or an ATOMIC_BLOCK. */
+    bool areInterruptsEnabled();
+
+    /** \brief Everything written to Serial so far. */
+    std::string &serialOutput();
+
+    /** \brief Makes text available to Serial.read. */
+    void serialInput(const char *text);
+
+    /** \brief Returns how many times the EEPROM cell at address has been programmed. */
+    uint32_t eepromWriteCount(uint16_t address);
+
+    /** \brief Sets every EEPROM cell back to 0xff and its write count to 0. */
+    void eraseEeprom();
+
+    /** \brief Puts everything but the EEPROM back the way it was at power-on:  time is 0, the
+     *         pins are released, handlers and devices are detached and Serial is empty.
+     */
+    void reset();
+
+    // The rest is used by Arduino.h and util/atomic.h.
+    bool disableInterrupts();
+    void enableInterrupts();
+    uint8_t timer0();
+    uint16_t timer1();
+    extern volatile uint8_t pinRegisters[pinCount];
+
+    class AtomicSection {
+        bool wasEnabled;
+        bool isForceOn;
+
+    public:
+        AtomicSection(bool forceOn)
+            : wasEnabled(disableInterrupts()), isForceOn(forceOn)
+        {
+        }
+
+        ~AtomicSection() {
+            if (this->isForceOn || this->wasEnabled) {
+                enableInterrupts();
+            }
+        }
+    };
+
+    class NonAtomicSection {
+        bool wasEnabled;
+        bool isForceOff;
+
+    public:
+        NonAtomicSection(bool forceOff)
+            : wasEnabled(areInterruptsEnabled()), isForceOff(forceOff)
+        {
+            enableInterrupts();
+        }
+
+        ~NonAtomicSection() {
+            if (this->isForceOff || !this->wasEnabled) {
+                disableInterrupts();
+            }
+        }
+    };
+}
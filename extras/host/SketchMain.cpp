@@ -0,0 +1,35 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// The main() the Arduino core would supply, for building a sketch on a PC:  it runs setup()
+//  and then loop(), a set number of times so that it finishes.
+
+#include "Arduino.h"
+
+void setup();
+void loop();
+
+int main(int argc, char *argv[]) {
+    long loops = argc > 1 ? atol(argv[1]) : 1000;
+    setup();
+    for (long i = 0; i < loops; ++i) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// A 1KB EEPROM (as on an ATmega328P) that's slow to write; see HostShim.h.
+
+#include <stdint.h>
+
+#define E2END 0x3ff
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+uint16_t eeprom_read_word(const uint16_t *address);
+void eeprom_write_byte(uint8_t *address, uint8_t value);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+void eeprom_write_word(uint16_t *address, uint16_t value);
+void eeprom_update_word(uint16_t *address, uint16_t value);
+bool eeprom_is_ready();
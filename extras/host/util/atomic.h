@@ -0,0 +1,19 @@
+#pragma once
+
+// ATOMIC_BLOCK and NONATOMIC_BLOCK turn the simulated interrupts off and on the way avr-libc's
+//  do, including the handlers for any edges that came in meanwhile running at the end of the
+//  block.  Note that ATOMIC_FORCEON turns interrupts on at the end even inside an interrupt
+//  handler, just as it does on the board.
+
+#include "HostShim.h"
+
+#define ATOMIC_RESTORESTATE false
+#define ATOMIC_FORCEON true
+#define NONATOMIC_RESTORESTATE false
+#define NONATOMIC_FORCEOFF true
+
+#define ATOMIC_BLOCK(type) \
+    for (host::AtomicSection atomicSection_(type), *atomicSectionOnce_ = &atomicSection_; atomicSectionOnce_; atomicSectionOnce_ = nullptr)
+
+#define NONATOMIC_BLOCK(type) \
+    for (host::NonAtomicSection nonAtomicSection_(type), *nonAtomicSectionOnce_ = &nonAtomicSection_; nonAtomicSectionOnce_; nonAtomicSectionOnce_ = nullptr)
@@ -0,0 +1,200 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Works out the smallest BufferSize that loses nothing, for the table in the "Sizing the
+//  Buffer" section of ps2_Keyboard.h.  A simulated keyboard sends each of the bursts in that
+//  table while the loop calls readScanCode once per interval, taking one byte each time.  A
+//  size loses nothing if every byte arrives, in order, with no bufferOverflow - whatever
+//  point in the interval the burst starts at.  "-" means no size up to 16 is enough.
+//
+//  With no arguments it prints the table at the fastest clock the protocol allows (16.7KHz)
+//  and at the slowest (10KHz).  "--check" prints just the first and fails if it doesn't match
+//  the one in ps2_Keyboard.h; ctest runs that.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "Ps2DeviceSim.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+    const int dataPin = 4;
+    const int clockPin = 3;
+    const uint8_t maxBufferSize = 16;
+
+    class CountingDiagnostics : public ps2::NullDiagnostics {
+    public:
+        uint32_t overflows = 0;
+        void bufferOverflow() { ++this->overflows; }
+    };
+
+    // Bytes the keyboard queues at a point in time, relative to the start of the scenario.
+    struct Burst {
+        uint32_t at;
+        std::vector<byte> bytes;
+    };
+
+    struct Scenario {
+        const char *name;
+        std::vector<Burst> bursts;
+    };
+
+    std::vector<Scenario> scenarios() {
+        std::vector<Scenario> result;
+        result.push_back({ "Pause key (8 bytes)",
+            { { 0, { 0xe1, 0x14, 0x77, 0xe1, 0xf0, 0x14, 0xf0, 0x77 } } } });
+        result.push_back({ "Print Screen (4 bytes down, 6 up)",
+            { { 0, { 0xe0, 0x12, 0xe0, 0x7c } }, { 100000, { 0xe0, 0xf0, 0x7c, 0xe0, 0xf0, 0x12 } } } });
+        result.push_back({ "6 keys rolled down together, then up",
+            { { 0, { 0x1c, 0x1b, 0x23, 0x2b, 0x34, 0x33 } },
+              { 100000, { 0xf0, 0x1c, 0xf0, 0x1b, 0xf0, 0x23, 0xf0, 0x2b, 0xf0, 0x34, 0xf0, 0x33 } } } });
+        Scenario repeat = { "An extended key held down (30 repeats/sec)", {} };
+        for (uint32_t i = 0; i < 90; ++i) {
+            repeat.bursts.push_back({ i * 1000000 / 30, { 0xe0, 0x75 } });
+        }
+        result.push_back(repeat);
+        return result;
+    }
+
+    template <uint8_t BufferSize>
+    bool losesNothing(const Scenario &scenario, uint16_t clockPeriod, uint32_t interval, uint32_t phase) {
+        host::reset();
+        CountingDiagnostics diagnostics;
+        ps2::Keyboard<dataPin, clockPin, BufferSize, CountingDiagnostics> keyboard(diagnostics);
+        sim::KeyboardSim device(dataPin, clockPin);
+        device.timing.clockPeriod = clockPeriod;
+
+        keyboard.begin();
+        device.plugIn(1000);
+        host::advance(5000);
+        while (keyboard.readScanCode() != ps2::KeyboardOutput::none) {
+        }
+        diagnostics.overflows = 0;
+
+        std::vector<byte> sent;
+        std::vector<byte> arrived;
+        size_t nextBurst = 0;
+        uint32_t start = host::now();
+        uint32_t nextRead = start + phase;
+        for (;;) {
+            uint32_t now = host::now();
+            while (nextBurst < scenario.bursts.size() && now - start >= scenario.bursts[nextBurst].at) {
+                for (byte b : scenario.bursts[nextBurst].bytes) {
+                    device.send(b);
+                    sent.push_back(b);
+                }
+                ++nextBurst;
+            }
+            if ((int32_t)(now - nextRead) >= 0) {
+                ps2::KeyboardOutput code = keyboard.readScanCode();
+                if (code != ps2::KeyboardOutput::none) {
+                    arrived.push_back((byte)code);
+                }
+                else if (nextBurst == scenario.bursts.size() && device.isQuiet()) {
+                    break;
+                }
+                nextRead += interval;
+            }
+            if (diagnostics.overflows != 0) {
+                return false;
+            }
+            host::advance(50);
+        }
+        return diagnostics.overflows == 0 && arrived == sent;
+    }
+
+    typedef bool (*Runner)(const Scenario &, uint16_t, uint32_t, uint32_t);
+
+    template <uint8_t BufferSize>
+    void addRunners(std::vector<Runner> &runners) {
+        addRunners<BufferSize - 1>(runners);
+        runners.push_back(&losesNothing<BufferSize>);
+    }
+
+    template <>
+    void addRunners<0>(std::vector<Runner> &) {
+    }
+
+    // The smallest size that loses nothing wherever in the interval the scenario starts, or 0.
+    uint8_t smallestSize(const std::vector<Runner> &runners, const Scenario &scenario, uint16_t clockPeriod, uint32_t interval) {
+        const uint32_t phaseCount = 5;
+        for (uint8_t size = 1; size <= runners.size(); ++size) {
+            bool isEnough = true;
+            for (uint32_t p = 0; p < phaseCount && isEnough; ++p) {
+                isEnough = runners[size - 1](scenario, clockPeriod, interval, interval * p / phaseCount);
+            }
+            if (isEnough) {
+                return size;
+            }
+        }
+        return 0;
+    }
+
+    const uint32_t intervals[] = { 1000, 2000, 5000, 10000, 20000 };
+    const uint8_t intervalCount = sizeof(intervals) / sizeof(intervals[0]);
+
+    // The table in ps2_Keyboard.h, with 0 for "-".
+    const uint8_t documented[4][intervalCount] = {
+        { 4, 6, 7, 8, 8 },
+        { 3, 5, 6, 6, 6 },
+        { 5, 9, 11, 12, 13 },
+        { 2, 2, 2, 2, 0 },
+    };
+
+    // Prints the table for one clock rate and returns the number of entries that don't match
+    //  the documented one.
+    int printTable(const std::vector<Runner> &runners, uint16_t clockPeriod) {
+        int mismatches = 0;
+        printf("At %.1fKHz:\n\n", 1000.0 / clockPeriod);
+        printf("    Interval between calls:                        1ms   2ms   5ms  10ms  20ms\n");
+        std::vector<Scenario> all = scenarios();
+        for (size_t s = 0; s < all.size(); ++s) {
+            printf("    %-45s", all[s].name);
+            for (uint8_t i = 0; i < intervalCount; ++i) {
+                uint8_t size = smallestSize(runners, all[s], clockPeriod, intervals[i]);
+                if (size == 0) {
+                    printf("     -");
+                }
+                else {
+                    printf("  %4u", size);
+                }
+                if (size != documented[s][i]) {
+                    ++mismatches;
+                }
+            }
+            printf("\n");
+        }
+        printf("\n");
+        return mismatches;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool isCheck = argc > 1 && strcmp(argv[1], "--check") == 0;
+    std::vector<Runner> runners;
+    addRunners<maxBufferSize>(runners);
+
+    int mismatches = printTable(runners, 60);
+    if (isCheck) {
+        printf(mismatches == 0 ? "passed\n" : "%d entries differ from ps2_Keyboard.h\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+    }
+    printTable(runners, 100);
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Works out how long the clock interrupt can be held off before Keyboard misreads a byte, for
+//  the table at the end of the Keyboard class's documentation in ps2_Keyboard.h.  Interrupts
+//  are kept off except for a moment a set delay after each falling clock edge, so the handler
+//  runs exactly that long after the edge, as it would behind another handler that took that
+//  long.  The simulated keyboard changes the data line 5us into the clock's high half.
+//
+//  For each clock rate it prints, for each delay, how many of a run of bytes arrived intact,
+//  and then the longest delay that lost nothing.  "--check" prints just the longest delays
+//  and fails if they don't match ps2_Keyboard.h; ctest runs that.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "Ps2DeviceSim.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+    const int dataPin = 4;
+    const int clockPin = 3;
+
+    // Holds interrupts off, letting them through a fixed time after each falling clock edge.
+    //  It has to be attached after the keyboard so that it sees each edge in the microsecond
+    //  the keyboard makes it.
+    class InterruptDelay : public host::Device {
+        uint32_t delay;
+        bool wasClockHigh = true;
+        bool isEdgeWaiting = false;
+        uint32_t releaseAt = 0;
+
+    public:
+        InterruptDelay(uint32_t delay) : delay(delay) {}
+
+        void step(uint32_t now) override {
+            bool isClockHigh = host::isHigh(clockPin);
+            if (this->wasClockHigh && !isClockHigh) {
+                this->isEdgeWaiting = true;
+                this->releaseAt = now + this->delay;
+            }
+            this->wasClockHigh = isClockHigh;
+            if (this->isEdgeWaiting && (int32_t)(now - this->releaseAt) >= 0) {
+                this->isEdgeWaiting = false;
+                host::enableInterrupts();
+                host::disableInterrupts();
+            }
+        }
+    };
+
+    // Sends byteCount bytes with the interrupt held off for delay after each edge and returns
+    //  how many of them arrived intact.
+    uint32_t intactBytes(uint16_t clockPeriod, uint32_t delay, uint32_t byteCount) {
+        host::reset();
+        ps2::Keyboard<dataPin, clockPin, 16> keyboard;
+        sim::KeyboardSim device(dataPin, clockPin);
+        device.timing.clockPeriod = clockPeriod;
+
+        keyboard.begin();
+        device.plugIn(1000);
+        host::advance(5000);
+        while (keyboard.readScanCode() != ps2::KeyboardOutput::none) {
+        }
+
+        InterruptDelay interruptDelay(delay);
+        host::attach(interruptDelay);
+        sim::Random random(clockPeriod);
+        uint32_t intact = 0;
+        for (uint32_t i = 0; i < byteCount; ++i) {
+            // Stay clear of the bytes readScanCode handles itself (0xaa, 0xfa, 0xfe and so on).
+            byte b = (byte)(1 + random.below(0x7f));
+            device.send(b);
+
+            host::disableInterrupts();
+            host::advance(11 * clockPeriod + 500);
+            host::enableInterrupts();
+
+            ps2::KeyboardOutput code = keyboard.readScanCode();
+            if (code == (ps2::KeyboardOutput)b && keyboard.readScanCode() == ps2::KeyboardOutput::none) {
+                ++intact;
+            }
+            else {
+                // Let the resend (if any) go through undelayed, and carry on.
+                host::detach(interruptDelay);
+                host::advance(20000);
+                while (keyboard.readScanCode() != ps2::KeyboardOutput::none) {
+                }
+                host::attach(interruptDelay);
+            }
+        }
+        return intact;
+    }
+
+    const uint16_t clockPeriods[] = { 100, 83, 71, 60 };
+    const char *clockNames[] = { "10KHz", "12KHz", "14KHz", "16.7KHz" };
+    // The table in ps2_Keyboard.h.
+    const uint32_t documented[] = { 54, 45, 39, 34 };
+}
+
+int main(int argc, char *argv[]) {
+    bool isCheck = argc > 1 && strcmp(argv[1], "--check") == 0;
+    const uint32_t byteCount = 20;
+    int mismatches = 0;
+
+    if (!isCheck) {
+        printf("Bytes intact out of %u, by how long the interrupt is held off:\n\n", byteCount);
+        printf("delay   ");
+        for (const char *name : clockNames) {
+            printf("  %7s", name);
+        }
+        printf("\n");
+        for (uint32_t delay = 0; delay <= 100; delay += 5) {
+            printf("%3uus   ", delay);
+            for (uint16_t clockPeriod : clockPeriods) {
+                if (delay < clockPeriod) {
+                    printf("  %7u", intactBytes(clockPeriod, delay, byteCount));
+                }
+                else {
+                    printf("  %7s", "");
+                }
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    printf("Keyboard clock:   ");
+    for (const char *name : clockNames) {
+        printf("  %7s", name);
+    }
+    printf("\nMaximum delay:    ");
+    for (size_t c = 0; c < sizeof(clockPeriods) / sizeof(clockPeriods[0]); ++c) {
+        uint32_t longest = 0;
+        while (longest + 1 < clockPeriods[c] && intactBytes(clockPeriods[c], longest + 1, byteCount) == byteCount) {
+            ++longest;
+        }
+        printf("  %5uus", longest);
+        if (longest != documented[c]) {
+            ++mismatches;
+        }
+    }
+    printf("\n");
+
+    if (isCheck) {
+        printf(mismatches == 0 ? "passed\n" : "%d entries differ from ps2_Keyboard.h\n", mismatches);
+    }
+    return isCheck && mismatches != 0 ? 1 : 0;
+}
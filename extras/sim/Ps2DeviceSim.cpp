@@ -0,0 +1,501 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include "Ps2DeviceSim.h"
+
+namespace sim {
+    void Ps2Device::setClock(bool low) {
+        host::pullLow(this->clockPin, low);
+    }
+
+    void Ps2Device::setData(bool low) {
+        host::pullLow(this->dataPin, low);
+    }
+
+    uint16_t Ps2Device::halfPeriod() {
+        int half = this->timing.clockPeriod / 2;
+        if (this->timing.jitter != 0) {
+            half += (int)this->random.below(2 * this->timing.jitter + 1) - this->timing.jitter;
+        }
+        return half < 5 ? 5 : (uint16_t)half;
+    }
+
+    void Ps2Device::plugIn(uint32_t batDelayMicroseconds) {
+        if (!this->isAttached) {
+            host::attach(*this);
+            this->isAttached = true;
+        }
+        this->state = State::idle;
+        this->setClock(false);
+        this->setData(false);
+        this->hostReleasedClockAt = host::now();
+        this->restart(batDelayMicroseconds);
+    }
+
+    void Ps2Device::unplug() {
+        this->state = State::off;
+        this->setClock(false);
+        this->setData(false);
+        this->output.clear();
+        this->scheduled.clear();
+        this->isAbortedByteWaiting = false;
+        this->isFaultedFrameUnanswered = false;
+    }
+
+    void Ps2Device::restart(uint32_t selfTestMicroseconds) {
+        this->output.clear();
+        this->scheduled.clear();
+        this->isAbortedByteWaiting = false;
+        this->onReset();
+        this->selfTestEndsAt = host::now() + selfTestMicroseconds;
+        for (byte b : this->selfTestResult) {
+            this->sendAfter(selfTestMicroseconds, b);
+        }
+    }
+
+    void Ps2Device::send(std::initializer_list<byte> bytes) {
+        this->output.insert(this->output.end(), bytes);
+    }
+
+    void Ps2Device::send(byte b) {
+        this->output.push_back(b);
+    }
+
+    void Ps2Device::answer(std::initializer_list<byte> bytes) {
+        auto position = this->output.begin();
+        if (this->isAbortedByteSentFirst && this->isAbortedByteWaiting && !this->output.empty()) {
+            ++position;
+        }
+        this->output.insert(position, bytes);
+        this->earliestSend = host::now() + this->timing.responseDelay;
+    }
+
+    void Ps2Device::sendAfter(uint32_t delayMicroseconds, byte b) {
+        this->scheduled.push_back(std::make_pair(host::now() + delayMicroseconds, b));
+    }
+
+    void Ps2Device::clearOutput() {
+        bool keepFirst = this->isAbortedByteSentFirst && this->isAbortedByteWaiting && !this->output.empty();
+        this->output.erase(this->output.begin() + (keepFirst ? 1 : 0), this->output.end());
+        if (!keepFirst) {
+            this->isAbortedByteWaiting = false;
+        }
+    }
+
+    void Ps2Device::step(uint32_t now) {
+        switch (this->state) {
+        case State::off:
+            break;
+
+        case State::idle:
+            for (auto it = this->scheduled.begin(); it != this->scheduled.end(); ) {
+                if ((int32_t)(now - it->first) >= 0) {
+                    this->output.push_back(it->second);
+                    it = this->scheduled.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+
+            if (!host::isHigh(this->clockPin)) {
+                // The host is holding us off (or is about to send something).
+                if (this->isFaultedFrameUnanswered) {
+                    uint32_t delay = now - this->faultedFrameEndedAt;
+                    ++this->statistics.resendsTimed;
+                    this->statistics.resendDelayTotal += delay;
+                    if (delay > this->statistics.resendDelayMax) {
+                        this->statistics.resendDelayMax = delay;
+                    }
+                    this->isFaultedFrameUnanswered = false;
+                }
+                this->hostReleasedClockAt = now;
+            }
+            else if (!host::isHigh(this->dataPin)) {
+                if (now - this->hostReleasedClockAt >= this->timing.requestToSendDelay
+                 && (int32_t)(now - this->selfTestEndsAt) >= 0) {
+                    this->state = State::receiving;
+                    this->bitIndex = 0;
+                    this->phase = 0;
+                    this->received = 0;
+                    this->receivedParity = 0;
+                    this->nextTime = now;
+                    this->stepReceiving(now);
+                }
+            }
+            else if (!this->output.empty()
+                && now - this->hostReleasedClockAt >= 50
+                && (int32_t)(now - this->earliestSend) >= 0) {
+                this->startFrame(now);
+            }
+            break;
+
+        case State::sending:
+            if ((int32_t)(now - this->nextTime) >= 0) {
+                this->stepSending(now);
+            }
+            break;
+
+        case State::receiving:
+            if ((int32_t)(now - this->nextTime) >= 0) {
+                this->stepReceiving(now);
+            }
+            break;
+        }
+    }
+
+    void Ps2Device::startFrame(uint32_t now) {
+        this->sending = this->output.front();
+        this->output.pop_front();
+
+        uint8_t parity = 1;
+        this->frame[0] = 0;
+        for (int i = 0; i < 8; ++i) {
+            this->frame[1 + i] = (this->sending >> i) & 1;
+            parity ^= this->frame[1 + i];
+        }
+        this->frame[9] = parity;
+        this->frame[10] = 1;
+
+        this->droppedBit = -1;
+        this->isFaultedFrameUnanswered = false;
+        this->isFaulted = true;
+        if (this->random.chance(this->faults.parity)) {
+            this->frame[9] ^= 1;
+        }
+        else if (this->random.chance(this->faults.startBit)) {
+            this->frame[0] = 1;
+        }
+        else if (this->random.chance(this->faults.stopBit)) {
+            this->frame[10] = 0;
+        }
+        else if (this->random.chance(this->faults.droppedEdge)) {
+            this->droppedBit = (int8_t)(1 + this->random.below(10));
+        }
+        else {
+            this->isFaulted = false;
+        }
+
+        this->state = State::sending;
+        this->bitIndex = 0;
+        this->phase = 0;
+        this->stepSending(now);
+    }
+
+    void Ps2Device::stepSending(uint32_t now) {
+        switch (this->phase) {
+        case 0:
+            // Partway into the clock's high half, put out the next bit.
+            this->setData(this->frame[this->bitIndex] == 0);
+            this->phase = 1;
+            {
+                int setup = (int)this->halfPeriod() - this->timing.dataDelay;
+                this->nextTime = now + (setup < 1 ? 1 : setup);
+            }
+            break;
+
+        case 1:
+            if (!host::isHigh(this->clockPin)) {
+                // The host pulled the clock low before the 11th clock, so this byte has to go
+                //  again once it lets go.
+                this->output.push_front(this->sending);
+                this->isAbortedByteWaiting = true;
+                ++this->statistics.framesAborted;
+                this->setData(false);
+                this->state = State::idle;
+                this->hostReleasedClockAt = now;
+                break;
+            }
+            if (this->bitIndex != this->droppedBit) {
+                this->setClock(true);
+            }
+            this->phase = 2;
+            this->nextTime = now + this->halfPeriod();
+            break;
+
+        case 2:
+            this->setClock(false);
+            if (++this->bitIndex == 11) {
+                this->setData(false);
+                this->state = State::idle;
+                this->lastSent = this->sending;
+                this->isAbortedByteWaiting = false;
+                ++this->statistics.framesSent;
+                if (this->isFaulted) {
+                    ++this->statistics.faultsInjected;
+                    this->isFaultedFrameUnanswered = true;
+                    this->faultedFrameEndedAt = now;
+                }
+                this->earliestSend = now + this->timing.byteGap;
+                break;
+            }
+            this->phase = 0;
+            this->nextTime = now + this->timing.dataDelay;
+            break;
+        }
+    }
+
+    void Ps2Device::stepReceiving(uint32_t now) {
+        if (this->phase == 0) {
+            // The host changes the data line on this edge, in its interrupt handler.
+            this->setClock(true);
+            this->phase = 1;
+            this->nextTime = now + this->halfPeriod();
+            return;
+        }
+
+        // ...and the device reads it when the clock goes back up.
+        this->setClock(false);
+        uint8_t bit = host::isHigh(this->dataPin) ? 1 : 0;
+        if (this->bitIndex >= 1 && this->bitIndex <= 8) {
+            this->received |= bit << (this->bitIndex - 1);
+            this->receivedParity ^= bit;
+        }
+        else if (this->bitIndex == 9) {
+            this->receivedParity ^= bit;
+        }
+        else if (this->bitIndex == 10) {
+            this->receivedStop = bit != 0;
+            this->setData(true); // the acknowledge bit
+        }
+        else if (this->bitIndex == 11) {
+            this->setData(false);
+            this->finishReceiving(now);
+            return;
+        }
+        ++this->bitIndex;
+        this->phase = 0;
+        this->nextTime = now + this->halfPeriod();
+    }
+
+    void Ps2Device::finishReceiving(uint32_t now) {
+        this->state = State::idle;
+        this->hostReleasedClockAt = now;
+        ++this->statistics.bytesReceived;
+        if (this->receivedParity != 1 || !this->receivedStop) {
+            ++this->statistics.badFramesReceived;
+            this->answer({ 0xfe });
+        }
+        else if (this->received == 0xfe) {
+            ++this->statistics.resendRequests;
+            this->answer({ this->lastSent });
+        }
+        else {
+            this->onCommand(this->received);
+        }
+    }
+
+    void KeyboardSim::onReset() {
+        this->leds = 0;
+        this->scanCodeSet = 2;
+        this->typematic = 0x2b;
+        this->isScanning = true;
+        this->pendingCommand = -1;
+    }
+
+    void KeyboardSim::type(std::initializer_list<byte> bytes) {
+        if (this->isScanning && this->isPluggedIn()) {
+            this->send(bytes);
+        }
+    }
+
+    void KeyboardSim::onCommand(byte b) {
+        this->commandLog.push_back(b);
+
+        // Most commands take one argument; the ones that set key behavior take a list of keys,
+        //  ended by the next command.  A command in place of an argument starts over, as
+        //  when the host gives up on an argument the keyboard keeps asking for again.
+        if (this->pendingCommand >= 0 && b < 0xed) {
+            switch (this->pendingCommand) {
+            case 0xed:
+                this->leds = b;
+                break;
+            case 0xf3:
+                this->typematic = b;
+                break;
+            case 0xf0:
+                if (b == 0) {
+                    this->pendingCommand = -1;
+                    this->answer({ 0xfa, this->scanCodeSet });
+                    return;
+                }
+                if (b == 3 && this->set3Support == Set3Support::refused) {
+                    // It keeps asking, and the host eventually gives up.
+                    this->answer({ 0xfe });
+                    return;
+                }
+                if (b != 3 || this->set3Support == Set3Support::supported) {
+                    this->scanCodeSet = b;
+                }
+                break;
+            default:
+                this->answer({ 0xfa });
+                return;
+            }
+            this->pendingCommand = -1;
+            this->answer({ 0xfa });
+            return;
+        }
+
+        this->pendingCommand = -1;
+        switch (b) {
+        case 0xff:
+            this->restart(this->timing.selfTestDuration);
+            this->answer({ 0xfa });
+            break;
+        case 0xee:
+            if (this->isEchoSupported) {
+                this->answer({ 0xee });
+            }
+            break;
+        case 0xf2:
+            if (this->idLength == 0) {
+                this->answer({ 0xfa });
+            }
+            else if (this->idLength == 1) {
+                this->answer({ 0xfa, this->id[0] });
+            }
+            else {
+                this->answer({ 0xfa, this->id[0], this->id[1] });
+            }
+            break;
+        case 0xf4:
+            this->clearOutput();
+            this->isScanning = true;
+            this->answer({ 0xfa });
+            break;
+        case 0xf5:
+        case 0xf6: {
+            // These put the settings back to the defaults, except for the LEDs.
+            uint8_t ledsBefore = this->leds;
+            this->clearOutput();
+            this->onReset();
+            this->leds = ledsBefore;
+            this->isScanning = b == 0xf6;
+            this->answer({ 0xfa });
+            break;
+        }
+        case 0xed:
+        case 0xf0:
+        case 0xf3:
+        case 0xfb:
+        case 0xfc:
+        case 0xfd:
+            this->pendingCommand = b;
+            this->answer({ 0xfa });
+            break;
+        case 0xf7:
+        case 0xf8:
+        case 0xf9:
+        case 0xfa:
+            this->answer({ 0xfa });
+            break;
+        default:
+            this->answer({ 0xfe });
+            break;
+        }
+    }
+
+    void MouseSim::onReset() {
+        this->id = 0;
+        this->sampleRate = 100;
+        this->isReporting = false;
+        this->pendingCommand = -1;
+        this->knock[0] = this->knock[1] = this->knock[2] = 0;
+    }
+
+    void MouseSim::move(int dx, int dy, uint8_t buttons, int wheel) {
+        if (!this->isReporting || !this->isPluggedIn()) {
+            return;
+        }
+        byte flags = 0x08 | (buttons & 0x07) | (dx < 0 ? 0x10 : 0) | (dy < 0 ? 0x20 : 0);
+        this->send({ flags, (byte)dx, (byte)dy });
+        if (this->id == 3) {
+            this->send((byte)wheel);
+        }
+        else if (this->id == 4) {
+            this->send((byte)((wheel & 0x0f) | ((buttons & 0x18) << 1)));
+        }
+    }
+
+    void MouseSim::onCommand(byte b) {
+        this->commandLog.push_back(b);
+
+        if (this->pendingCommand == 0xf3) {
+            // The IntelliMouse "knock" sequences switch on the wheel, then the extra buttons.
+            this->sampleRate = b;
+            this->knock[0] = this->knock[1];
+            this->knock[1] = this->knock[2];
+            this->knock[2] = b;
+            if (this->knock[0] == 200 && this->knock[1] == 100 && this->knock[2] == 80 && this->maxId >= 3) {
+                this->id = 3;
+            }
+            else if (this->knock[0] == 200 && this->knock[1] == 200 && this->knock[2] == 80 && this->maxId >= 4 && this->id == 3) {
+                this->id = 4;
+            }
+            this->pendingCommand = -1;
+            this->answer({ 0xfa });
+            return;
+        }
+        if (this->pendingCommand == 0xe8) {
+            this->pendingCommand = -1;
+            this->answer({ 0xfa });
+            return;
+        }
+
+        switch (b) {
+        case 0xff:
+            this->restart(this->timing.selfTestDuration);
+            this->answer({ 0xfa });
+            break;
+        case 0xf2:
+            this->answer({ 0xfa, this->id });
+            break;
+        case 0xf3:
+        case 0xe8:
+            this->pendingCommand = b;
+            this->answer({ 0xfa });
+            break;
+        case 0xf4:
+            this->isReporting = true;
+            this->answer({ 0xfa });
+            break;
+        case 0xf5:
+            this->clearOutput();
+            this->isReporting = false;
+            this->answer({ 0xfa });
+            break;
+        case 0xf6:
+            this->clearOutput();
+            this->sampleRate = 100;
+            this->isReporting = false;
+            this->answer({ 0xfa });
+            break;
+        case 0xe6:
+        case 0xe7:
+        case 0xea:
+        case 0xf0:
+            this->answer({ 0xfa });
+            break;
+        default:
+            this->answer({ 0xfe });
+            break;
+        }
+    }
+}
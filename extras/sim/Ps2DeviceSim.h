@@ -0,0 +1,248 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+// Simulated PS2 devices, for the tests and benchmarks.  They drive the clock and data lines of
+//  the host shim (extras/host) bit by bit, with the timing the PS2 protocol allows, so the
+//  library's interrupt handlers see exactly the edges they'd see from real hardware.
+
+#include "Arduino.h"
+#include <deque>
+#include <vector>
+
+namespace sim {
+    // A small, fast, repeatable random number generator.
+    class Random {
+        uint32_t state;
+
+    public:
+        Random(uint32_t seed = 1) : state(seed ? seed : 1) {}
+
+        uint32_t next() {
+            this->state ^= this->state << 13;
+            this->state ^= this->state >> 17;
+            this->state ^= this->state << 5;
+            return this->state;
+        }
+
+        // A number from 0 to n-1.
+        uint32_t below(uint32_t n) {
+            return n == 0 ? 0 : this->next() % n;
+        }
+
+        bool chance(double probability) {
+            return probability > 0 && (this->next() >> 8) < probability * (1 << 24);
+        }
+    };
+
+    // The ways a frame from the device can go wrong, as the probability of each per frame.
+    struct Faults {
+        double parity = 0;       // the parity bit is wrong
+        double startBit = 0;     // the start bit is 1
+        double stopBit = 0;      // the stop bit is 0
+        double droppedEdge = 0;  // one of the clock pulses doesn't reach the host
+    };
+
+    struct Timing {
+        uint16_t clockPeriod = 80;      // microseconds; 60 (16.7KHz) to 100 (10KHz)
+        uint16_t jitter = 0;            // each half period varies by up to this much either way
+        uint16_t dataDelay = 5;         // how far into the clock's high half the data changes
+        uint16_t byteGap = 50;          // the least time between frames
+        uint16_t responseDelay = 500;   // from receiving a command to starting to answer it
+        uint16_t requestToSendDelay = 40; // from the host releasing the clock to clocking its byte in
+        uint32_t selfTestDuration = 300000; // from a reset command to sending BAT
+    };
+
+    struct Statistics {
+        uint32_t framesSent = 0;
+        uint32_t framesAborted = 0;     // cut off by the host pulling the clock low
+        uint32_t faultsInjected = 0;
+        uint32_t bytesReceived = 0;     // commands and arguments from the host
+        uint32_t badFramesReceived = 0;
+        uint32_t resendRequests = 0;
+        // From the end of a frame sent with a fault to the host pulling the clock low to ask
+        //  for it again, for the faulted frames the host asked about before the next frame.
+        uint32_t resendsTimed = 0;
+        uint32_t resendDelayTotal = 0;
+        uint32_t resendDelayMax = 0;
+    };
+
+    /** \brief The wire protocol of a PS2 device; subclasses say what it answers. */
+    class Ps2Device : public host::Device {
+        enum class State { off, idle, sending, receiving };
+
+        uint8_t dataPin;
+        uint8_t clockPin;
+        State state = State::off;
+        uint8_t bitIndex = 0;
+        uint8_t phase = 0;
+        uint32_t nextTime = 0;
+        uint32_t hostReleasedClockAt = 0;
+        uint32_t earliestSend = 0;
+        uint8_t frame[11];
+        int8_t droppedBit = -1;
+        bool isFaulted = false;
+        byte sending = 0;
+        byte received = 0;
+        uint8_t receivedParity = 0;
+        bool receivedStop = false;
+        byte lastSent = 0;
+        bool isAttached = false;
+        bool isFaultedFrameUnanswered = false;
+        // Until then, the device is running its self-test and doesn't listen to the host.
+        uint32_t selfTestEndsAt = 0;
+        uint32_t faultedFrameEndedAt = 0;
+
+        std::deque<byte> output;
+        // Bytes sent after a delay (e.g. the self-test result after a reset).
+        std::vector<std::pair<uint32_t, byte>> scheduled;
+
+        void setClock(bool low);
+        void setData(bool low);
+        void startFrame(uint32_t now);
+        void stepSending(uint32_t now);
+        void stepReceiving(uint32_t now);
+        void finishReceiving(uint32_t now);
+        uint16_t halfPeriod();
+
+    protected:
+        /** \brief Called with each byte the host sends that arrived intact. */
+        virtual void onCommand(byte b) = 0;
+
+        /** \brief Called when the device starts up, to put its settings back to the defaults. */
+        virtual void onReset() {}
+
+        /** \brief Sends bytes ahead of anything already waiting to go, as answers to a command. */
+        void answer(std::initializer_list<byte> bytes);
+
+        /** \brief Sends a byte after a delay, after anything else waiting. */
+        void sendAfter(uint32_t delayMicroseconds, byte b);
+
+        /** \brief Forgets the bytes waiting to go (but not one cut off that goes before answers). */
+        void clearOutput();
+
+        /** \brief Resets the device and sends the self-test result once the test is done. */
+        void restart(uint32_t selfTestMicroseconds);
+
+        // What the device sends when it has finished its self-test.
+        std::vector<byte> selfTestResult = { 0xaa };
+
+        // Whether a byte cut off by the host sending a command is sent again before the
+        //  answer to the command, rather than after.  Devices differ.
+        bool isAbortedByteSentFirst = false;
+
+        // The byte cut off by the host, if it's waiting to go again.
+        bool isAbortedByteWaiting = false;
+
+    public:
+        Timing timing;
+        Faults faults;
+        Statistics statistics;
+        Random random;
+
+        Ps2Device(uint8_t dataPin, uint8_t clockPin, uint32_t seed = 1)
+            : dataPin(dataPin), clockPin(clockPin), random(seed)
+        {
+        }
+
+        /** \brief Attaches the device to the shim and starts it up, sending BAT after batDelay. */
+        void plugIn(uint32_t batDelayMicroseconds = 500000);
+
+        /** \brief Lets go of the lines and stops responding, forgetting anything queued. */
+        void unplug();
+
+        bool isPluggedIn() const { return this->state != State::off; }
+
+        /** \brief Queues bytes to send the host, after any already waiting. */
+        void send(std::initializer_list<byte> bytes);
+        void send(byte b);
+
+        /** \brief The number of bytes waiting to go to the host. */
+        size_t pendingCount() const { return this->output.size() + this->scheduled.size(); }
+
+        /** \brief True if nothing is waiting and no frame is in progress. */
+        bool isQuiet() const { return this->pendingCount() == 0 && this->state == State::idle; }
+
+        /** \brief True if the device is partway through sending a frame. */
+        bool isSending() const { return this->state == State::sending; }
+
+        void step(uint32_t now) override;
+    };
+
+    /** \brief A keyboard that answers the commands Keyboard sends and types what it's told to. */
+    class KeyboardSim : public Ps2Device {
+        int pendingCommand = -1;
+
+    protected:
+        void onCommand(byte b) override;
+        void onReset() override;
+
+    public:
+        // What the host has set.
+        uint8_t leds = 0;
+        uint8_t scanCodeSet = 2;
+        uint8_t typematic = 0x2b;
+        bool isScanning = true;
+        std::vector<byte> commandLog;  // every byte the host sent, in order
+        byte id[2] = { 0xab, 0x83 };
+        uint8_t idLength = 2;
+        bool isEchoSupported = true;
+
+        // What the keyboard does when told to use scan code set 3, which not all of them have:
+        //  switch to it, acknowledge the command but stay in set 2, or ask for it again.
+        enum class Set3Support { supported, ignored, refused };
+        Set3Support set3Support = Set3Support::supported;
+
+        KeyboardSim(uint8_t dataPin, uint8_t clockPin, uint32_t seed = 1)
+            : Ps2Device(dataPin, clockPin, seed)
+        {
+        }
+
+        /** \brief Queues the bytes for a key, if the keyboard is scanning. */
+        void type(std::initializer_list<byte> bytes);
+    };
+
+    /** \brief A mouse, optionally with a wheel and 5 buttons, that streams packets when told. */
+    class MouseSim : public Ps2Device {
+        int pendingCommand = -1;
+        uint8_t knock[3] = { 0, 0, 0 };
+
+    protected:
+        void onCommand(byte b) override;
+        void onReset() override;
+
+    public:
+        uint8_t maxId = 4;     // 0 for a plain mouse, 3 for a wheel, 4 for a wheel and 5 buttons
+        uint8_t id = 0;
+        uint8_t sampleRate = 100;
+        bool isReporting = false;
+        std::vector<byte> commandLog;
+
+        MouseSim(uint8_t dataPin, uint8_t clockPin, uint32_t seed = 1)
+            : Ps2Device(dataPin, clockPin, seed)
+        {
+            // Mice usually send the byte that was cut off before they answer.
+            this->isAbortedByteSentFirst = true;
+            this->selfTestResult = { 0xaa, 0x00 };
+        }
+
+        /** \brief Queues a movement packet, if reporting is on. */
+        void move(int dx, int dy, uint8_t buttons = 0, int wheel = 0);
+    };
+}
@@ -0,0 +1,272 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Runs a simulated keyboard into Keyboard through the host shim, across clock rates, clock
+//  jitter and rates of each kind of wire fault.  There are two workloads:
+//
+//   - Flat out:  the keyboard sends bytes back to back, as fast as the protocol allows, with
+//     no faults.  This gives the sustained bytes per second.
+//   - Typing:  a keystroke (1 to 3 bytes, sent back to back) every 5 to 40ms, with faults.
+//     This gives, for each kind of fault:
+//       faults:     the frames the keyboard sent with a fault injected
+//       recovered:  the share of the faulted keystrokes that arrived anyway (through a resend)
+//       lost/wrong: keystrokes that never arrived, and ones that arrived but weren't typed
+//       garbled:    how many times readScanCode returned garbled
+//       measured:   the clock period Keyboard measured, from getClockPeriodInMicroseconds
+//       resend after:  the mean and longest time from the end of a faulted frame to the
+//                   host pulling the clock low to ask for it again
+//
+//  With no arguments it runs the full matrix.  "--check" runs a smaller one, and ctest runs
+//  that.  It fails if a fault-free run loses or garbles anything, if a bad parity, start or
+//  stop bit costs a keystroke (the resend request should always get it back), or if fewer
+//  than 80% of the keystrokes with a dropped edge are recovered.  A dropped edge isn't always
+//  noticed in time to ask for the byte again:  the frame only looks abandoned once the clock
+//  has been quiet for 5 clock periods, and by then the keyboard may have finished another.
+//  It also fails if the measured clock period is more than 10% off, or if a resend request
+//  comes later than the measured period says it should:  within a clock period of the end of
+//  a frame with a bad bit, or 6 after one with a dropped edge, plus one pass of the loop.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "Ps2DeviceSim.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+    const int dataPin = 4;
+    const int clockPin = 3;
+    // How long each pass through the simulated loop() takes.
+    const uint32_t loopMicroseconds = 100;
+
+    enum class FaultKind { none, parity, startBit, stopBit, droppedEdge };
+    const char *faultNames[] = { "none", "parity", "start bit", "stop bit", "dropped edge" };
+
+    struct Result {
+        double bytesPerSecond;
+        uint32_t faults;
+        uint32_t keystrokes;
+        uint32_t lost;
+        uint32_t wrong;
+        uint32_t garbled;
+        uint32_t framesAborted;
+        uint16_t measuredClockPeriod;
+        uint32_t resendDelayMean;
+        uint32_t resendDelayMax;
+
+        double recovered() const {
+            return this->faults == 0 ? 1.0 : 1.0 - (double)(this->lost < this->faults ? this->lost : this->faults) / this->faults;
+        }
+    };
+
+    // A keystroke is a make code, or a break (f0 then the code), either of which can be
+    //  extended (with e0 in front).
+    typedef uint16_t Keystroke;
+
+    void split(const std::vector<byte> &bytes, std::vector<Keystroke> &keystrokes) {
+        Keystroke prefix = 0;
+        for (byte b : bytes) {
+            if (b == 0xe0) {
+                prefix |= 0x200;
+            }
+            else if (b == 0xf0) {
+                prefix |= 0x100;
+            }
+            else {
+                keystrokes.push_back(prefix | b);
+                prefix = 0;
+            }
+        }
+    }
+
+    // Matches what arrived against what was typed; anything that arrived without a match in
+    //  the next few typed keystrokes is wrong, and typed keystrokes skipped over are lost.
+    void compare(const std::vector<Keystroke> &typed, const std::vector<Keystroke> &arrived, Result &result) {
+        size_t t = 0;
+        result.lost = 0;
+        result.wrong = 0;
+        for (Keystroke k : arrived) {
+            size_t match = t;
+            while (match < typed.size() && match < t + 8 && typed[match] != k) {
+                ++match;
+            }
+            if (match < typed.size() && typed[match] == k) {
+                result.lost += (uint32_t)(match - t);
+                t = match + 1;
+            }
+            else {
+                ++result.wrong;
+            }
+        }
+        result.lost += (uint32_t)(typed.size() - t);
+    }
+
+    struct Setup {
+        uint16_t clockPeriod;
+        uint16_t jitter;
+        FaultKind kind;
+        double rate;
+        bool isFlatOut;
+    };
+
+    Result run(const Setup &setup, uint32_t keystrokeCount, uint32_t seed) {
+        host::reset();
+        ps2::Keyboard<dataPin, clockPin, 16> keyboard;
+        sim::KeyboardSim device(dataPin, clockPin, seed);
+        device.timing.clockPeriod = setup.clockPeriod;
+        device.timing.jitter = setup.jitter;
+
+        keyboard.begin();
+        device.plugIn(1000);
+        host::advance(5000);
+        while (keyboard.readScanCode() != ps2::KeyboardOutput::none) {
+        }
+
+        switch (setup.kind) {
+        case FaultKind::none: break;
+        case FaultKind::parity: device.faults.parity = setup.rate; break;
+        case FaultKind::startBit: device.faults.startBit = setup.rate; break;
+        case FaultKind::stopBit: device.faults.stopBit = setup.rate; break;
+        case FaultKind::droppedEdge: device.faults.droppedEdge = setup.rate; break;
+        }
+
+        std::vector<byte> typedBytes;
+        std::vector<byte> arrivedBytes;
+        Result result = {};
+        sim::Random keys(seed);
+        uint32_t start = host::now();
+        uint32_t nextKeystroke = start;
+        uint32_t keystrokesTyped = 0;
+        uint32_t lastArrival = start;
+        for (;;) {
+            // Flat out, keep a few bytes waiting in the keyboard so it sends as fast as it can.
+            while (keystrokesTyped < keystrokeCount
+                && (setup.isFlatOut ? device.pendingCount() < 4 : (int32_t)(host::now() - nextKeystroke) >= 0)) {
+                byte code = (byte)(0x15 + keys.below(0x40));
+                std::vector<byte> bytes;
+                if (keys.below(4) == 0) {
+                    bytes.push_back(0xe0);
+                }
+                if (keys.below(2) == 0) {
+                    bytes.push_back(0xf0);
+                }
+                bytes.push_back(code);
+                for (byte b : bytes) {
+                    device.send(b);
+                    typedBytes.push_back(b);
+                }
+                ++keystrokesTyped;
+                nextKeystroke = host::now() + 5000 + keys.below(35000);
+            }
+
+            for (ps2::KeyboardOutput code; (code = keyboard.readScanCode()) != ps2::KeyboardOutput::none; ) {
+                if (code == ps2::KeyboardOutput::garbled) {
+                    ++result.garbled;
+                }
+                else {
+                    arrivedBytes.push_back((byte)code);
+                    lastArrival = host::now();
+                }
+            }
+
+            if (keystrokesTyped == keystrokeCount && device.isQuiet() && host::now() - lastArrival > 50000) {
+                break;
+            }
+            host::advance(loopMicroseconds);
+        }
+
+        std::vector<Keystroke> typed;
+        std::vector<Keystroke> arrived;
+        split(typedBytes, typed);
+        split(arrivedBytes, arrived);
+        compare(typed, arrived, result);
+        result.keystrokes = (uint32_t)typed.size();
+        result.faults = device.statistics.faultsInjected;
+        result.framesAborted = device.statistics.framesAborted;
+        result.measuredClockPeriod = keyboard.getClockPeriodInMicroseconds();
+        result.resendDelayMean = device.statistics.resendsTimed == 0 ? 0 : device.statistics.resendDelayTotal / device.statistics.resendsTimed;
+        result.resendDelayMax = device.statistics.resendDelayMax;
+        result.bytesPerSecond = arrivedBytes.size() * 1e6 / (lastArrival - start);
+        return result;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool isCheck = argc > 1 && strcmp(argv[1], "--check") == 0;
+    const uint16_t clockPeriods[] = { 130, 100, 80, 70, 60 };
+    const uint16_t jitters[] = { 0, 5 };
+    const double rates[] = { 0.001, 0.01, 0.05 };
+    int failures = 0;
+
+    printf("Flat out, no faults:\n\n");
+    printf("clock     jitter  bytes/s   lost  wrong\n");
+    for (uint16_t clockPeriod : clockPeriods) {
+        for (uint16_t jitter : jitters) {
+            Setup setup = { clockPeriod, jitter, FaultKind::none, 0, true };
+            Result r = run(setup, isCheck ? 1000 : 10000, 1);
+            printf("%5.1fKHz  %4uus  %7.0f  %5u  %5u\n", 1000.0 / clockPeriod, jitter, r.bytesPerSecond, r.lost, r.wrong);
+            if (r.lost != 0 || r.wrong != 0 || r.garbled != 0) {
+                ++failures;
+            }
+        }
+    }
+
+    printf("\nTyping, with faults:\n\n");
+    printf("clock     jitter  fault          rate  faults  recovered   lost  wrong  garbled  measured  resend after\n");
+    for (uint16_t clockPeriod : clockPeriods) {
+        for (uint16_t jitter : jitters) {
+            if (isCheck && jitter == 0) {
+                continue;
+            }
+            for (int k = (int)FaultKind::none; k <= (int)FaultKind::droppedEdge; ++k) {
+                for (double rate : rates) {
+                    if (k == (int)FaultKind::none ? rate != rates[0] : isCheck && rate != 0.01) {
+                        continue;
+                    }
+                    Setup setup = { clockPeriod, jitter, (FaultKind)k, k == (int)FaultKind::none ? 0 : rate, false };
+                    Result r = run(setup, isCheck ? 1000 : 2000, 1 + k);
+                    printf("%5.1fKHz  %4uus  %-12s %5.1f%%  %6u  %8.1f%%  %5u  %5u  %7u  %6uus  %4u/%4uus\n",
+                        1000.0 / clockPeriod, jitter, faultNames[k], setup.rate * 100,
+                        r.faults, r.recovered() * 100, r.lost, r.wrong, r.garbled,
+                        r.measuredClockPeriod, r.resendDelayMean, r.resendDelayMax);
+                    if (k == (int)FaultKind::none && (r.lost != 0 || r.wrong != 0 || r.garbled != 0)) {
+                        ++failures;
+                    }
+                    else if (k != (int)FaultKind::droppedEdge && (r.lost != 0 || r.wrong != 0)) {
+                        ++failures;
+                    }
+                    else if (k == (int)FaultKind::droppedEdge && r.recovered() < 0.8) {
+                        ++failures;
+                    }
+                    else if (r.measuredClockPeriod < clockPeriod * 9 / 10 || r.measuredClockPeriod > clockPeriod * 11 / 10) {
+                        ++failures;
+                    }
+                    else if (r.resendDelayMax > (k == (int)FaultKind::droppedEdge ? 6u : 1u) * clockPeriod + loopMicroseconds) {
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    if (isCheck) {
+        printf(failures == 0 ? "passed\n" : "%d runs failed\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+}
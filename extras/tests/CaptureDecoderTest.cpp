@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Records the lines while the simulated keyboard and Keyboard talk through the host shim,
+//  including a command and a byte with bad parity, and checks that extras/tools/CaptureDecoder
+//  decodes the recording, as VCD and as sigrok CSV, into the same exchange.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "Ps2DeviceSim.h"
+#include "CaptureDecoder.h"
+#include <sstream>
+#include "Check.h"
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+// Samples both lines every microsecond, as a logic analyzer at 1MHz would.
+class Recorder : public host::Device {
+public:
+    std::string vcd;
+    std::string csv;
+    bool wasClockHigh = true;
+    bool wasDataHigh = true;
+    uint32_t nextSample = 0;
+
+    Recorder() {
+        this->vcd = "$timescale 1us $end\n$scope module ps2 $end\n"
+            "$var wire 1 ! clk $end\n$var wire 1 \" data $end\n$upscope $end\n$enddefinitions $end\n"
+            "#0\n$dumpvars\n1!\n1\"\n$end\n";
+        this->csv = "; CSV generated by the test\n; Channels (2/8): D0, D1\n; Samplerate: 1 MHz\nclock,data\n";
+    }
+
+    void step(uint32_t now) override {
+        bool isClockHigh = host::isHigh(clockPin);
+        bool isDataHigh = host::isHigh(dataPin);
+        if (isClockHigh != this->wasClockHigh || isDataHigh != this->wasDataHigh) {
+            this->vcd += "#" + std::to_string(now) + "\n";
+            if (isClockHigh != this->wasClockHigh) {
+                this->vcd += isClockHigh ? "1!\n" : "0!\n";
+            }
+            if (isDataHigh != this->wasDataHigh) {
+                this->vcd += isDataHigh ? "1\"\n" : "0\"\n";
+            }
+        }
+        // Time also passes between steps (each call to micros costs some), and the lines hold
+        //  still through it.
+        for (; this->nextSample < now; ++this->nextSample) {
+            this->csv += this->wasClockHigh ? "1," : "0,";
+            this->csv += this->wasDataHigh ? "1\n" : "0\n";
+        }
+        this->wasClockHigh = isClockHigh;
+        this->wasDataHigh = isDataHigh;
+        this->csv += isClockHigh ? "1," : "0,";
+        this->csv += isDataHigh ? "1\n" : "0\n";
+        this->nextSample = now + 1;
+    }
+};
+
+static void checkDecoded(const capture::EventLog &log, const sim::KeyboardSim &device) {
+    typedef capture::EventLog::Event Event;
+    CHECK_EQUAL(log.count(Event::receivedByte), device.statistics.framesSent - device.statistics.faultsInjected);
+    CHECK_EQUAL(log.count(Event::parityError), device.statistics.faultsInjected);
+    CHECK_EQUAL(log.count(Event::garbledByte), device.statistics.faultsInjected);
+    CHECK_EQUAL(log.count(Event::sentByte), device.statistics.bytesReceived);
+    CHECK_EQUAL(log.count(Event::sendFrameError), 0u);
+    CHECK_EQUAL(log.count(Event::lostByte), 0u);
+    CHECK(log.text.find("sent ed") != std::string::npos);
+    CHECK(log.text.find("received fa") != std::string::npos);
+    CHECK(log.text.find("sent fe") != std::string::npos);
+    CHECK(log.text.find("received 1c") != std::string::npos);
+}
+
+int main() {
+    host::reset();
+    ps2::Keyboard<dataPin, clockPin, 16> keyboard;
+    sim::KeyboardSim device(dataPin, clockPin);
+    keyboard.begin();
+    device.plugIn(1000);
+    Recorder recorder;
+    host::attach(recorder);
+
+    host::advance(5000);
+    while (keyboard.readScanCode() != ps2::KeyboardOutput::none) {
+    }
+    CHECK(keyboard.sendLedStatus(ps2::KeyboardLeds::capsLock));
+
+    device.type({ 0x1c, 0xf0, 0x1c });
+    host::advance(5000);
+    device.faults.parity = 1;
+    device.type({ 0x32 });
+    host::advance(1000);
+    device.faults.parity = 0;
+    for (int i = 0; i < 20; ++i) {
+        keyboard.readScanCode();
+        host::advance(500);
+    }
+    CHECK(device.statistics.faultsInjected >= 1);
+
+    capture::EventLog vcdLog;
+    capture::Decoder vcdDecoder(vcdLog);
+    std::istringstream vcd(recorder.vcd);
+    std::string error;
+    CHECK(capture::readVcd(vcd, vcdDecoder, nullptr, nullptr, error));
+    checkDecoded(vcdLog, device);
+
+    capture::EventLog csvLog;
+    capture::Decoder csvDecoder(csvLog);
+    std::istringstream csv(recorder.csv);
+    CHECK(capture::readSigrokCsv(csv, csvDecoder, nullptr, nullptr, 0, error));
+    checkDecoded(csvLog, device);
+    CHECK(csvLog.text == vcdLog.text);
+
+    if (check::failureCount() != 0) {
+        printf("%s", vcdLog.text.c_str());
+        printf("%s", csvLog.text.c_str());
+    }
+    return checkResult();
+}
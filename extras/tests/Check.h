@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+// Just enough of a test framework for the host tests:  CHECK and CHECK_EQUAL print what failed
+//  and where, and main returns checkResult() so that ctest sees the failure.
+
+#include <stdio.h>
+
+namespace check {
+    inline int &failureCount() {
+        static int count = 0;
+        return count;
+    }
+
+    inline bool report(bool isOk, const char *file, int line, const char *expression) {
+        if (!isOk) {
+            printf("%s(%d): check failed: %s\n", file, line, expression);
+            ++failureCount();
+        }
+        return isOk;
+    }
+
+    template<typename A, typename B>
+    bool reportEqual(const A &actual, const B &expected, const char *file, int line, const char *expression) {
+        bool isOk = actual == expected;
+        if (!isOk) {
+            printf("%s(%d): check failed: %s  (got %lld, expected %lld)\n", file, line, expression, (long long)actual, (long long)expected);
+            ++failureCount();
+        }
+        return isOk;
+    }
+}
+
+#define CHECK(expression) check::report((expression), __FILE__, __LINE__, #expression)
+#define CHECK_EQUAL(actual, expected) check::reportEqual((actual), (expected), __FILE__, __LINE__, #actual " == " #expected)
+
+inline int checkResult() {
+    if (check::failureCount() == 0) {
+        printf("passed\n");
+    }
+    return check::failureCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,556 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Checks the diagnostics classes:  what SimpleDiagnostics records under each RecordedEvents
+//  mask, and the classes that do more than record events, which count, time, persist or
+//  stream what they see.  The EEPROM in the host shim is 1KB, wears the way the
+//  AVR's does (each cell counts its writes), and is busy for 3.4ms after each one.
+
+#include "Arduino.h"
+#include "ps2_SimpleDiagnostics.h"
+#include "ps2_PerfDiagnostics.h"
+#include "ps2_LatencyDiagnostics.h"
+#include "ps2_EepromDiagnostics.h"
+#include "ps2_CaptureDiagnostics.h"
+#include "ps2_CaptureReplay.h"
+#include "ps2_StreamingDiagnostics.h"
+#include <util/crc16.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "Check.h"
+
+// Like the Ps2ToUsbKeyboardAdapter's, which adds events of its own.
+template <uint64_t RecordedEvents, uint16_t Size = 64>
+class AdapterDiagnostics : public ps2::SimpleDiagnostics<Size, 30, RecordedEvents> {
+    typedef ps2::SimpleDiagnostics<Size, 30, RecordedEvents> base;
+
+public:
+    static const uint8_t sentUsbKeyDownCode = base::firstUnusedInfoCode;
+    static const uint8_t sentUsbKeyUpCode = base::firstUnusedInfoCode + 1;
+    void sentUsbKeyDown(byte b) { this->push(sentUsbKeyDownCode, b); }
+    void sentUsbKeyUp(byte b) { this->push(sentUsbKeyUpCode, b); }
+};
+
+// The identifiers of the events in the report, newest first.
+template <typename Diagnostics>
+static std::vector<uint8_t> recordedEvents(Diagnostics &diagnostics) {
+    host::serialOutput().clear();
+    diagnostics.sendReport(Serial);
+    const std::string &report = host::serialOutput();
+    size_t start = report.find('|') + 1;
+    std::vector<uint8_t> bytes;
+    for (size_t i = start; i + 1 < report.size() && report[i] != '}'; i += 2) {
+        bytes.push_back((uint8_t)std::stoi(report.substr(i, 2), nullptr, 16));
+    }
+    // The last byte of each event has its identifier and the number of bytes before it.
+    std::vector<uint8_t> events;
+    for (int i = (int)bytes.size() - 1; i >= 0; i -= 1 + (bytes[i] & 3)) {
+        events.push_back(bytes[i] >> 2);
+    }
+    return events;
+}
+
+// Records a received byte, one of the application's events and an error, and returns what
+//  made it into the report.  receivedByte is called from the read interrupt handler, so
+//  microsecondsToReceive (the time it took, where each call to millis or micros costs one)
+//  is the cost it adds to that.
+template <uint64_t RecordedEvents>
+static std::vector<uint8_t> recordTraffic(uint32_t &microsecondsToReceive) {
+    host::reset();
+    AdapterDiagnostics<RecordedEvents> diagnostics{};
+    host::advance(100);
+    uint32_t start = host::now();
+    diagnostics.receivedByte(0x1c);
+    microsecondsToReceive = host::now() - start;
+    diagnostics.sentUsbKeyDown(0x04);
+    diagnostics.parityError();
+    return recordedEvents(diagnostics);
+}
+
+static void testEventMasks() {
+    const uint8_t received = (uint8_t)ps2::DiagnosticsCode::receivedByte;
+    const uint8_t keyDown = AdapterDiagnostics<0>::sentUsbKeyDownCode;
+    const uint8_t parity = (uint8_t)ps2::DiagnosticsCode::parityError;
+    uint32_t microsecondsToReceive;
+
+    // The three configurations in the SimpleDiagnostics documentation.  A masked-out
+    //  receivedByte doesn't even look at the clock.
+    std::vector<uint8_t> events = recordTraffic<ps2::DiagnosticsEvents::errors>(microsecondsToReceive);
+    CHECK(events == std::vector<uint8_t>({ parity }));
+    CHECK_EQUAL(microsecondsToReceive, 0u);
+
+    events = recordTraffic<ps2::DiagnosticsEvents::errors | ps2::DiagnosticsEvents::applicationEvents>(microsecondsToReceive);
+    CHECK(events == std::vector<uint8_t>({ parity, keyDown }));
+    CHECK_EQUAL(microsecondsToReceive, 0u);
+
+    events = recordTraffic<ps2::DiagnosticsEvents::all>(microsecondsToReceive);
+    CHECK(events == std::vector<uint8_t>({ parity, keyDown, received }));
+    CHECK(microsecondsToReceive > 0);
+
+    // Just the one application event, by name.
+    events = recordTraffic<ps2::DiagnosticsEvents::event(keyDown)>(microsecondsToReceive);
+    CHECK(events == std::vector<uint8_t>({ keyDown }));
+}
+
+// The read-min,mean,max section of PerfDiagnostics' report.
+static std::string readTimings(ps2::PerfDiagnostics &diagnostics) {
+    host::serialOutput().clear();
+    diagnostics.sendReport(Serial);
+    const std::string &report = host::serialOutput();
+    size_t end = report.rfind('|');
+    size_t start = report.rfind('|', end - 1) + 1;
+    return report.substr(start, end - start);
+}
+
+static void timeReadInterrupt(ps2::PerfDiagnostics &diagnostics, uint32_t microseconds) {
+    diagnostics.readInterruptStarted();
+    host::advance(microseconds);
+    diagnostics.readInterruptCompleted();
+}
+
+struct RingUse {
+    double bytesPerKeystroke;
+    double clockReadsPerReceivedByte;
+};
+
+// Types keystrokes as the adapter sees them - a make, a USB key down, then a break (two bytes)
+//  and a USB key up - with pauses between, and measures how fast they fill the ring and what
+//  receivedByte costs in the read interrupt handler, in calls to millis and micros.
+template <uint64_t RecordedEvents>
+static RingUse measureRingUse() {
+    host::reset();
+    AdapterDiagnostics<RecordedEvents, 1024> diagnostics{};
+    const uint32_t keystrokes = 50;
+    uint32_t receiveTime = 0;
+    auto receive = [&](byte b) {
+        uint32_t start = host::now();
+        diagnostics.receivedByte(b);
+        receiveTime += host::now() - start;
+    };
+    for (uint32_t i = 0; i < keystrokes; ++i) {
+        host::advance(100000);
+        receive(0x1c);
+        diagnostics.sentUsbKeyDown(0x04);
+        host::advance(80000);
+        receive(0xf0);
+        receive(0x1c);
+        diagnostics.sentUsbKeyUp(0x04);
+    }
+    host::serialOutput().clear();
+    diagnostics.sendReport(Serial);
+    const std::string &report = host::serialOutput();
+    size_t start = report.find('|') + 1;
+    size_t end = report.find('}', start);
+    RingUse use = { (end - start) / 2.0 / keystrokes, (double)receiveTime / (3 * keystrokes) };
+    return use;
+}
+
+static void testRingUse() {
+    RingUse errors = measureRingUse<ps2::DiagnosticsEvents::errors>();
+    RingUse errorsAndKeys = measureRingUse<ps2::DiagnosticsEvents::errors | ps2::DiagnosticsEvents::applicationEvents>();
+    RingUse all = measureRingUse<ps2::DiagnosticsEvents::all>();
+    printf("ring bytes per keystroke:  errors %.1f, errors and keys %.1f, everything %.1f\n",
+        errors.bytesPerKeystroke, errorsAndKeys.bytesPerKeystroke, all.bytesPerKeystroke);
+    printf("clock reads per received byte:  errors %.1f, errors and keys %.1f, everything %.1f\n",
+        errors.clockReadsPerReceivedByte, errorsAndKeys.clockReadsPerReceivedByte, all.clockReadsPerReceivedByte);
+
+    CHECK(errors.bytesPerKeystroke == 0);
+    CHECK(errorsAndKeys.bytesPerKeystroke == 4);
+    CHECK(all.bytesPerKeystroke == 14);
+    CHECK(errors.clockReadsPerReceivedByte == 0);
+    CHECK(errorsAndKeys.clockReadsPerReceivedByte == 0);
+    CHECK(all.clockReadsPerReceivedByte == 1);
+}
+
+static void testPerfTimings() {
+    host::reset();
+    ps2::PerfDiagnostics diagnostics;
+    diagnostics.begin();
+
+    // Timings are in cycles; on the host, a microsecond is 16 of them.
+    timeReadInterrupt(diagnostics, 2);
+    timeReadInterrupt(diagnostics, 4);
+    CHECK(readTimings(diagnostics) == "20,30,40");
+
+    // The mean keeps moving long after the count would have saturated:  70,000 samples of
+    //  2us, then 70,000 of 4us, and the mean ends up well over halfway to 4us, since the
+    //  older samples count for less.
+    diagnostics.reset();
+    for (uint32_t i = 0; i < 70000; ++i) {
+        timeReadInterrupt(diagnostics, 2);
+    }
+    CHECK(readTimings(diagnostics) == "20,20,20");
+    for (uint32_t i = 0; i < 70000; ++i) {
+        timeReadInterrupt(diagnostics, 4);
+    }
+    std::string timings = readTimings(diagnostics);
+    unsigned minCycles, meanCycles, maxCycles;
+    CHECK(sscanf(timings.c_str(), "%x,%x,%x", &minCycles, &meanCycles, &maxCycles) == 3);
+    CHECK_EQUAL(minCycles, 0x20u);
+    CHECK(meanCycles > 0x30 && meanCycles < 0x40);
+    CHECK_EQUAL(maxCycles, 0x40u);
+}
+
+static void testLatencyMatching() {
+    host::reset();
+    typedef ps2::LatencyDiagnostics<4> Latency;
+    Latency latency;
+
+    // An ack that readScanCode never returns is skipped to get to the byte after it.
+    latency.receivedByte(0xfa);
+    latency.receivedByte(0x1c);
+    host::advance(1000);
+    latency.dequeuedByte(0x1c);
+    CHECK(latency.getMaxMicros(Latency::Stage::receiveToDequeue) >= 1000);
+    CHECK(latency.getMaxMicros(Latency::Stage::receiveToDequeue) < 1100);
+
+    // A byte with no stamp doesn't throw away the stamps of the bytes behind it.
+    latency.reset();
+    latency.receivedByte(0x1c);
+    host::advance(2000);
+    latency.dequeuedByte(0x32);
+    latency.dequeuedByte(0x1c);
+    CHECK(latency.getMaxMicros(Latency::Stage::receiveToDequeue) >= 2000);
+}
+
+typedef ps2::EepromDiagnostics<60, 30, 0, 8> Eeprom;
+
+// Flushes until the record is written, returning the longest any one call took.
+static uint32_t flushAll(Eeprom &diagnostics) {
+    uint32_t longestCall = 0;
+    for (;;) {
+        uint32_t start = host::now();
+        bool isDone = diagnostics.flush();
+        if (host::now() - start > longestCall) {
+            longestCall = host::now() - start;
+        }
+        if (isDone) {
+            return longestCall;
+        }
+        host::advance(100);
+    }
+}
+
+static int storedRecordCount(Eeprom &diagnostics) {
+    host::serialOutput().clear();
+    diagnostics.sendReport(Serial);
+    int count = 0;
+    for (char c : host::serialOutput()) {
+        count += c == '[';
+    }
+    return count;
+}
+
+static void testEepromBlankSlots() {
+    // Neither erased slots nor zeroed ones look like records.
+    host::reset();
+    host::eraseEeprom();
+    Eeprom erased;
+    erased.begin();
+    CHECK_EQUAL(storedRecordCount(erased), 0);
+
+    for (int i = 0; i < 8 * 38; ++i) {
+        eeprom_write_byte((uint8_t *)(uintptr_t)i, 0);
+    }
+    Eeprom zeroed;
+    zeroed.begin();
+    CHECK_EQUAL(storedRecordCount(zeroed), 0);
+}
+
+static void testEepromRecords() {
+    host::reset();
+    host::eraseEeprom();
+    {
+        Eeprom diagnostics;
+        diagnostics.begin();
+        for (int i = 0; i < 3; ++i) {
+            diagnostics.parityError();
+            // Each call writes at most the bytes the EEPROM is ready for, so it never waits.
+            CHECK_EQUAL(flushAll(diagnostics), 0u);
+        }
+    }
+
+    // They survive a restart, and the next one goes after them.
+    Eeprom diagnostics;
+    diagnostics.begin();
+    CHECK_EQUAL(storedRecordCount(diagnostics), 3);
+    CHECK(host::serialOutput().find("[0]{") == 0);
+    diagnostics.parityError();
+    flushAll(diagnostics);
+    CHECK_EQUAL(storedRecordCount(diagnostics), 4);
+    CHECK(host::serialOutput().find("[3]{") != std::string::npos);
+
+    diagnostics.clearStoredReports();
+    flushAll(diagnostics);
+    CHECK_EQUAL(storedRecordCount(diagnostics), 0);
+}
+
+static void testEepromWear() {
+    // The slots take turns, so no cell is written more than once per NumSlots errors.
+    host::reset();
+    host::eraseEeprom();
+    Eeprom diagnostics;
+    diagnostics.begin();
+    const uint32_t errorCount = 2000;
+    for (uint32_t i = 0; i < errorCount; ++i) {
+        diagnostics.parityError();
+        flushAll(diagnostics);
+    }
+    uint32_t mostWrites = 0;
+    for (uint16_t address = 0; address <= E2END; ++address) {
+        if (host::eepromWriteCount(address) > mostWrites) {
+            mostWrites = host::eepromWriteCount(address);
+        }
+    }
+    CHECK(mostWrites <= errorCount / 8);
+    CHECK(mostWrites >= errorCount / 8 / 2);
+}
+
+// Somewhere to capture to and replay from, with the parts of the Print and Stream interfaces
+//  that CaptureDiagnostics and CaptureReplay use.
+class MemoryStream {
+    std::vector<byte> bytes;
+    size_t readIndex = 0;
+
+public:
+    int availableForWrite() { return 16; }
+    size_t write(byte b) { this->bytes.push_back(b); return 1; }
+    int available() { return (int)(this->bytes.size() - this->readIndex); }
+    int read() { return this->readIndex < this->bytes.size() ? this->bytes[this->readIndex++] : -1; }
+
+    const std::vector<byte> &contents() const { return this->bytes; }
+};
+
+static void testCaptureReplay() {
+    host::reset();
+    ps2::CaptureDiagnostics<> capture;
+    MemoryStream stream;
+    capture.begin();
+
+    capture.receivedByte(0x1c);
+    capture.parityError();
+    capture.clockLineGlitch(2);
+    capture.sendFrameError();
+    capture.sentByte(0xfe);
+    capture.receivedByte(0xfa);
+    capture.receivedByte(0x32);
+    capture.drain(stream);
+    capture.drain(stream);
+    capture.drain(stream);
+
+    // The glitch and the send error don't come back as errors of their own, and the ack is
+    //  left out, as Keyboard would.
+    ps2::CaptureReplay<MemoryStream> replay(stream, ps2::ReplaySpeed::maximum);
+    CHECK(replay.begin());
+    CHECK(replay.readScanCode() == ps2::KeyboardOutput::sc2_a);
+    CHECK(replay.readScanCode() == ps2::KeyboardOutput::garbled);
+    CHECK(replay.readScanCode() == ps2::KeyboardOutput::sc2_b);
+    CHECK(replay.readScanCode() == ps2::KeyboardOutput::none);
+}
+
+// A long typing session, with a framing error every thousand keystrokes, has to come back
+//  whole.  With a file name, the capture is saved there for ReplayCapture's test.
+static void testLongCaptureReplay(const char *savePath) {
+    host::reset();
+    ps2::CaptureDiagnostics<> capture;
+    MemoryStream stream;
+    capture.begin();
+
+    static const byte keys[] = { 0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33 };
+    const uint32_t keystrokes = 20000;
+    for (uint32_t i = 0; i < keystrokes; ++i) {
+        byte key = keys[i % sizeof(keys)];
+        capture.receivedByte(key);
+        host::advance(60000 + (i % 7) * 10000);
+        capture.receivedByte(0xf0);
+        host::advance(1100);
+        capture.receivedByte(key);
+        host::advance(20000);
+        if (i % 1000 == 999) {
+            capture.parityError();
+            capture.clockLineGlitch(3);
+        }
+        for (int j = 0; j < 4; ++j) {
+            capture.drain(stream);
+        }
+    }
+
+    ps2::CaptureReplay<MemoryStream> replay(stream, ps2::ReplaySpeed::maximum);
+    CHECK(replay.begin());
+    uint32_t scanCodes = 0;
+    uint32_t garbled = 0;
+    for (ps2::KeyboardOutput code = replay.readScanCode(); code != ps2::KeyboardOutput::none; code = replay.readScanCode()) {
+        if (code == ps2::KeyboardOutput::garbled) {
+            ++garbled;
+        }
+        else {
+            ++scanCodes;
+        }
+    }
+    CHECK_EQUAL(scanCodes, 3 * keystrokes);
+    CHECK_EQUAL(garbled, keystrokes / 1000);
+
+    if (savePath != nullptr) {
+        FILE *file = fopen(savePath, "wb");
+        CHECK(file != nullptr);
+        if (file != nullptr) {
+            fwrite(stream.contents().data(), 1, stream.contents().size(), file);
+            fclose(file);
+        }
+    }
+}
+
+// What StreamingDiagnosticsReceiver.py would make of a stream.
+struct StreamSummary {
+    uint32_t events = 0; // Not counting eventsLost markers
+    uint32_t eventsLost = 0; // The total of the eventsLost markers
+    uint32_t badFrames = 0;
+};
+
+static StreamSummary decodeStream(const std::string &stream) {
+    StreamSummary summary;
+    std::vector<byte> frame;
+    bool isInFrame = false;
+    bool isEscaped = false;
+    for (char c : stream) {
+        byte b = (byte)c;
+        if (b == 0xc0) {
+            if (isInFrame && !frame.empty()) {
+                uint8_t crc = 0;
+                for (size_t i = 0; i + 1 < frame.size(); ++i) {
+                    crc = _crc_ibutton_update(crc, frame[i]);
+                }
+                if (frame.size() != (size_t)(frame[0] & 3) + 2 || crc != frame.back()) {
+                    ++summary.badFrames;
+                }
+                else if (frame[0] >> 2 == (uint8_t)ps2::DiagnosticsCode::eventsLost) {
+                    summary.eventsLost += (frame[1] << 8) | frame[2];
+                }
+                else {
+                    ++summary.events;
+                }
+            }
+            frame.clear();
+            isInFrame = true;
+            isEscaped = false;
+        }
+        else if (!isInFrame) {
+            continue;
+        }
+        else if (isEscaped) {
+            isEscaped = false;
+            frame.push_back(b == 0xdc ? 0xc0 : 0xdb);
+        }
+        else if (b == 0xdb) {
+            isEscaped = true;
+        }
+        else {
+            frame.push_back(b);
+        }
+    }
+    return summary;
+}
+
+// Streams receivedByte events at the given rate for a second, with a loop that drains every
+//  10us, and then lets the queue empty.  Returns the number of events offered.
+static uint32_t stream(unsigned long baud, uint32_t eventsPerSecond) {
+    host::reset();
+    Serial.begin(baud);
+    ps2::StreamingDiagnostics<64> diagnostics;
+    uint32_t start = host::now();
+    uint32_t offered = 0;
+    while (host::now() - start < 1000000) {
+        while ((uint64_t)offered * 1000000 < (uint64_t)(host::now() - start) * eventsPerSecond) {
+            // Every byte value, so the escapes get sent too.
+            diagnostics.receivedByte((byte)offered);
+            ++offered;
+        }
+        diagnostics.drain(Serial);
+        host::advance(10);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        diagnostics.drain(Serial);
+        host::advance(10);
+    }
+    return offered;
+}
+
+// Checks the rates quoted in the StreamingDiagnostics documentation.  (A full trace of a
+//  keyboard sending flat out at 16.7KHz is about 1,500 receivedByte events a second.)
+static void testStreamingThroughput(const char *savePath) {
+    // Up to what the link can carry, nothing is lost.
+    uint32_t offered = stream(1000000, 19500);
+    StreamSummary summary = decodeStream(host::serialOutput());
+    CHECK_EQUAL(summary.events, offered);
+    CHECK_EQUAL(summary.eventsLost, 0u);
+    CHECK_EQUAL(summary.badFrames, 0u);
+
+    offered = stream(115200, 2200);
+    summary = decodeStream(host::serialOutput());
+    CHECK_EQUAL(summary.events, offered);
+    CHECK_EQUAL(summary.eventsLost, 0u);
+
+    // Far more than the link can carry:  it runs flat out, and every event is either sent or
+    //  counted as lost.
+    offered = stream(1000000, 50000);
+    summary = decodeStream(host::serialOutput());
+    printf("1Mbaud, overloaded: %u events/s sent, %u of %u lost\n", summary.events, summary.eventsLost, offered);
+    CHECK(summary.events >= 16000);
+    CHECK_EQUAL(summary.events + summary.eventsLost, offered);
+    CHECK_EQUAL(summary.badFrames, 0u);
+
+    if (savePath != nullptr) {
+        FILE *file = fopen(savePath, "wb");
+        CHECK(file != nullptr);
+        if (file != nullptr) {
+            fwrite(host::serialOutput().data(), 1, host::serialOutput().size(), file);
+            fclose(file);
+        }
+    }
+}
+
+//      DiagnosticsTest [--streaming PATH] [--capture PATH]
+//
+//  --streaming saves the overloaded 1Mbaud stream, for the receiver's test, and --capture
+//  saves the long capture, for ReplayCapture's.
+int main(int argc, char **argv) {
+    const char *streamingPath = nullptr;
+    const char *capturePath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--streaming") == 0) {
+            streamingPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--capture") == 0) {
+            capturePath = argv[i + 1];
+        }
+    }
+
+    testEventMasks();
+    testRingUse();
+    testPerfTimings();
+    testLatencyMatching();
+    testEepromBlankSlots();
+    testEepromRecords();
+    testEepromWear();
+    testCaptureReplay();
+    testLongCaptureReplay(capturePath);
+    testStreamingThroughput(streamingPath);
+    return checkResult();
+}
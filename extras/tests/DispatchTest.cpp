@@ -0,0 +1,164 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Checks Keyboard::dispatch against readScanCode polling on the simulated keyboard in
+//  extras/sim, and counts what a loop() that sleeps whenever isIdle says so wakes up for, idle
+//  and while typing.  The counts, times the cycles the avr-bench target reports for
+//  readInterruptHandler, readScanCode and "dispatch, nothing waiting", give the time a board
+//  spends awake; a loop() that polls is awake all the time.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "ps2_NullDiagnostics.h"
+#include "Ps2DeviceSim.h"
+#include <stdio.h>
+#include <vector>
+#include "Check.h"
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+// Counts the read interrupts, each of which wakes a sleeping processor.
+class InterruptCounter : public ps2::NullDiagnostics {
+public:
+    uint32_t readInterrupts = 0;
+    void readInterruptStarted() { ++this->readInterrupts; }
+};
+
+typedef ps2::Keyboard<dataPin, clockPin, 16, InterruptCounter> TestKeyboard;
+
+struct LoopResult {
+    std::vector<uint8_t> typed;
+    std::vector<uint8_t> received;
+    uint32_t passes;          // times through loop()
+    uint32_t wakes;           // times the processor woke from sleep
+    uint32_t workingPasses;   // passes where dispatch had scan codes to hand over
+    uint32_t readInterrupts;
+    uint32_t garbled;         // bad frames readScanCode reported before asking for them again
+};
+
+// Runs loop() for the given time, typing a keystroke (make, break) every 50 to 300ms if
+//  isTyping, with some of the frames having bad parity.  Polling, each pass calls readScanCode
+//  and takes 20us; otherwise each calls dispatch and sleeps if the keyboard is idle, until
+//  the next read interrupt or the next tick of the Arduino core's millisecond timer.
+static LoopResult runLoop(bool isDispatching, bool isTyping, uint32_t seconds) {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    InterruptCounter counter;
+    TestKeyboard keyboard(counter);
+    keyboard.begin();
+    host::advance(1000);
+    device.faults.parity = 0.01;
+
+    static const uint8_t keys[] = { 0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33, 0x43, 0x3b, 0x42, 0x4b };
+    sim::Random typing(3);
+    LoopResult result = {};
+    uint32_t start = host::now();
+    uint32_t end = start + seconds * 1000000;
+    uint32_t nextKeystroke = start + 50000;
+    counter.readInterrupts = 0;
+    while (host::now() < end) {
+        if (isTyping && (int32_t)(host::now() - nextKeystroke) >= 0 && nextKeystroke < end - 100000) {
+            uint8_t key = keys[result.typed.size() % sizeof(keys)];
+            device.type({ key, 0xf0, key });
+            result.typed.insert(result.typed.end(), { key, 0xf0, key });
+            nextKeystroke += 50000 + typing.below(250000);
+        }
+
+        ++result.passes;
+        if (!isDispatching) {
+            for (ps2::KeyboardOutput code = keyboard.readScanCode(); code != ps2::KeyboardOutput::none; code = keyboard.readScanCode()) {
+                if (code != ps2::KeyboardOutput::garbled) {
+                    result.received.push_back((uint8_t)code);
+                }
+                else {
+                    ++result.garbled;
+                }
+            }
+            host::advance(20);
+            continue;
+        }
+
+        uint8_t count = keyboard.dispatch([&result](ps2::KeyboardOutput code) {
+            if (code != ps2::KeyboardOutput::garbled) {
+                result.received.push_back((uint8_t)code);
+            }
+            else {
+                ++result.garbled;
+            }
+        });
+        result.workingPasses += count != 0;
+        if (keyboard.isIdle()) {
+            uint32_t interrupts = counter.readInterrupts;
+            uint32_t millisecond = host::now() / 1000;
+            while (counter.readInterrupts == interrupts && host::now() / 1000 == millisecond) {
+                host::advance(1);
+            }
+            ++result.wakes;
+        }
+        else {
+            host::advance(20);
+        }
+    }
+    result.readInterrupts = counter.readInterrupts;
+    return result;
+}
+
+static void print(const char *name, const LoopResult &r, uint32_t seconds) {
+    printf("%-20s %6u bytes  %3u garbled  %8u passes/s  %6u wakes/s  %4u working passes/s  %5u read interrupts/s\n",
+        name, (unsigned)r.received.size(), r.garbled, r.passes / seconds, r.wakes / seconds, r.workingPasses / seconds, r.readInterrupts / seconds);
+}
+
+static void testDispatchMatchesPolling() {
+    const uint32_t seconds = 20;
+    LoopResult polling = runLoop(false, true, seconds);
+    LoopResult dispatching = runLoop(true, true, seconds);
+    LoopResult idlePolling = runLoop(false, false, 5);
+    LoopResult idleDispatching = runLoop(true, false, 5);
+    print("polling, idle", idlePolling, 5);
+    print("dispatching, idle", idleDispatching, 5);
+    print("polling, typing", polling, seconds);
+    print("dispatching, typing", dispatching, seconds);
+
+    // The same bytes come through either way, including the ones that had to be asked for
+    //  again.
+    CHECK(!polling.typed.empty());
+    CHECK(polling.received == polling.typed);
+    CHECK(dispatching.received == dispatching.typed);
+    CHECK(dispatching.typed == polling.typed);
+
+    // Idle, the only thing that wakes the processor is the timer.
+    CHECK_EQUAL(idleDispatching.readInterrupts, 0u);
+    CHECK_EQUAL(idleDispatching.workingPasses, 0u);
+    CHECK(idleDispatching.wakes <= 5 * 1000 + 1);
+
+    // Typing, it wakes for each clock edge too, but only does any work once per byte (or bad
+    //  frame).
+    CHECK(dispatching.garbled != 0);
+    CHECK_EQUAL(dispatching.garbled, polling.garbled);
+    CHECK(dispatching.wakes <= seconds * 1000 + dispatching.readInterrupts + 1);
+    CHECK(dispatching.workingPasses <= dispatching.received.size() + dispatching.garbled);
+    CHECK(dispatching.passes < polling.passes / 20);
+}
+
+int main() {
+    testDispatchMatchesPolling();
+    return checkResult();
+}
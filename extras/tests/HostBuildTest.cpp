@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Builds the library's core headers, unmodified, against the stand-in for the Arduino core in
+//  extras/host, and checks that the stand-in behaves enough like the board for them to work:
+//  a frame clocked in on the pins arrives through the interrupt handler, edges that come in
+//  while interrupts are off wait for them to come back on, and the translators and
+//  SimpleDiagnostics run as they would on the board.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "ps2_KeyboardOutputBuffer.h"
+#include "ps2_UsbTranslator.h"
+#include "ps2_AnsiTranslator.h"
+#include "ps2_NeutralTranslator.h"
+#include "ps2_SimpleDiagnostics.h"
+#include "Check.h"
+
+// SimpleDiagnostics, with the error count the tests want to look at made public.
+class TestDiagnostics : public ps2::SimpleDiagnostics<32> {
+public:
+    using ps2::SimpleDiagnostics<32>::getErrorSerialNumber;
+};
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+// Clocks one byte in from the keyboard's side, at about 12.5kHz.
+static void clockInByte(byte b, bool goodParity = true) {
+    uint8_t bits[11];
+    uint8_t parity = 1;
+    bits[0] = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits[1 + i] = (b >> i) & 1;
+        parity ^= bits[1 + i];
+    }
+    bits[9] = goodParity ? parity : !parity;
+    bits[10] = 1;
+
+    for (int i = 0; i < 11; ++i) {
+        host::pullLow(dataPin, bits[i] == 0);
+        host::advance(20);
+        host::pullLow(clockPin, true);
+        host::advance(40);
+        host::pullLow(clockPin, false);
+        host::advance(20);
+    }
+    host::pullLow(dataPin, false);
+    host::advance(100);
+}
+
+static void testReceive() {
+    host::reset();
+    TestDiagnostics diagnostics;
+    ps2::Keyboard<dataPin, clockPin, 8, TestDiagnostics> keyboard(diagnostics);
+    keyboard.begin();
+
+    clockInByte(0x1c);
+    clockInByte(0xf0);
+    clockInByte(0x1c);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::sc2_a);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::unmake);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::sc2_a);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::none);
+    CHECK_EQUAL(diagnostics.getErrorSerialNumber(), 0);
+
+    // A frame with bad parity is reported, and the keyboard is asked to send it again.
+    clockInByte(0x1c, false);
+    host::advance(1000);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::garbled);
+    CHECK_EQUAL(diagnostics.getErrorSerialNumber(), 1);
+    CHECK(!host::isHigh(dataPin)); // the resend request's start bit
+}
+
+static void testMissedEdge() {
+    host::reset();
+    TestDiagnostics diagnostics;
+    ps2::Keyboard<dataPin, clockPin, 8, TestDiagnostics> keyboard(diagnostics);
+    keyboard.begin();
+
+    // The first few bits of a frame, then nothing, as if the rest of its edges were missed.
+    for (int i = 0; i < 5; ++i) {
+        host::pullLow(dataPin, i == 0);
+        host::advance(20);
+        host::pullLow(clockPin, true);
+        host::advance(40);
+        host::pullLow(clockPin, false);
+        host::advance(20);
+    }
+    host::pullLow(dataPin, false);
+    host::advance(1000);
+
+    // The next frame is read correctly, and the lost one is reported after it without asking
+    //  for it again, since the keyboard has moved on.
+    clockInByte(0x1c);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::sc2_a);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::garbled);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::none);
+    CHECK(host::isHigh(dataPin));
+}
+
+// A diagnostics class written against the original set of hooks, before the optional ones in
+//  NullDiagnostics were added, plus one of the optional ones to check that it still gets called.
+class LegacyDiagnostics {
+public:
+    int bytesReceived = 0;
+    int bytesDequeued = 0;
+
+    void packetDidNotStartWithZero() {}
+    void parityError() {}
+    void packetDidNotEndWithOne() {}
+    void packetIncomplete() {}
+    void sendFrameError() {}
+    void startupFailure() {}
+    void bufferOverflow() {}
+    void incorrectResponse(ps2::KeyboardOutput, ps2::KeyboardOutput) {}
+    void noResponse(ps2::KeyboardOutput) {}
+    void noTranslationForKey(bool, ps2::KeyboardOutput) {}
+    void sentByte(byte) {}
+    void receivedByte(byte) { ++this->bytesReceived; }
+    void clockLineGlitch(uint8_t) {}
+
+    void dequeuedByte(byte) { ++this->bytesDequeued; }
+};
+
+static void testLegacyDiagnostics() {
+    host::reset();
+    LegacyDiagnostics diagnostics;
+    ps2::Keyboard<dataPin, clockPin, 8, LegacyDiagnostics> keyboard(diagnostics);
+    keyboard.begin();
+
+    clockInByte(0x1c);
+    CHECK(keyboard.readScanCode() == ps2::KeyboardOutput::sc2_a);
+    CHECK_EQUAL(diagnostics.bytesReceived, 1);
+    CHECK_EQUAL(diagnostics.bytesDequeued, 1);
+
+    // Nothing answers, but this brings in the sending side's hooks.
+    CHECK(!keyboard.echo());
+
+    ps2::UsbTranslator<LegacyDiagnostics> translator(diagnostics);
+    translator.translatePs2Keycode(ps2::KeyboardOutput::sc2_a);
+}
+
+static void testInterruptsWait() {
+    host::reset();
+    ps2::Keyboard<dataPin, clockPin, 8> keyboard;
+    keyboard.begin();
+
+    // A whole frame while interrupts are off only gets one edge through, as on the board.
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        clockInByte(0x1c);
+        CHECK(!host::areInterruptsEnabled());
+    }
+    CHECK(host::areInterruptsEnabled());
+    host::advance(10000);
+    CHECK(keyboard.readScanCode() != ps2::KeyboardOutput::sc2_a);
+}
+
+static void testTranslators() {
+    TestDiagnostics diagnostics;
+    ps2::UsbTranslator<TestDiagnostics> usb(diagnostics);
+    CHECK_EQUAL(usb.translatePs2Keycode(ps2::KeyboardOutput::sc2_a).hidCode, 4);
+
+    ps2::AnsiTranslator<TestDiagnostics> ansi(diagnostics);
+    CHECK_EQUAL(ansi.translatePs2Keycode(ps2::KeyboardOutput::sc2_a), 'a');
+
+    ps2::NeutralTranslator neutral;
+    CHECK(neutral.translatePs2Keycode(ps2::KeyboardOutput::sc2_a) == ps2::KeyCode::PS2_KEY_A);
+
+    ps2::KeyboardOutputBuffer<1, TestDiagnostics> oneByte(diagnostics);
+    oneByte.push(ps2::KeyboardOutput::sc2_a);
+    CHECK(oneByte.pop() == ps2::KeyboardOutput::sc2_a);
+    CHECK(oneByte.pop() == ps2::KeyboardOutput::none);
+}
+
+static void testSerial() {
+    host::reset();
+    Serial.print("x=");
+    Serial.println(0x2a, HEX);
+    CHECK(host::serialOutput() == "x=2A\r\n");
+
+    // At 9600 baud a byte takes about a millisecond to go, and writes wait for room.
+    Serial.begin(9600);
+    uint32_t start = host::now();
+    for (int i = 0; i < 100; ++i) {
+        Serial.write('.');
+    }
+    CHECK(host::now() - start > 30000);
+    CHECK(Serial.availableForWrite() == 0);
+    Serial.flush();
+    CHECK(Serial.availableForWrite() == 63);
+}
+
+int main() {
+    testReceive();
+    testMissedEdge();
+    testLegacyDiagnostics();
+    testInterruptsWait();
+    testTranslators();
+    testSerial();
+    return checkResult();
+}
@@ -0,0 +1,270 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Runs Keyboard against the simulated keyboard in extras/sim, to check how it behaves on the
+//  wire: what it sends, when, and what it makes of what comes back.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "ps2_SimpleDiagnostics.h"
+#include "Ps2DeviceSim.h"
+#include "Check.h"
+#include <stdio.h>
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+typedef ps2::Keyboard<dataPin, clockPin, 16> TestKeyboard;
+
+// Lets simulated time pass, reading scan codes as a sketch's loop() would, and returns the
+//  ones that weren't none.
+static std::vector<ps2::KeyboardOutput> readFor(TestKeyboard &keyboard, uint32_t microseconds) {
+    std::vector<ps2::KeyboardOutput> codes;
+    uint32_t start = host::now();
+    while (host::now() - start < microseconds) {
+        ps2::KeyboardOutput code = keyboard.readScanCode();
+        if (code != ps2::KeyboardOutput::none) {
+            codes.push_back(code);
+        }
+        host::advance(20);
+    }
+    return codes;
+}
+
+// A clock line that never stops, as if the device sent bytes back to back forever.
+class FreeRunningClock : public host::Device {
+public:
+    void step(uint32_t nowMicroseconds) override {
+        host::pullLow(clockPin, (nowMicroseconds / 40) % 2 == 0);
+    }
+};
+
+static void testCommandWaitsForFrame() {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    TestKeyboard keyboard;
+    keyboard.begin();
+    readFor(keyboard, 1000000);
+
+    // A command sent while a byte is coming in waits for it, rather than cutting it off.
+    device.type({ 0x1c });
+    host::advance(300);
+    CHECK(device.isSending());
+    CHECK(keyboard.echo());
+    CHECK_EQUAL(device.statistics.framesAborted, 0u);
+    std::vector<ps2::KeyboardOutput> codes = readFor(keyboard, 10000);
+    CHECK(codes.size() == 1 && codes[0] == ps2::KeyboardOutput::sc2_a);
+}
+
+static void testCommandWaitIsBounded() {
+    host::reset();
+    TestKeyboard keyboard;
+    keyboard.begin();
+    FreeRunningClock clock;
+    host::attach(clock);
+    host::advance(1000);
+
+    // With no gap between frames to send in, the command goes anyway, and gets no answer.
+    uint32_t start = host::now();
+    CHECK(!keyboard.echo());
+    CHECK(host::now() - start < 50000);
+    host::detach(clock);
+}
+
+static void testDefaultsKeepLeds() {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    TestKeyboard keyboard;
+    keyboard.begin();
+    readFor(keyboard, 1000000);
+
+    CHECK(keyboard.sendLedStatus(ps2::KeyboardLeds::capsLock));
+    CHECK_EQUAL(device.leds, 4);
+
+    // "Set Default" puts the scan code set and typematic rate back, but not the LEDs, so
+    //  turning them off afterwards still has to be sent.
+    CHECK(keyboard.resetToDefaults());
+    CHECK_EQUAL(device.leds, 4);
+    CHECK(keyboard.sendLedStatus(ps2::KeyboardLeds::none));
+    CHECK_EQUAL(device.leds, 0);
+}
+
+// A keyboard's own buffer; when a keystroke doesn't fit, it's lost.
+static const size_t keyboardBufferSize = 16;
+
+struct TypingResult {
+    uint32_t typed;          // bytes of keystrokes typed
+    uint32_t lostOnKeyboard; // bytes that didn't fit in the keyboard's buffer
+    uint32_t lostOnHost;     // bytes that made it onto the wire but not out of readScanCode
+    bool isInOrder;          // whether what came out is exactly what went on the wire
+};
+
+// Types in bursts for the given time, with loop() reading everything waiting and then
+//  taking a millisecond, or one time in ten, up to maxStallMilliseconds.
+template <uint8_t BufferSize>
+static TypingResult typeWithStalls(uint32_t seconds, uint32_t maxStallMilliseconds, uint8_t highWaterMark, uint8_t lowWaterMark) {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    ps2::Keyboard<dataPin, clockPin, BufferSize> keyboard;
+    keyboard.begin();
+    host::advance(1000);
+    if (highWaterMark != 0) {
+        keyboard.enableBackpressure(highWaterMark, lowWaterMark);
+    }
+
+    static const uint8_t keys[] = { 0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33, 0x43, 0x3b, 0x42, 0x4b };
+    // Separate, so the typing is the same however loop() stalls.
+    sim::Random typing(7);
+    sim::Random stalls(11);
+    TypingResult result = { 0, 0, 0, true };
+    std::vector<uint8_t> onWire;
+    std::vector<uint8_t> received;
+    uint32_t keystrokes = 0;
+    uint32_t burstLeft = 0;
+    uint32_t nextKeystroke = host::now();
+    uint32_t end = host::now() + seconds * 1000000;
+
+    // Keystrokes every 30-100ms in bursts of up to 30, with up to 2s between bursts.
+    auto typeDue = [&]() {
+        while (host::now() >= nextKeystroke && nextKeystroke < end) {
+            uint8_t key = keys[keystrokes++ % sizeof(keys)];
+            result.typed += 3;
+            if (device.pendingCount() + 3 > keyboardBufferSize) {
+                result.lostOnKeyboard += 3;
+            }
+            else {
+                device.type({ key, 0xf0, key });
+                onWire.insert(onWire.end(), { key, 0xf0, key });
+            }
+            if (burstLeft == 0) {
+                burstLeft = 1 + typing.below(30);
+                nextKeystroke += 500000 + typing.below(1500000);
+            }
+            else {
+                --burstLeft;
+                nextKeystroke += 30000 + typing.below(70000);
+            }
+        }
+    };
+
+    while (host::now() < end + 1000000) {
+        for (ps2::KeyboardOutput code = keyboard.readScanCode(); code != ps2::KeyboardOutput::none; code = keyboard.readScanCode()) {
+            received.push_back((uint8_t)code);
+        }
+        uint32_t work = stalls.chance(.1) ? 1 + stalls.below(maxStallMilliseconds) : 1;
+        for (uint32_t i = 0; i < work; ++i) {
+            typeDue();
+            host::advance(1000);
+        }
+    }
+
+    result.lostOnHost = onWire.size() - received.size();
+    result.isInOrder = received == onWire;
+    return result;
+}
+
+static void testBackpressure() {
+    // Bytes lost to a loop() that stalls, with the keyboard's buffer overwritten and with it
+    //  held off until there's room.  Held off, nothing gets lost once it's on the wire, and
+    //  what's lost on the keyboard is only what the keyboard's own buffer couldn't hold.
+    static const uint32_t maxStalls[] = { 50, 100, 200, 400 };
+    for (uint32_t maxStall : maxStalls) {
+        TypingResult off = typeWithStalls<8>(60, maxStall, 0, 0);
+        TypingResult on = typeWithStalls<8>(60, maxStall, 8, 2);
+        printf("stalls up to %ums, %u bytes typed:  overwriting, %u lost; backpressure (8/2), %u lost\n",
+            maxStall, off.typed, off.lostOnKeyboard + off.lostOnHost, on.lostOnKeyboard + on.lostOnHost);
+        CHECK_EQUAL(off.lostOnKeyboard, 0u);
+        CHECK_EQUAL(on.lostOnHost, 0u);
+        CHECK(on.isInOrder);
+        if (maxStall >= 200) {
+            CHECK(on.lostOnKeyboard + on.lostOnHost < off.lostOnKeyboard + off.lostOnHost);
+        }
+    }
+}
+
+static void testLedsWhileTyping() {
+    // Typing flat out while the LEDs change every few milliseconds, half the time with
+    //  sendLedStatus and half with queueLedStatus.  The commands cut into the keyboard's
+    //  bytes now and then, and it sends those again; every byte has to come out of
+    //  readScanCode once, in the order it was typed.
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    TestKeyboard keyboard;
+    keyboard.begin();
+    readFor(keyboard, 1000000);
+
+    static const uint8_t keys[] = { 0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33, 0x43, 0x3b, 0x42, 0x4b };
+    static const ps2::KeyboardLeds ledStates[] = { ps2::KeyboardLeds::capsLock, ps2::KeyboardLeds::numLock,
+        ps2::KeyboardLeds::scrollLock, ps2::KeyboardLeds::none };
+    std::vector<uint8_t> typed;
+    std::vector<uint8_t> received;
+    uint32_t keystrokes = 0;
+    uint32_t ledChanges = 0;
+    uint32_t failedSends = 0;
+    uint32_t nextLedChange = host::now();
+    uint32_t end = host::now() + 5000000;
+    while (host::now() < end) {
+        if (device.pendingCount() < 3) {
+            uint8_t key = keys[keystrokes++ % sizeof(keys)];
+            device.type({ key, 0xf0, key });
+            typed.insert(typed.end(), { key, 0xf0, key });
+        }
+        if ((int32_t)(host::now() - nextLedChange) >= 0) {
+            ps2::KeyboardLeds leds = ledStates[ledChanges % 4];
+            if (ledChanges % 2 == 0) {
+                failedSends += keyboard.sendLedStatus(leds) ? 0 : 1;
+            }
+            else {
+                keyboard.queueLedStatus(leds);
+            }
+            ++ledChanges;
+            nextLedChange = host::now() + 3000 + (ledChanges * 137) % 2000;
+        }
+        for (ps2::KeyboardOutput code = keyboard.readScanCode(); code != ps2::KeyboardOutput::none; code = keyboard.readScanCode()) {
+            received.push_back((uint8_t)code);
+        }
+        host::advance(20);
+    }
+    for (ps2::KeyboardOutput code : readFor(keyboard, 100000)) {
+        received.push_back((uint8_t)code);
+    }
+
+    printf("%u bytes typed in 5s with %u LED changes:  %u frames cut off and sent again, %u received\n",
+        (unsigned)typed.size(), ledChanges, device.statistics.framesAborted, (unsigned)received.size());
+    CHECK(typed.size() > 1500);
+    CHECK(device.statistics.framesAborted > 0);
+    CHECK_EQUAL(failedSends, 0u);
+    CHECK_EQUAL(device.statistics.badFramesReceived, 0u);
+    CHECK_EQUAL(received.size(), typed.size());
+    CHECK(received == typed);
+    CHECK_EQUAL(device.leds, (uint8_t)ledStates[(ledChanges - 1) % 4]);
+}
+
+int main() {
+    testCommandWaitsForFrame();
+    testCommandWaitIsBounded();
+    testDefaultsKeepLeds();
+    testBackpressure();
+    testLedsWhileTyping();
+    return checkResult();
+}
@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Runs Mouse against the simulated mouse in extras/sim.
+
+#include "Arduino.h"
+#include "ps2_Mouse.h"
+#include "Ps2DeviceSim.h"
+#include "Check.h"
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+typedef ps2::Mouse<dataPin, clockPin, 16> TestMouse;
+
+// A mouse that, when told to stop reporting, first sends again the 0 byte that the command
+//  cut off, as some do.
+class ZeroFirstMouseSim : public sim::MouseSim {
+protected:
+    void onCommand(byte b) override {
+        if (b == 0xf5) {
+            this->commandLog.push_back(b);
+            this->clearOutput();
+            this->isReporting = false;
+            this->answer({ 0x00, 0xfa });
+        }
+        else {
+            sim::MouseSim::onCommand(b);
+        }
+    }
+
+public:
+    ZeroFirstMouseSim() : sim::MouseSim(::dataPin, ::clockPin) {}
+};
+
+static void testZeroBeforeAck() {
+    host::reset();
+    ZeroFirstMouseSim device;
+    device.plugIn(0);
+    TestMouse mouse;
+    mouse.begin();
+    CHECK(mouse.initialize());
+
+    // The 0 byte mustn't be taken for no answer at all.
+    CHECK(mouse.disableStreaming());
+    CHECK(!device.isReporting);
+    CHECK(mouse.enableStreaming());
+    CHECK(device.isReporting);
+}
+
+static void testResynchronize() {
+    host::reset();
+    sim::MouseSim device(dataPin, clockPin);
+    device.plugIn(0);
+    TestMouse mouse;
+    mouse.begin();
+    CHECK(mouse.initialize());
+    CHECK(mouse.hasFiveButtons());
+
+    // Every packet that comes through is a good one, even with some bytes garbled on the
+    //  way, and most of them come through.
+    device.faults.parity = 0.02;
+    int packetCount = 0;
+    int wrongCount = 0;
+    for (int i = 0; i < 500; ++i) {
+        device.move(3, -2, 1, 1);
+        uint32_t start = host::now();
+        while (host::now() - start < 10000) {
+            ps2::MousePacket packet;
+            while (mouse.readPacket(packet)) {
+                ++packetCount;
+                if (packet.x != 3 || packet.y != -2 || packet.wheel != 1 || packet.buttons != ps2::MouseButtons::left) {
+                    ++wrongCount;
+                }
+            }
+            host::advance(50);
+        }
+    }
+    CHECK_EQUAL(wrongCount, 0);
+    CHECK(packetCount > 400);
+    CHECK(device.statistics.faultsInjected > 0);
+}
+
+int main() {
+    testZeroBeforeAck();
+    testResynchronize();
+    return checkResult();
+}
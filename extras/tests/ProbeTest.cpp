@@ -0,0 +1,221 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Runs Keyboard::enableProbing against the simulated keyboard in extras/sim:  what it finds
+//  out about keyboards with and without scan code set 3, that the sketch's settings survive
+//  it, and how soon the first key gets through compared with asking the same questions one
+//  at a time from setup(), as the SelfTest example does.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "Ps2DeviceSim.h"
+#include <stdio.h>
+#include "Check.h"
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+typedef ps2::Keyboard<dataPin, clockPin, 16> TestKeyboard;
+typedef sim::KeyboardSim::Set3Support Set3Support;
+
+// Calls readScanCode as loop() would until the probe is done, or a second has gone by.
+static void finishProbe(TestKeyboard &keyboard) {
+    uint32_t start = host::now();
+    while (keyboard.isProbing() && host::now() - start < 1000000) {
+        keyboard.readScanCode();
+        host::advance(20);
+    }
+}
+
+static void testProfiles() {
+    const Set3Support supports[] = { Set3Support::supported, Set3Support::ignored, Set3Support::refused };
+    for (Set3Support support : supports) {
+        host::reset();
+        sim::KeyboardSim device(dataPin, clockPin);
+        device.set3Support = support;
+        device.plugIn(0);
+        TestKeyboard keyboard;
+        keyboard.begin();
+        host::advance(1000);
+
+        CHECK(!keyboard.getDeviceProfile().isValid());
+        keyboard.enableProbing();
+        CHECK(keyboard.isProbing());
+        finishProbe(keyboard);
+        CHECK(!keyboard.isProbing());
+
+        const ps2::DeviceProfile &profile = keyboard.getDeviceProfile();
+        CHECK(profile.isValid());
+        CHECK_EQUAL(profile.id, 0xab83);
+        CHECK(profile.supportsScanCodeSet(ps2::ScanCodeSet::pcat));
+        CHECK(profile.hasPerKeyBreakAndTypematic() == (support == Set3Support::supported));
+
+        // The keyboard is left as it was found:  in set 2 and scanning.
+        CHECK_EQUAL(device.scanCodeSet, 2);
+        CHECK(device.isScanning);
+    }
+
+    // A keyboard too old to have an ID.
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.idLength = 0;
+    device.plugIn(0);
+    TestKeyboard keyboard;
+    keyboard.begin();
+    host::advance(1000);
+    keyboard.enableProbing();
+    finishProbe(keyboard);
+    CHECK_EQUAL(keyboard.getDeviceProfile().id, 0);
+    CHECK(keyboard.getDeviceProfile().isValid());
+}
+
+static void testSettingsSurviveProbe() {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    TestKeyboard keyboard;
+    keyboard.begin();
+    host::advance(1000);
+
+    // The probe puts the keyboard back to its defaults, so these have to be sent after it.
+    keyboard.enableProbing();
+    keyboard.queueLedStatus(ps2::KeyboardLeds::capsLock);
+    keyboard.queueTypematicRateAndDelay(ps2::TypematicRate::slowestRate, ps2::TypematicStartDelay::_0_25_sec);
+    finishProbe(keyboard);
+    uint32_t start = host::now();
+    while (keyboard.isRestoringConfiguration() && host::now() - start < 100000) {
+        keyboard.readScanCode();
+        host::advance(20);
+    }
+    CHECK_EQUAL(device.leds, 4);
+    CHECK_EQUAL(device.typematic, 0x1f);
+
+    // After a restart, the keyboard is probed again and the settings sent again.
+    device.plugIn(300000);
+    start = host::now();
+    while (host::now() - start < 400000) {
+        keyboard.readScanCode();
+        host::advance(20);
+    }
+    CHECK(!keyboard.isProbing());
+    CHECK(!keyboard.isRestoringConfiguration());
+    CHECK(keyboard.getDeviceProfile().hasPerKeyBreakAndTypematic());
+    CHECK_EQUAL(device.leds, 4);
+    CHECK_EQUAL(device.typematic, 0x1f);
+}
+
+struct StartupTimes {
+    uint32_t setupReturned;      // from power-up or reset, in microseconds
+    uint32_t profileKnown;
+    uint32_t firstKey;
+    uint32_t longestReadScanCode;
+};
+
+// Starts the sketch either as the keyboard gets power ("cold", when it takes the usual half
+//  second to send BAT), or with the keyboard already running ("warm", as when the Arduino
+//  is reset), then finds out what the keyboard is either by asking from setup() or by
+//  probing.  The keyboard types 'a' every 10ms from the start.
+static StartupTimes startUp(bool isCold, bool isProbing) {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    if (!isCold) {
+        device.plugIn(0);
+        host::advance(1000000);
+    }
+    uint32_t start = host::now();
+    if (isCold) {
+        device.plugIn(500000);
+    }
+    TestKeyboard keyboard;
+    StartupTimes times = { 0, 0, 0, 0 };
+
+    // setup()
+    keyboard.begin();
+    if (isProbing) {
+        keyboard.enableProbing();
+    }
+    else {
+        keyboard.awaitStartup();
+        keyboard.readId();
+        keyboard.getScanCodeSet();
+        keyboard.setScanCodeSet(ps2::ScanCodeSet::ps2);
+        keyboard.getScanCodeSet();
+        keyboard.setScanCodeSet(ps2::ScanCodeSet::pcat);
+        times.profileKnown = host::now() - start;
+    }
+    times.setupReturned = host::now() - start;
+
+    // loop()
+    uint32_t nextKey = start;
+    while (host::now() - start < 2000000 && (times.firstKey == 0 || times.profileKnown == 0)) {
+        if ((int32_t)(host::now() - nextKey) >= 0) {
+            device.type({ 0x1c });
+            nextKey += 10000;
+        }
+        uint32_t callStart = host::now();
+        ps2::KeyboardOutput code = keyboard.readScanCode();
+        uint32_t callTime = host::now() - callStart;
+        if (callTime > times.longestReadScanCode) {
+            times.longestReadScanCode = callTime;
+        }
+        if (code == ps2::KeyboardOutput::sc2_a && times.firstKey == 0) {
+            times.firstKey = host::now() - start;
+        }
+        if (isProbing && !keyboard.isProbing() && times.profileKnown == 0) {
+            times.profileKnown = host::now() - start;
+        }
+        host::advance(20);
+    }
+    return times;
+}
+
+static void testStartupTime() {
+    StartupTimes coldBySetup = startUp(true, false);
+    StartupTimes coldByProbe = startUp(true, true);
+    StartupTimes warmBySetup = startUp(false, false);
+    StartupTimes warmByProbe = startUp(false, true);
+    printf("                 setup returns  profile known  first key  longest readScanCode\n");
+    const StartupTimes *all[] = { &coldBySetup, &coldByProbe, &warmBySetup, &warmByProbe };
+    const char *names[] = { "cold, by setup", "cold, by probe", "warm, by setup", "warm, by probe" };
+    for (int i = 0; i < 4; ++i) {
+        printf("%-16s %10.1fms %12.1fms %8.1fms %18uus\n", names[i], all[i]->setupReturned / 1000.0,
+            all[i]->profileKnown / 1000.0, all[i]->firstKey / 1000.0, all[i]->longestReadScanCode);
+    }
+
+    // Cold, the keyboard's self-test takes most of the time either way.  Warm, asking from
+    //  setup waits out awaitStartup's 750ms, where probing is done in a few tens of
+    //  milliseconds, and setup doesn't wait on the keyboard at all.
+    CHECK(coldByProbe.setupReturned < 1000);
+    CHECK(warmByProbe.setupReturned < 1000);
+    CHECK(coldByProbe.profileKnown < coldBySetup.profileKnown + 10000);
+    CHECK(warmByProbe.profileKnown < 50000);
+    CHECK(warmBySetup.profileKnown > 750000);
+    CHECK(warmByProbe.firstKey < 50000);
+    CHECK(warmByProbe.firstKey + 700000 < warmBySetup.firstKey);
+    CHECK(coldByProbe.firstKey < coldBySetup.firstKey + 10000);
+    CHECK(coldByProbe.longestReadScanCode < 200);
+    CHECK(warmByProbe.longestReadScanCode < 200);
+}
+
+int main() {
+    testProfiles();
+    testSettingsSurviveProbe();
+    testStartupTime();
+    return checkResult();
+}
@@ -0,0 +1,41 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Runs the parts of the SelfTest sketch that don't need a keyboard - testQueue and
+//  testTranslators - on the PC.  Those report failures by printing to Serial, so any output
+//  at all is a failure.  testTranslators' checksums are computed with the same _crc16_update
+//  the AVR library has, so they're the same ones the sketch expects on the board.
+
+#include "Arduino.h"
+#include "../../examples/SelfTest/SelfTest.ino"
+#include "Check.h"
+
+int main() {
+    host::reset();
+
+    testQueue();
+    CHECK(host::serialOutput().empty());
+    printf("%s", host::serialOutput().c_str());
+
+    host::serialOutput().clear();
+    testTranslators();
+    CHECK(host::serialOutput().empty());
+    printf("%s", host::serialOutput().c_str());
+
+    return checkResult();
+}
@@ -0,0 +1,244 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+// Checks TypematicGenerator:  when it repeats, what it does with the keyboard's own repeats,
+//  acceleration and the rate table.  Then it holds a key down on the simulated keyboard in
+//  extras/sim, once with the keyboard repeating it and once with the generator, and counts
+//  the read interrupts each takes.  Multiply the difference by the cycles avr-bench gives for
+//  readInterruptHandler (see extras/avr) for the time saved on a board.
+
+#include "Arduino.h"
+#include "ps2_Keyboard.h"
+#include "ps2_TypematicGenerator.h"
+#include "ps2_NullDiagnostics.h"
+#include "Ps2DeviceSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "Check.h"
+
+static const int dataPin = 4;
+static const int clockPin = 3;
+
+using ps2::KeyboardOutput;
+
+struct TimedCode {
+    uint32_t milliseconds;
+    KeyboardOutput code;
+};
+
+// Feeds the generator the given codes, each at the given time, and calls process every
+//  millisecond in between, for the given time.  Returns what came out and when.
+static std::vector<TimedCode> run(ps2::TypematicGenerator &typematic, const std::vector<TimedCode> &input, uint32_t milliseconds) {
+    std::vector<TimedCode> output;
+    size_t next = 0;
+    uint32_t start = millis();
+    while (millis() - start < milliseconds) {
+        uint32_t now = millis() - start;
+        KeyboardOutput code = KeyboardOutput::none;
+        if (next < input.size() && input[next].milliseconds <= now) {
+            code = input[next++].code;
+        }
+        code = typematic.process(code);
+        if (code != KeyboardOutput::none) {
+            output.push_back({ now, code });
+        }
+        host::advance(1000 - (host::now() % 1000));
+    }
+    return output;
+}
+
+// The keyboard's own repeats of a key, at 30cps after 250ms, as it would send them.
+static std::vector<TimedCode> heldOnKeyboard(std::vector<KeyboardOutput> key, uint32_t milliseconds) {
+    std::vector<TimedCode> codes;
+    for (KeyboardOutput code : key) {
+        codes.push_back({ 0, code });
+    }
+    for (uint32_t t = 250; t < milliseconds; t += 33) {
+        for (KeyboardOutput code : key) {
+            codes.push_back({ t, code });
+        }
+    }
+    return codes;
+}
+
+static void testRepeats() {
+    host::reset();
+    ps2::TypematicGenerator typematic(250, 50);
+
+    // The keyboard's repeats are dropped, and the generator's come at the delay and interval.
+    std::vector<TimedCode> input = heldOnKeyboard({ KeyboardOutput::sc2_a }, 400);
+    input.push_back({ 400, KeyboardOutput::unmake });
+    input.push_back({ 400, KeyboardOutput::sc2_a });
+    std::vector<TimedCode> output = run(typematic, input, 600);
+    CHECK_EQUAL(output.size(), 6u);
+    if (output.size() == 6) {
+        CHECK_EQUAL(output[0].milliseconds, 0u);
+        // A repeat can come a call late, when the call it was due on had a code to drop.
+        CHECK(output[1].milliseconds >= 250 && output[1].milliseconds <= 251);
+        CHECK(output[2].milliseconds >= 300 && output[2].milliseconds <= 301);
+        CHECK(output[3].milliseconds >= 350 && output[3].milliseconds <= 351);
+        for (int i = 0; i < 4; ++i) {
+            CHECK(output[i].code == KeyboardOutput::sc2_a);
+        }
+        CHECK(output[4].code == KeyboardOutput::unmake);
+        CHECK(output[5].code == KeyboardOutput::sc2_a);
+    }
+}
+
+static void testExtendedRepeats() {
+    host::reset();
+    ps2::TypematicGenerator typematic(250, 50);
+
+    // Repeats of an extended key come with their extend, and the keyboard's don't leave one
+    //  behind.
+    std::vector<TimedCode> input = heldOnKeyboard({ KeyboardOutput::extend, KeyboardOutput::sc2ex_leftArrow }, 320);
+    input.push_back({ 320, KeyboardOutput::extend });
+    input.push_back({ 320, KeyboardOutput::unmake });
+    input.push_back({ 320, KeyboardOutput::sc2ex_leftArrow });
+    std::vector<TimedCode> output = run(typematic, input, 500);
+    std::vector<KeyboardOutput> codes;
+    for (const TimedCode &c : output) {
+        codes.push_back(c.code);
+    }
+    CHECK(codes == std::vector<KeyboardOutput>({
+        KeyboardOutput::extend, KeyboardOutput::sc2ex_leftArrow,
+        KeyboardOutput::extend, KeyboardOutput::sc2ex_leftArrow,
+        KeyboardOutput::extend, KeyboardOutput::sc2ex_leftArrow,
+        KeyboardOutput::extend, KeyboardOutput::unmake, KeyboardOutput::sc2ex_leftArrow }));
+}
+
+static void testAcceleration() {
+    host::reset();
+    ps2::TypematicGenerator typematic(100, 50);
+    typematic.setAcceleration(20, 10);
+    std::vector<TimedCode> output = run(typematic, { { 0, KeyboardOutput::sc2_a } }, 311);
+    std::vector<uint32_t> times;
+    for (const TimedCode &c : output) {
+        times.push_back(c.milliseconds);
+    }
+    CHECK(times == std::vector<uint32_t>({ 0, 100, 150, 190, 220, 240, 260, 280, 300 }));
+}
+
+static void testPausePassesThrough() {
+    host::reset();
+    ps2::TypematicGenerator typematic(250, 50);
+    const std::vector<KeyboardOutput> pause = {
+        KeyboardOutput::extend1, (KeyboardOutput)0x14, (KeyboardOutput)0x77,
+        KeyboardOutput::extend1, KeyboardOutput::unmake, (KeyboardOutput)0x14, KeyboardOutput::unmake, (KeyboardOutput)0x77 };
+    std::vector<TimedCode> input;
+    for (KeyboardOutput code : pause) {
+        input.push_back({ 0, code });
+    }
+    std::vector<TimedCode> output = run(typematic, input, 400);
+    std::vector<KeyboardOutput> codes;
+    for (const TimedCode &c : output) {
+        codes.push_back(c.code);
+    }
+    CHECK(codes == pause);
+}
+
+static void testRateTable() {
+    // The characters per second in the keyboard's rate table, in order.  These match the
+    //  TypematicRate names, except that 0x04 is named _20_7_cps.
+    static const double cps[32] = {
+        30.0, 26.7, 24.0, 21.8, 20.0, 18.5, 17.1, 16.0, 15.0, 13.3, 12.0, 10.9, 10.0, 9.2, 8.6, 8.0,
+        7.5, 6.7, 6.0, 5.5, 5.0, 4.6, 4.3, 4.0, 3.7, 3.3, 3.0, 2.7, 2.5, 2.3, 2.1, 2.0 };
+    for (uint8_t r = 0; r < 32; ++r) {
+        double actual = 1000.0 / ps2::TypematicGenerator::toMilliseconds((ps2::TypematicRate)r);
+        CHECK(fabs(actual - cps[r]) / cps[r] < 0.02);
+    }
+    CHECK(ps2::TypematicRate::_09_2_cps == (ps2::TypematicRate)0x0d);
+    CHECK(ps2::TypematicRate::_02_0_cps == ps2::TypematicRate::slowestRate);
+    CHECK_EQUAL(ps2::TypematicGenerator::toMilliseconds(ps2::TypematicStartDelay::_0_25_sec), 250);
+}
+
+// Counts the read interrupts, which is where the keyboard's own repeats cost time.
+class InterruptCounter : public ps2::NullDiagnostics {
+public:
+    uint32_t readInterrupts = 0;
+    void readInterruptStarted() { ++this->readInterrupts; }
+};
+
+struct HoldResult {
+    uint32_t readInterrupts;
+    uint32_t makes;
+};
+
+// Holds 'a' down for two seconds, with the keyboard repeating it at 30cps or not, and the
+//  generator doing it at the same rate or not.
+static HoldResult holdKey(bool isKeyboardRepeating, bool isGeneratorRepeating) {
+    host::reset();
+    sim::KeyboardSim device(dataPin, clockPin);
+    device.plugIn(0);
+    InterruptCounter counter;
+    ps2::Keyboard<dataPin, clockPin, 16, InterruptCounter> keyboard(counter);
+    ps2::TypematicGenerator typematic(250, 33);
+    keyboard.begin();
+    host::advance(1000);
+
+    HoldResult result = { 0, 0 };
+    uint32_t start = host::now();
+    uint32_t nextRepeat = start + 250000;
+    device.type({ 0x1c });
+    counter.readInterrupts = 0;
+    while (host::now() - start < 2000000) {
+        if (isKeyboardRepeating && host::now() >= nextRepeat) {
+            device.type({ 0x1c });
+            nextRepeat += 33000;
+        }
+        KeyboardOutput code = keyboard.readScanCode();
+        if (isGeneratorRepeating) {
+            code = typematic.process(code);
+        }
+        result.makes += code == KeyboardOutput::sc2_a;
+        host::advance(100);
+    }
+    result.readInterrupts = counter.readInterrupts;
+    return result;
+}
+
+static void testInterruptsSaved() {
+    HoldResult onKeyboard = holdKey(true, false);
+    HoldResult onGenerator = holdKey(false, true);
+    printf("'a' held for 2s at 30cps:  keyboard repeating, %u makes, %u read interrupts; generator repeating, %u makes, %u read interrupts\n",
+        onKeyboard.makes, onKeyboard.readInterrupts, onGenerator.makes, onGenerator.readInterrupts);
+
+    // The same keys come out either way (the make and 54 repeats), but with the generator,
+    //  only the make costs any interrupts:  11 of them.
+    CHECK(onKeyboard.makes >= 54 && onKeyboard.makes <= 56);
+    CHECK(onGenerator.makes >= 54 && onGenerator.makes <= 56);
+    CHECK_EQUAL(onKeyboard.readInterrupts, 11 * onKeyboard.makes);
+    CHECK_EQUAL(onGenerator.readInterrupts, 11u);
+
+    // In scan code set 2, where the keyboard can't be told to stop, the generator drops the
+    //  keyboard's repeats and still gives the same result.
+    HoldResult both = holdKey(true, true);
+    CHECK(both.makes >= 54 && both.makes <= 56);
+}
+
+int main() {
+    testRepeats();
+    testExtendedRepeats();
+    testAcceleration();
+    testPausePassesThrough();
+    testRateTable();
+    testInterruptsSaved();
+    return checkResult();
+}
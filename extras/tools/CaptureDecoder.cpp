@@ -0,0 +1,95 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Decodes a logic analyzer capture of a PS2 port; see CaptureDecoder.h.
+//
+//      CaptureDecoder [options] capture.vcd|capture.csv|-
+//
+//      --clock NAME       the clock line's name in the capture (default: clock or clk)
+//      --data NAME        the data line's name (default: data or dat)
+//      --samplerate HZ    for a CSV file without one
+//      --summary          only print the number of each kind of event
+//
+//  The format is taken from the first character:  '$' is VCD, anything else is CSV.
+
+#include "CaptureDecoder.h"
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+    const char *clockName = nullptr;
+    const char *dataName = nullptr;
+    const char *path = nullptr;
+    double samplerate = 0;
+    bool isSummaryOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) {
+            clockName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            dataName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--samplerate") == 0 && i + 1 < argc) {
+            samplerate = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--summary") == 0) {
+            isSummaryOnly = true;
+        }
+        else if (path == nullptr) {
+            path = argv[i];
+        }
+        else {
+            path = nullptr;
+            break;
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "usage: %s [--clock NAME] [--data NAME] [--samplerate HZ] [--summary] capture.vcd|capture.csv|-\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if (strcmp(path, "-") != 0) {
+        file.open(path, std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "can't open %s\n", path);
+            return 2;
+        }
+        in = &file;
+    }
+
+    capture::EventLog log;
+    log.file = stdout;
+    log.isSummaryOnly = isSummaryOnly;
+    capture::Decoder decoder(log);
+    std::string error;
+    *in >> std::ws;
+    bool isOk = in->peek() == '$'
+        ? capture::readVcd(*in, decoder, clockName, dataName, error)
+        : capture::readSigrokCsv(*in, decoder, clockName, dataName, samplerate, error);
+    if (!isOk) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return 1;
+    }
+    if (!isSummaryOnly) {
+        printf("\n");
+    }
+    log.writeSummary();
+    return 0;
+}
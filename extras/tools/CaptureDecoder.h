@@ -0,0 +1,491 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+// Decodes the clock and data lines of a PS2 port, as recorded by a logic analyzer, using the
+//  library's own receiver (Port::receiveBit) for the bytes the keyboard sends.  The result is
+//  the list of Diagnostics events the board would have logged:  the bytes received and sent,
+//  parity, start and stop bit errors, missed edges and so on, each with the time it happened.
+//
+//  Captures are read a line at a time and only the current state of the two lines is kept,
+//  so there's no limit on their size.  Two formats are understood:
+//
+//   - VCD (value change dump), as written by most logic analyzer software, PulseView and
+//     simulators.  The lines are picked out by name.
+//   - CSV as written by sigrok-cli -O csv:  comment lines starting with ';' (one of which gives
+//     the samplerate), a header row naming the channels, and one row per sample.  A column
+//     named "Time", in seconds, is used if it's there; otherwise the samplerate is.
+//
+//  The decoder only sees the wires, so it has to work out who is driving them.  A clock low
+//  for longer than a keyboard ever holds it (more than 75us) is the host:  either holding the
+//  keyboard off, or, if the data line is low when it lets go, starting to send a byte, which
+//  is decoded separately and reported through sentByte (and sendFrameError if the keyboard
+//  didn't acknowledge it).  The edges the host makes are not fed to the receiver, just as
+//  the library ignores them on the board.
+
+#include "Arduino.h"
+#include "ps2_Port.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace capture {
+    /** \brief A Diagnostics class that writes each event as a line of text, with its time. */
+    class EventLog {
+    public:
+        enum class Event : uint8_t {
+            packetDidNotStartWithZero, parityError, packetDidNotEndWithOne, packetIncomplete,
+            sendFrameError, bufferOverflow, receivedByte, sentByte, clockLineGlitch,
+            lostByte, garbledByte, abortedByHost,
+            _count
+        };
+
+        // Where the lines go:  a file, or if that's null, the text member.
+        FILE *file = nullptr;
+        std::string text;
+        bool isSummaryOnly = false;
+        uint64_t nowNanoseconds = 0;
+        uint32_t counts[(int)Event::_count] = {};
+
+        void packetDidNotStartWithZero() { this->log(Event::packetDidNotStartWithZero, "start bit was 1"); }
+        void parityError() { this->log(Event::parityError, "parity error"); }
+        void packetDidNotEndWithOne() { this->log(Event::packetDidNotEndWithOne, "stop bit was 0"); }
+        void packetIncomplete() { this->log(Event::packetIncomplete, "frame incomplete (missed edge)"); }
+        void sendFrameError() { this->log(Event::sendFrameError, "keyboard didn't acknowledge the byte sent"); }
+        void startupFailure() {}
+        void bufferOverflow() { this->log(Event::bufferOverflow, "buffer overflow"); }
+        void incorrectResponse(ps2::KeyboardOutput, ps2::KeyboardOutput) {}
+        void noResponse(ps2::KeyboardOutput) {}
+        void noTranslationForKey(bool, ps2::KeyboardOutput) {}
+        void sentByte(byte b) { this->log(Event::sentByte, "sent", b); }
+        void receivedByte(byte b) { this->log(Event::receivedByte, "received", b); }
+        void clockLineGlitch(uint8_t numBitsSent) { this->log(Event::clockLineGlitch, "clock line glitch", numBitsSent); }
+
+        // Not Diagnostics events, but things the decoder can see that the board can't.
+        void lostByte() { this->log(Event::lostByte, "byte lost"); }
+        void garbledByte(byte b) { this->log(Event::garbledByte, "garbled byte, read as", b); }
+        void abortedByHost(uint8_t bits) { this->log(Event::abortedByHost, "frame cut off by the host after bits:", bits); }
+
+        uint32_t count(Event event) const { return this->counts[(int)event]; }
+
+        /** \brief Writes the number of each kind of event. */
+        void writeSummary() {
+            static const char *names[] = {
+                "start bit 1", "parity errors", "stop bit 0", "incomplete frames",
+                "unacknowledged sends", "buffer overflows", "bytes received", "bytes sent",
+                "clock line glitches", "bytes lost", "garbled bytes", "frames cut off by the host",
+            };
+            for (int i = 0; i < (int)Event::_count; ++i) {
+                char line[64];
+                snprintf(line, sizeof(line), "%10u  %s\n", this->counts[i], names[i]);
+                this->write(line);
+            }
+        }
+
+    private:
+        void write(const char *line) {
+            if (this->file != nullptr) {
+                fputs(line, this->file);
+            }
+            else {
+                this->text += line;
+            }
+        }
+
+        void log(Event event, const char *what, int value = -1) {
+            ++this->counts[(int)event];
+            if (this->isSummaryOnly) {
+                return;
+            }
+            char line[96];
+            int length = snprintf(line, sizeof(line), "%14.3fms  %s", this->nowNanoseconds / 1e6, what);
+            if (value >= 0 && length > 0 && length < (int)sizeof(line)) {
+                snprintf(line + length, sizeof(line) - length, event == Event::receivedByte || event == Event::sentByte || event == Event::garbledByte ? " %02x" : " %d", value);
+            }
+            strncat(line, "\n", sizeof(line) - strlen(line) - 1);
+            this->write(line);
+        }
+    };
+
+    /** \brief Turns the states of the two lines over time into events. */
+    class Decoder : private ps2::Port<0, 1, 16, EventLog> {
+        // Longer than a keyboard holds the clock low (the spec says 30 to 50us).
+        static const uint64_t maxKeyboardClockLowNanoseconds = 75000;
+
+        EventLog &log;
+        bool isClockHigh = true;
+        bool isDataHigh = true;
+        uint64_t clockFellAt = 0;
+        bool dataAtFall = true;
+
+        bool isHostSending = false;
+        uint8_t hostFalls = 0;
+        uint8_t hostRises = 0;
+        uint16_t hostBits = 0;
+        bool isHostAcknowledged = false;
+
+        // The byte the keyboard is sending, as the decoder sees it, for reporting garbled ones.
+        uint8_t rawByte = 0;
+
+        void clockFell(uint64_t now) {
+            this->clockFellAt = now;
+            this->dataAtFall = this->isDataHigh;
+            if (this->isHostSending && ++this->hostFalls == 12) {
+                this->isHostAcknowledged = !this->isDataHigh;
+            }
+        }
+
+        void clockRose(uint64_t now, bool wasDataHigh) {
+            if (this->isHostSending) {
+                if (this->hostRises < 11) {
+                    this->hostBits |= (uint16_t)(wasDataHigh ? 1 : 0) << this->hostRises;
+                }
+                if (++this->hostRises == 12) {
+                    this->finishHostByte();
+                }
+                return;
+            }
+
+            if (now - this->clockFellAt > maxKeyboardClockLowNanoseconds) {
+                // The host held the clock low.  It may have grabbed it straight after one of the
+                //  keyboard's falling edges (as Port does when it sends the next byte of a
+                //  command as soon as the last one is answered), in which case that edge
+                //  belongs to the keyboard, and it's on time.
+                uint32_t fellAtMicroseconds = (uint32_t)(this->clockFellAt / 1000);
+                if (this->bitCounter > 0
+                    && fellAtMicroseconds - this->lastReadInterruptMicroseconds <= this->clockPeriodMicroseconds + this->clockPeriodMicroseconds / 2) {
+                    this->keyboardEdge();
+                }
+
+                // Either way, it's the same as Port::sendByte or inhibit on the board:  whatever
+                //  the keyboard was sending is abandoned.
+                if (this->bitCounter > 0) {
+                    this->log.abortedByHost(this->bitCounter);
+                }
+                this->bitCounter = 0;
+                this->ioByte = 0;
+                this->receivedHasFramingError = false;
+                this->isErrorFrameOver = false;
+                if (!this->isDataHigh) {
+                    this->isHostSending = true;
+                    this->hostFalls = 0;
+                    this->hostRises = 0;
+                    this->hostBits = 0;
+                    this->isHostAcknowledged = false;
+                }
+                return;
+            }
+
+            this->keyboardEdge();
+        }
+
+        void keyboardEdge() {
+            uint8_t bit = this->bitCounter;
+            if (bit == 0) {
+                this->rawByte = 0;
+            }
+            else if (bit <= 8) {
+                this->rawByte = (uint8_t)((this->rawByte >> 1) | (this->dataAtFall ? 0x80 : 0));
+            }
+            this->log.nowNanoseconds = this->clockFellAt;
+            this->receiveBit(this->dataAtFall ? 1 : 0, (uint32_t)(this->clockFellAt / 1000));
+            if (this->bitCounter == 0) {
+                this->finishKeyboardByte();
+            }
+        }
+
+        // Does what readScanCode would, without asking the keyboard for anything.
+        void finishKeyboardByte() {
+            this->updateClockPeriod();
+            ps2::KeyboardOutput code;
+            while (this->inputBuffer.pop(code)) {
+            }
+            if (this->hasLostByte) {
+                this->hasLostByte = false;
+                this->log.lostByte();
+            }
+            if (this->receivedHasFramingError && this->isErrorFrameOver) {
+                // On the board, this is where readScanCode asks for the byte again.
+                this->receivedHasFramingError = false;
+                this->isErrorFrameOver = false;
+                this->log.garbledByte(this->rawByte);
+            }
+        }
+
+        void finishHostByte() {
+            this->isHostSending = false;
+            byte b = (byte)(this->hostBits >> 1);
+            uint8_t ones = 0;
+            for (uint16_t bits = (this->hostBits >> 1) & 0x1ff; bits != 0; bits >>= 1) {
+                ones += bits & 1;
+            }
+            bool isFramed = (this->hostBits & 1) == 0 && (ones & 1) == 1 && (this->hostBits & 0x400) != 0;
+            this->log.sentByte(b);
+            if (!isFramed || !this->isHostAcknowledged) {
+                this->log.sendFrameError();
+            }
+        }
+
+    public:
+        Decoder(EventLog &log) : Port(log), log(log) {
+            // As enableReadInterrupts does, minus the interrupt.
+            this->isReading = true;
+        }
+
+        /** \brief Gives the state of the lines from this time on.  Repeats are ignored. */
+        void sample(uint64_t nanoseconds, bool isClockHigh, bool isDataHigh) {
+            // If both change at once, the data line goes first:  the keyboard changes it while
+            //  the clock is high, and the host pulls it low before releasing the clock to send.
+            //  The exception is the keyboard's acknowledgement, which it gives just after it
+            //  reads the stop bit on a rising edge, so the bits of a host frame are read from
+            //  the line as it was before.
+            bool wasDataHigh = this->isDataHigh;
+            this->isDataHigh = isDataHigh;
+            if (isClockHigh != this->isClockHigh) {
+                this->log.nowNanoseconds = nanoseconds;
+                this->isClockHigh = isClockHigh;
+                if (isClockHigh) {
+                    this->clockRose(nanoseconds, wasDataHigh);
+                }
+                else {
+                    this->clockFell(nanoseconds);
+                }
+            }
+        }
+    };
+
+    // Case-insensitive match of a signal name (ignoring any scope or [index] on it) against
+    //  a wanted name.
+    inline bool isNamed(const std::string &name, const char *wanted) {
+        std::string base = name.substr(0, name.find('['));
+        size_t dot = base.find_last_of("./");
+        if (dot != std::string::npos) {
+            base = base.substr(dot + 1);
+        }
+        if (base.size() != strlen(wanted)) {
+            return false;
+        }
+        for (size_t i = 0; i < base.size(); ++i) {
+            if (tolower((unsigned char)base[i]) != tolower((unsigned char)wanted[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Picks the clock and data lines out of a list of names:  the ones asked for, or else ones
+    //  called clock/clk and data/dat, or else the first two, clock first.  Empty names are
+    //  never picked.
+    inline bool pickLines(const std::vector<std::string> &names, const char *clockName, const char *dataName, int &clock, int &data) {
+        clock = data = -1;
+        std::vector<int> candidates;
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i].empty()) {
+                continue;
+            }
+            candidates.push_back((int)i);
+            if (clockName != nullptr ? isNamed(names[i], clockName) : (isNamed(names[i], "clock") || isNamed(names[i], "clk"))) {
+                clock = (int)i;
+            }
+            else if (dataName != nullptr ? isNamed(names[i], dataName) : (isNamed(names[i], "data") || isNamed(names[i], "dat"))) {
+                data = (int)i;
+            }
+        }
+        if (clock < 0 && data < 0 && clockName == nullptr && dataName == nullptr && candidates.size() >= 2) {
+            clock = candidates[0];
+            data = candidates[1];
+        }
+        return clock >= 0 && data >= 0;
+    }
+
+    /** \brief Reads a VCD file into the decoder.  Returns false, with a message in error, if the
+     *         lines can't be found or the file can't be understood.
+     */
+    inline bool readVcd(std::istream &in, Decoder &decoder, const char *clockName, const char *dataName, std::string &error) {
+        double nanosecondsPerTick = 1;
+        std::vector<std::string> ids;
+        std::vector<std::string> names;
+        std::string token;
+
+        // The header:  the timescale and the variables, up to $enddefinitions.
+        while (in >> token && token != "$enddefinitions") {
+            if (token == "$timescale") {
+                std::string scale;
+                while (in >> token && token != "$end") {
+                    scale += token;
+                }
+                double amount = atof(scale.c_str());
+                size_t unit = scale.find_first_not_of("0123456789.");
+                std::string units = unit == std::string::npos ? "s" : scale.substr(unit);
+                static const char *unitNames[] = { "s", "ms", "us", "ns", "ps", "fs" };
+                static const double unitNanoseconds[] = { 1e9, 1e6, 1e3, 1, 1e-3, 1e-6 };
+                bool isKnown = false;
+                for (int i = 0; i < 6; ++i) {
+                    if (units == unitNames[i]) {
+                        nanosecondsPerTick = (amount > 0 ? amount : 1) * unitNanoseconds[i];
+                        isKnown = true;
+                    }
+                }
+                if (!isKnown) {
+                    error = "unknown timescale " + scale;
+                    return false;
+                }
+            }
+            else if (token == "$var") {
+                std::string type, size, id, name;
+                in >> type >> size >> id >> name;
+                ids.push_back(id);
+                names.push_back(name);
+                while (in >> token && token != "$end") {
+                }
+            }
+        }
+
+        int clock, data;
+        if (!pickLines(names, clockName, dataName, clock, data)) {
+            error = "can't find the clock and data lines";
+            return false;
+        }
+        const std::string &clockId = ids[clock];
+        const std::string &dataId = ids[data];
+
+        bool isClockHigh = true;
+        bool isDataHigh = true;
+        bool hasTime = false;
+        uint64_t time = 0;
+        while (in >> token) {
+            char first = token[0];
+            std::string id;
+            char value;
+            if (first == '#') {
+                if (hasTime) {
+                    decoder.sample(time, isClockHigh, isDataHigh);
+                }
+                time = (uint64_t)(strtoull(token.c_str() + 1, nullptr, 10) * nanosecondsPerTick);
+                hasTime = true;
+                continue;
+            }
+            else if (first == '0' || first == '1' || first == 'x' || first == 'X' || first == 'z' || first == 'Z') {
+                value = first;
+                id = token.substr(1);
+            }
+            else if (first == 'b' || first == 'B') {
+                // A vector; the line is its last bit.
+                value = token[token.size() - 1];
+                in >> id;
+            }
+            else {
+                // $dumpvars, $end, comments and the like.
+                continue;
+            }
+            // An undriven line floats high, thanks to the pull-ups.
+            bool isHigh = value != '0';
+            if (id == clockId) {
+                isClockHigh = isHigh;
+            }
+            else if (id == dataId) {
+                isDataHigh = isHigh;
+            }
+        }
+        decoder.sample(time, isClockHigh, isDataHigh);
+        return true;
+    }
+
+    /** \brief Reads a sigrok CSV file into the decoder.  samplerate, if not 0, overrides the
+     *         one in the file.  Returns false, with a message in error, if the lines can't be
+     *         found or there's no way to tell the time of each sample.
+     */
+    inline bool readSigrokCsv(std::istream &in, Decoder &decoder, const char *clockName, const char *dataName, double samplerate, std::string &error) {
+        std::string line;
+        std::vector<std::string> names;
+        int clock = -1, data = -1, timeColumn = -1;
+        uint64_t sampleNumber = 0;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line[line.size() - 1] == '\r') {
+                line.erase(line.size() - 1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+            if (line[0] == ';') {
+                size_t at = line.find("Samplerate:");
+                if (at != std::string::npos && samplerate == 0) {
+                    char *end;
+                    samplerate = strtod(line.c_str() + at + 11, &end);
+                    while (*end == ' ') {
+                        ++end;
+                    }
+                    samplerate *= *end == 'k' ? 1e3 : *end == 'M' ? 1e6 : *end == 'G' ? 1e9 : 1;
+                }
+                continue;
+            }
+
+            std::vector<std::string> fields;
+            for (size_t start = 0;;) {
+                size_t comma = line.find(',', start);
+                fields.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+                if (comma == std::string::npos) {
+                    break;
+                }
+                start = comma + 1;
+            }
+
+            if (names.empty() && !isdigit((unsigned char)fields[0][0]) && fields[0][0] != '.') {
+                // The header row.
+                names = fields;
+                for (size_t i = 0; i < names.size(); ++i) {
+                    if (isNamed(names[i], "time")) {
+                        timeColumn = (int)i;
+                        names[i].clear();
+                    }
+                }
+                if (!pickLines(names, clockName, dataName, clock, data)) {
+                    break;
+                }
+                if (timeColumn < 0 && samplerate <= 0) {
+                    error = "no samplerate in the file; give one with --samplerate";
+                    return false;
+                }
+                continue;
+            }
+            if (names.empty()) {
+                error = "no header row naming the channels";
+                return false;
+            }
+            if ((int)fields.size() <= clock || (int)fields.size() <= data) {
+                continue;
+            }
+
+            uint64_t time = timeColumn >= 0
+                ? (uint64_t)(strtod(fields[timeColumn].c_str(), nullptr) * 1e9 + 0.5)
+                : (uint64_t)(sampleNumber * 1e9 / samplerate + 0.5);
+            ++sampleNumber;
+            decoder.sample(time, fields[clock] != "0", fields[data] != "0");
+        }
+        if (clock < 0 || data < 0) {
+            error = "can't find the clock and data lines";
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+// Replays a capture made by CaptureDiagnostics through CaptureReplay as fast as it will go,
+//  and reports how many bytes and scan codes it gets through per second.
+//
+//      ReplayCapture [--repeat N] capture.ps2
+//
+//      --repeat N         replay it N times over (default 1), to time a small capture
+//
+//  The file is mapped rather than read, so what's timed is CaptureReplay's parsing rather
+//  than the disk.
+
+#include "Arduino.h"
+#include "ps2_CaptureReplay.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+
+// A mapped file, with the parts of the Stream interface that CaptureReplay uses.
+class MappedCapture {
+    const byte *bytes = nullptr;
+    size_t size = 0;
+    size_t readIndex = 0;
+
+public:
+    ~MappedCapture() {
+        if (this->bytes != nullptr) {
+            munmap((void *)this->bytes, this->size);
+        }
+    }
+
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            void *mapping = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                this->bytes = (const byte *)mapping;
+                this->size = (size_t)status.st_size;
+                madvise(mapping, this->size, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        return this->bytes != nullptr;
+    }
+
+    size_t length() const { return this->size; }
+    void rewind() { this->readIndex = 0; }
+
+    int available() { return (int)(this->size - this->readIndex); }
+    int read() { return this->readIndex < this->size ? this->bytes[this->readIndex++] : -1; }
+};
+
+int main(int argc, char *argv[]) {
+    const char *path = nullptr;
+    unsigned long repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (path == nullptr) {
+            path = argv[i];
+        }
+        else {
+            path = nullptr;
+            break;
+        }
+    }
+    if (path == nullptr || repeat == 0) {
+        fprintf(stderr, "usage: %s [--repeat N] capture.ps2\n", argv[0]);
+        return 2;
+    }
+
+    MappedCapture capture;
+    if (!capture.open(path)) {
+        fprintf(stderr, "can't map %s\n", path);
+        return 2;
+    }
+
+    unsigned long scanCodes = 0;
+    unsigned long garbled = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long pass = 0; pass < repeat; ++pass) {
+        capture.rewind();
+        ps2::CaptureReplay<MappedCapture> replay(capture, ps2::ReplaySpeed::maximum);
+        if (!replay.begin()) {
+            fprintf(stderr, "%s isn't a capture\n", path);
+            return 1;
+        }
+        // At maximum speed, none only comes back once the capture has run out.
+        for (ps2::KeyboardOutput code = replay.readScanCode(); code != ps2::KeyboardOutput::none; code = replay.readScanCode()) {
+            if (code == ps2::KeyboardOutput::garbled) {
+                ++garbled;
+            }
+            else {
+                ++scanCodes;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s: %zu bytes, %lu scan codes, %lu garbled\n", path, capture.length(), scanCodes / repeat, garbled / repeat);
+    if (seconds > 0) {
+        printf("%lu passes in %.3fs: %.0f bytes/s, %.0f events/s\n", repeat, seconds,
+            (double)capture.length() * repeat / seconds, (double)(scanCodes + garbled) / seconds);
+    }
+    return 0;
+}
@@ -18,6 +18,8 @@ USA
 */
 #pragma once
 
+#include "ps2_Platform.h"
+#include "ps2_NullDiagnostics.h"
 #include "ps2_KeyboardLeds.h"
 #include "ps2_KeyboardOutput.h"
 
@@ -41,6 +43,11 @@ namespace ps2 {
     public:
         AnsiTranslator();
         AnsiTranslator(Diagnostics &diagnostics);
+
+        /** \brief Forgets any partially-received multi-byte sequence.  Call this when
+         *         \ref Keyboard::readScanCode returns garbled, as a byte of the sequence
+         *         may have been lost.  The modifier keys and lock modes are kept.
+         */
         void reset();
 
         /** \brief Processes the given scan code from the keyboard.  It only gives you keydown
@@ -93,7 +100,7 @@ namespace ps2 {
         bool isShiftDown;
         bool isCapsLockMode;
         bool isNumLockMode;
-        int pauseKeySequenceIndex;
+        uint8_t pauseKeySequenceIndex;
         Diagnostics *diagnostics;
     };
 }
@@ -17,7 +17,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
 #pragma once
-#include <Arduino.h>
+#include "ps2_Platform.h"
 
 namespace ps2 {
     // For reference: http://www.computer-engineering.org/ps2keyboard/scancodes2.html
@@ -173,6 +173,7 @@ namespace ps2 {
     void AnsiTranslator<Diagnostics>::reset() {
         this->isSpecial = false;
         this->isUnmake = false;
+        this->pauseKeySequenceIndex = 0;
     }
 
     template<typename Diagnostics>
@@ -186,11 +187,13 @@ namespace ps2 {
 
         if (ps2Scan == KeyboardOutput::extend)
         {
+            // The Pause sequence never contains an extend, so if we were part-way through
+            //  matching it, that was garbage.
             this->isSpecial = true;
+            this->pauseKeySequenceIndex = 0;
             return '\0';
         }
 
-        byte usbCode = 0;
         if ((uint8_t)ps2Scan == pgm_read_byte(pauseKeySequence + this->pauseKeySequenceIndex)) {
             ++this->pauseKeySequenceIndex;
             if (this->pauseKeySequenceIndex < sizeof(pauseKeySequence))
@@ -210,6 +213,8 @@ namespace ps2 {
         case KeyboardOutput::sc2_leftCtrl: // sc2_exRightControl
             this->isCtrlDown = !this->isUnmake;
             break;
+        default:
+            break;
         }
 
         // We have a complete make or unmake sequence here, so we'll reset to be ready for the next key
@@ -231,6 +236,8 @@ namespace ps2 {
         case KeyboardOutput::sc2_capsLock:
             this->isCapsLockMode = !this->isCapsLockMode;
             return '\0';
+        default:
+            break;
         }
 
         char charTranslation = this->rawTranslate(ps2Scan);
@@ -327,7 +334,7 @@ namespace ps2 {
 
     template<typename Diagnostics>
     char AnsiTranslator<Diagnostics>::rawTranslate(KeyboardOutput ps2Scan) {
-        return ((uint8_t)ps2Scan >= 0x0d && ((uint8_t)ps2Scan - 0x0d) < sizeof(ps2ToAsciiMap))
+        return ((uint8_t)ps2Scan >= 0x0d && (uint8_t)ps2Scan < 0x0d + sizeof(ps2ToAsciiMap))
             ? (char)pgm_read_byte(ps2ToAsciiMap + (uint8_t)ps2Scan - 0x0d)
             : '\0';
     }
@@ -0,0 +1,172 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include "ps2_Platform.h"
+#include "ps2_SimpleDiagnostics.h"
+#include "ps2_DiagnosticsQueue.h"
+
+namespace ps2 {
+    /** \brief The kinds of record in a capture made by \ref CaptureDiagnostics. */
+    enum class CaptureRecordType : uint8_t {
+        receivedByte = 0, // data is the byte
+        sentByte = 1,     // data is the byte
+        framingError = 2, // data is the DiagnosticsCode of the error
+        recordsLost = 3,  // data is the number of records that were dropped (saturates at 255)
+        sendError = 4,    // the keyboard didn't acknowledge a frame sent to it; data is 0
+        clockLineGlitch = 5, // data is the number of bits that arrived before the clock stopped
+    };
+
+    /** \brief A recorder that captures the raw byte stream to a serial port or a file, so that
+     *         a session can be played back later with \ref CaptureReplay.
+     *
+     *  \details
+     *   The capture starts with the four bytes 'P' 'S' '2' 0x01 (the last being the format
+     *   version), followed by a record for each event:
+     *
+     *      <type> <microseconds since the previous record...> <data>
+     *
+     *   The type is a \ref CaptureRecordType.  The time is an unsigned number in 7-bit
+     *   groups, least significant first, with the high bit set on all but the last group;
+     *   bytes that arrive back-to-back take 2 bytes to encode, so a typical record is
+     *   4 bytes.  The first record's time is measured from the call to \ref begin.
+     *
+     *   Like \ref StreamingDiagnostics, records are queued as they happen (including from
+     *   the interrupt handlers) and \ref drain copies as much of the queue to the target as
+     *   it can take without blocking.  If the target can't keep up, records are dropped and
+     *   a recordsLost record is written as soon as there's room.  A keyboard produces at most
+     *   about 1,500 bytes per second, so a 115200 baud link will keep up comfortably.
+     *
+     *  \code
+     *   static ps2::CaptureDiagnostics<> diagnostics;
+     *   static ps2::Keyboard<4,2,16,ps2::CaptureDiagnostics<>> ps2Keyboard(diagnostics);
+     *
+     *   void setup() {
+     *     Serial.begin(115200);
+     *     diagnostics.begin();
+     *     ps2Keyboard.begin();
+     *   }
+     *
+     *   void loop() {
+     *     diagnostics.drain(Serial);
+     *     ...
+     *   }
+     *  \endcode
+     *
+     *  \tparam QueueSize  The number of bytes to hold between calls to drain.
+     */
+    template <uint16_t QueueSize = 64>
+    class CaptureDiagnostics
+    {
+        // The worst case: a type, a 32-bit time (5 groups) and a data byte.
+        static const uint8_t maxRecordSize = 7;
+
+        DiagnosticsQueue<QueueSize> queue;
+        uint8_t recordsLost = 0;
+        uint32_t lastRecordMicros = 0;
+
+        static_assert(QueueSize >= 2 * maxRecordSize, "The queue must be able to hold at least two records");
+
+        void enqueueRecord(CaptureRecordType type, uint32_t elapsedMicros, byte data) {
+            this->queue.push((byte)type);
+            while (elapsedMicros > 0x7f) {
+                this->queue.push(0x80 | (elapsedMicros & 0x7f));
+                elapsedMicros >>= 7;
+            }
+            this->queue.push((byte)elapsedMicros);
+            this->queue.push(data);
+        }
+
+        void record(CaptureRecordType type, byte data) {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                uint32_t now = micros();
+                if (this->recordsLost != 0) {
+                    if (this->queue.room() < 2 * maxRecordSize) {
+                        if (this->recordsLost != 0xff) {
+                            ++this->recordsLost;
+                        }
+                        return;
+                    }
+                    this->enqueueRecord(CaptureRecordType::recordsLost, now - this->lastRecordMicros, this->recordsLost);
+                    this->lastRecordMicros = now;
+                    this->recordsLost = 0;
+                }
+
+                if (this->queue.room() < maxRecordSize) {
+                    this->recordsLost = 1;
+                    return;
+                }
+                this->enqueueRecord(type, now - this->lastRecordMicros, data);
+                this->lastRecordMicros = now;
+            }
+        }
+
+        void framingError(DiagnosticsCode code) {
+            this->record(CaptureRecordType::framingError, (byte)code);
+        }
+
+    public:
+        /** \brief Discards anything that hasn't been sent yet and starts a new capture.
+         *  \details Call this from setup(), before the keyboard starts generating events, and
+         *           again whenever the target is reopened (e.g. a new file is started).
+         */
+        void begin() {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                this->queue.clear();
+                this->recordsLost = 0;
+                this->queue.push('P');
+                this->queue.push('S');
+                this->queue.push('2');
+                this->queue.push(0x01);
+                this->lastRecordMicros = micros();
+            }
+        }
+
+        /** \brief Sends as much of the queued data as the target can take without blocking.
+         *  \details Call this from loop().  The target must implement availableForWrite, as
+         *           HardwareSerial and the USB Serial class do.
+         */
+        template <typename Target>
+        void drain(Target &target) {
+            this->queue.drain(target);
+        }
+
+        void packetDidNotStartWithZero() { this->framingError(DiagnosticsCode::packetDidNotStartWithZero); }
+        void parityError() { this->framingError(DiagnosticsCode::parityError); }
+        void packetDidNotEndWithOne() { this->framingError(DiagnosticsCode::packetDidNotEndWithOne); }
+        void packetIncomplete() { this->framingError(DiagnosticsCode::packetIncomplete); }
+        void sendFrameError() { this->record(CaptureRecordType::sendError, 0); }
+        void clockLineGlitch(uint8_t numBitsSent) { this->record(CaptureRecordType::clockLineGlitch, numBitsSent); }
+        void sentByte(byte b) { this->record(CaptureRecordType::sentByte, b); }
+        void receivedByte(byte b) { this->record(CaptureRecordType::receivedByte, b); }
+
+        void bufferOverflow() {}
+        void startupFailure() {}
+        void incorrectResponse(KeyboardOutput scanCode, KeyboardOutput expectedScanCode) {}
+        void noResponse(KeyboardOutput expectedScanCode) {}
+        void noTranslationForKey(bool isExtended, KeyboardOutput code) {}
+        void dequeuedByte(byte b) {}
+        void sendRetried(byte b, uint8_t retryNumber) {}
+
+        void readInterruptStarted() {}
+        void readInterruptCompleted() {}
+        void writeInterruptStarted() {}
+        void writeInterruptCompleted() {}
+        void bufferDepth(uint8_t numBytesQueued) {}
+    };
+}
@@ -0,0 +1,190 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include "ps2_Platform.h"
+#include "ps2_CaptureDiagnostics.h"
+
+namespace ps2 {
+    /** \brief How fast \ref CaptureReplay plays a capture back. */
+    enum class ReplaySpeed : uint8_t {
+        original, // Each byte becomes available when it did in the original session.
+        maximum,  // Bytes are available as soon as they're read from the source.
+    };
+
+    /** \brief Plays back a capture made by \ref CaptureDiagnostics.
+     *
+     *  \details
+     *   This has the same \ref readScanCode method as \ref Keyboard, so code that consumes
+     *   scan codes (translators, your own loop() logic) can be fed a recorded session
+     *   instead of a live keyboard - to reproduce a problem reported from the field, or to
+     *   time your code against a real typing pattern.  The source can be anything with
+     *   Stream-style available() and read() methods, e.g. an SD card File or Serial.
+     *
+     *   It returns what \ref Keyboard::readScanCode would have: bytes the keyboard sent are
+     *   returned as-is, framing errors and gaps in the capture come back as garbled, and
+     *   the bytes Keyboard consumes itself (acks, resends, echoes and the startup codes)
+     *   are skipped.  The garbled comes back where the error happened; Keyboard can only
+     *   report a frame whose clock edges went missing after the bytes that were already
+     *   waiting, so it may return it a byte or two later.
+     *
+     *   Responses to readId and getScanCodeSet aren't recognized, so they're returned like
+     *   any other byte.  Bytes sent to the keyboard are skipped.
+     *
+     *  \code
+     *   File capture = SD.open("session.ps2");
+     *   ps2::CaptureReplay<File> replay(capture);
+     *   ps2::UsbTranslator<> keyMapping;
+     *
+     *   void setup() {
+     *     replay.begin();
+     *   }
+     *
+     *   void loop() {
+     *     ps2::KeyboardOutput scanCode = replay.readScanCode();
+     *     ...
+     *   }
+     *  \endcode
+     *
+     *  \tparam Source  The type of the stream the capture is read from.
+     */
+    template <typename Source>
+    class CaptureReplay
+    {
+        enum class ParseState : uint8_t {
+            type,
+            elapsedTime,
+            data,
+            complete,
+        };
+
+        Source *source;
+        ReplaySpeed speed;
+        ParseState state = ParseState::type;
+        CaptureRecordType recordType;
+        uint32_t recordElapsedMicros;
+        uint8_t elapsedMicrosShift;
+        byte recordData;
+        uint32_t lastRecordMicros = 0;
+        bool isGarbled = false;
+
+        // Reads as much of the next record as is available.  Returns true if it's complete.
+        bool readRecord() {
+            while (this->state != ParseState::complete) {
+                int b = this->source->read();
+                if (b < 0) {
+                    return false;
+                }
+
+                switch (this->state) {
+                case ParseState::type:
+                    this->recordType = (CaptureRecordType)b;
+                    this->recordElapsedMicros = 0;
+                    this->elapsedMicrosShift = 0;
+                    this->state = ParseState::elapsedTime;
+                    break;
+                case ParseState::elapsedTime:
+                    if (this->elapsedMicrosShift < 32) {
+                        this->recordElapsedMicros |= (uint32_t)(b & 0x7f) << this->elapsedMicrosShift;
+                        this->elapsedMicrosShift += 7;
+                    }
+                    if ((b & 0x80) == 0) {
+                        this->state = ParseState::data;
+                    }
+                    break;
+                case ParseState::data:
+                    this->recordData = (byte)b;
+                    this->state = ParseState::complete;
+                    break;
+                case ParseState::complete:
+                    break;
+                }
+            }
+            return true;
+        }
+
+        static bool isConsumedByKeyboard(KeyboardOutput code) {
+            return code == KeyboardOutput::ack
+                || code == KeyboardOutput::nack
+                || code == KeyboardOutput::echo
+                || code == KeyboardOutput::batSuccessful
+                || code == KeyboardOutput::batFailure;
+        }
+
+    public:
+        CaptureReplay(Source &source, ReplaySpeed speed = ReplaySpeed::original)
+            : source(&source), speed(speed) {}
+
+        /** \brief Reads the capture's header and starts the clock.
+         *  \returns True if the source starts with a capture this class understands.
+         */
+        bool begin() {
+            static const byte header[] = { 'P', 'S', '2', 0x01 };
+            for (uint8_t i = 0; i < sizeof(header); ++i) {
+                if (this->source->read() != header[i]) {
+                    return false;
+                }
+            }
+            this->state = ParseState::type;
+            this->lastRecordMicros = micros();
+            return true;
+        }
+
+        /** \brief Returns the next code from the capture, or none if there isn't one yet.
+         *  \details See \ref Keyboard::readScanCode.
+         */
+        KeyboardOutput readScanCode() {
+            while (this->readRecord()) {
+                if (this->speed == ReplaySpeed::original) {
+                    if (micros() - this->lastRecordMicros < this->recordElapsedMicros) {
+                        return KeyboardOutput::none;
+                    }
+                    // Advancing by the recorded time rather than setting it to now keeps the
+                    //  replay from drifting when the caller is slow to poll.
+                    this->lastRecordMicros += this->recordElapsedMicros;
+                }
+                this->state = ParseState::type;
+
+                switch (this->recordType) {
+                case CaptureRecordType::receivedByte:
+                    this->isGarbled = false;
+                    if (!isConsumedByKeyboard((KeyboardOutput)this->recordData)) {
+                        return (KeyboardOutput)this->recordData;
+                    }
+                    break;
+                case CaptureRecordType::framingError:
+                case CaptureRecordType::recordsLost:
+                    // A single failure usually produces several records (e.g. the error and
+                    //  then the recovery), but the keyboard only returns garbled once for it.
+                    if (!this->isGarbled) {
+                        this->isGarbled = true;
+                        return KeyboardOutput::garbled;
+                    }
+                    break;
+                case CaptureRecordType::sentByte:
+                case CaptureRecordType::sendError:
+                case CaptureRecordType::clockLineGlitch:
+                    // Sending is Keyboard's business, and a glitch is only ever recorded after
+                    //  the framing error that returned garbled already.
+                    break;
+                }
+            }
+            return KeyboardOutput::none;
+        }
+    };
+}
@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include <stdint.h>
+#include "ps2_ScanCodeSet.h"
+
+namespace ps2 {
+    /** \brief What \ref Keyboard::enableProbing found out about the keyboard.
+     *
+     *  \details
+     *   It's plain data, three bytes, so if probing on every startup is more than you need,
+     *   you can keep it in EEPROM (e.g. with EEPROM.put) and hand it back to
+     *   \ref Keyboard::setDeviceProfile.
+     *
+     *   The translators in this library all read scan code set 2, which every keyboard has.
+     *   If the keyboard also has set 3, you can have it send breaks and repeats only for the
+     *   keys you care about; if your program has a set-3 keymap, this is how it knows whether
+     *   to use it:
+     *
+     *  \code
+     *   if (ps2Keyboard.getDeviceProfile().hasPerKeyBreakAndTypematic()) {
+     *     ps2Keyboard.queueScanCodeSet(ps2::ScanCodeSet::ps2);
+     *     ... use the set-3 keymap
+     *   }
+     *   else {
+     *     ... use a translator
+     *   }
+     *  \endcode
+     */
+    struct DeviceProfile {
+        /** \brief The keyboard's ID (see \ref Keyboard::readId).  Keyboards too old to have
+         *         one answer 0; 0xffff means the keyboard hasn't been probed.
+         */
+        uint16_t id;
+
+        /** \brief A bit, (1 << set), for each scan code set the keyboard was seen to accept. */
+        uint8_t scanCodeSets;
+
+        /** \brief Returns true if the keyboard has been probed. */
+        bool isValid() const {
+            return this->scanCodeSets != 0;
+        }
+
+        /** \brief Returns true if the keyboard accepted the given scan code set. */
+        bool supportsScanCodeSet(ScanCodeSet scanCodeSet) const {
+            return (this->scanCodeSets & (1 << (uint8_t)scanCodeSet)) != 0;
+        }
+
+        /** \brief Returns true if breaks and repeats can be turned off key by key (or for all
+         *         keys at once).  Keyboards only honor those commands in scan code set 3.
+         */
+        bool hasPerKeyBreakAndTypematic() const {
+            return this->supportsScanCodeSet(ScanCodeSet::ps2);
+        }
+    };
+}
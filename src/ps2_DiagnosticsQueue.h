@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include "ps2_Platform.h"
+
+namespace ps2 {
+    /** @private
+     *  The queue of encoded bytes behind \ref StreamingDiagnostics and \ref CaptureDiagnostics.
+     *  Bytes go in from anywhere, including the interrupt handlers, and drain sends as many of
+     *  them as the target has room for.  push, room and clear must be called with interrupts
+     *  off; drain takes care of that itself.
+     */
+    template <uint16_t Size>
+    class DiagnosticsQueue {
+        byte queue[Size];
+        uint16_t head = 0;
+        uint16_t numBytesQueued = 0;
+
+    public:
+        uint16_t room() const {
+            return Size - this->numBytesQueued;
+        }
+
+        void push(byte b) {
+            uint16_t i = this->head + this->numBytesQueued;
+            if (i >= Size) {
+                i -= Size;
+            }
+            this->queue[i] = b;
+            ++this->numBytesQueued;
+        }
+
+        void clear() {
+            this->head = 0;
+            this->numBytesQueued = 0;
+        }
+
+        // Sends as much of the queue as the target can take without blocking.  The target
+        //  must implement availableForWrite, as HardwareSerial and the USB Serial class do.
+        template <typename Target>
+        void drain(Target &target) {
+            int room = target.availableForWrite();
+            while (room > 0) {
+                byte b;
+                ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                    if (this->numBytesQueued == 0) {
+                        return;
+                    }
+                    b = this->queue[this->head];
+                    this->head = (this->head == Size - 1) ? 0 : this->head + 1;
+                    --this->numBytesQueued;
+                }
+                target.write(b);
+                --room;
+            }
+        }
+    };
+}
@@ -0,0 +1,239 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include <stdint.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "ps2_SimpleDiagnostics.h"
+
+namespace ps2 {
+    /** \brief A \ref SimpleDiagnostics that also saves a snapshot of each error to EEPROM, so
+     *         that the evidence survives the unit being power-cycled.
+     *
+     *  \details
+     *   Only errors are saved - each record holds the error bit-field and the events leading up
+     *   to the error (the same data that appears before the '|' in \ref SimpleDiagnostics::sendReport),
+     *   along with a sequence number and a CRC.  The records go into NumSlots slots, used
+     *   round-robin, so every slot sees the same number of writes.  As a sizing guide, with the
+     *   default 8 slots, 100,000 errors would put 12,500 writes on each EEPROM cell, well inside
+     *   the 100,000-cycle endurance of the AVR's EEPROM.  (In practice it's fewer, since errors
+     *   that happen while a record is being written are folded into the next one.)
+     *
+     *   Nothing is written to EEPROM from the interrupt handlers.  Instead, call \ref flush from
+     *   loop().  It writes at most one byte per call when the EEPROM is busy, so the stall is a
+     *   few microseconds rather than the 3.4ms it takes to program a byte.  A record is
+     *   LastErrorSize + 8 bytes, so it takes about that many trips through loop() to save one.
+     *
+     *  \code
+     *   typedef ps2::EepromDiagnostics<60, 30, 0, 8> Diagnostics;
+     *   static Diagnostics diagnostics;
+     *   static ps2::Keyboard<4,2,16,Diagnostics> ps2Keyboard(diagnostics);
+     *
+     *   void setup() {
+     *     diagnostics.begin();
+     *     ps2Keyboard.begin();
+     *   }
+     *
+     *   void loop() {
+     *     diagnostics.flush();
+     *     if ( <magic-user-gesture> ) {
+     *       diagnostics.sendReport(Serial); // Stored errors first, then the live data.
+     *       diagnostics.reset();
+     *       diagnostics.clearStoredReports();
+     *     }
+     *   }
+     *  \endcode
+     *
+     *  \tparam Size  The number of bytes to use for recording events in RAM.
+     *  \tparam LastErrorSize  The number of bytes of history to keep (and save) with each error.
+     *  \tparam EepromAddress  The first byte of EEPROM to use.
+     *  \tparam NumSlots  The number of records to keep.  The total amount of EEPROM used
+     *                    is NumSlots * (LastErrorSize + 8).
+     *  \tparam RecordedEvents  See \ref SimpleDiagnostics.
+     */
+    template <uint16_t Size = 60, uint16_t LastErrorSize = 30, uint16_t EepromAddress = 0, uint8_t NumSlots = 8,
+              uint64_t RecordedEvents = DiagnosticsEvents::all>
+    class EepromDiagnostics
+        : public SimpleDiagnostics<Size, LastErrorSize, RecordedEvents>
+    {
+        typedef SimpleDiagnostics<Size, LastErrorSize, RecordedEvents> base;
+
+        static_assert(LastErrorSize < 248, "The records are limited to 255 bytes");
+
+        // Record layout:  sequence (2 bytes), error serial number (2), failure codes (2),
+        //  number of history bytes (1), history (LastErrorSize), CRC of all of the above (1).
+        //  The CRC is written last, so a record that was interrupted by a power failure
+        //  will fail the check.  It starts from crcSeed rather than 0, else a slot of all
+        //  zeros would pass; 0xa5 also fails an erased (all 0xff) slot of any size.
+        static const uint8_t headerSize = 7;
+        static const uint8_t crcSeed = 0xa5;
+        static const uint8_t recordSize = headerSize + LastErrorSize + 1;
+
+        byte record[recordSize];
+        uint8_t bytesWritten = recordSize; // == recordSize when there's nothing to write
+        uint8_t nextSlot = 0;
+        uint16_t nextSequence = 0;
+        uint16_t errorSerialNumberSaved = 0;
+        uint8_t slotsToErase = 0;
+
+        static uint8_t *slotAddress(uint8_t slot) {
+            return (uint8_t *)(uintptr_t)(EepromAddress + (uint16_t)slot * recordSize);
+        }
+
+        static bool isValid(uint8_t slot) {
+            uint8_t *address = slotAddress(slot);
+            uint8_t crc = crcSeed;
+            for (uint8_t i = 0; i < recordSize - 1; ++i) {
+                crc = _crc_ibutton_update(crc, eeprom_read_byte(address + i));
+            }
+            return crc == eeprom_read_byte(address + recordSize - 1);
+        }
+
+        static uint16_t readSequence(uint8_t slot) {
+            return eeprom_read_word((const uint16_t *)slotAddress(slot));
+        }
+
+        void stageRecord(uint16_t errorSerialNumber) {
+            uint16_t failureCodes;
+            uint16_t numBytes = this->copyLastError(this->record + headerSize, failureCodes);
+            for (uint16_t i = numBytes; i < LastErrorSize; ++i) {
+                this->record[headerSize + i] = 0;
+            }
+            this->record[0] = this->nextSequence & 0xff;
+            this->record[1] = this->nextSequence >> 8;
+            this->record[2] = errorSerialNumber & 0xff;
+            this->record[3] = errorSerialNumber >> 8;
+            this->record[4] = failureCodes & 0xff;
+            this->record[5] = failureCodes >> 8;
+            this->record[6] = (uint8_t)numBytes;
+
+            uint8_t crc = crcSeed;
+            for (uint8_t i = 0; i < recordSize - 1; ++i) {
+                crc = _crc_ibutton_update(crc, this->record[i]);
+            }
+            this->record[recordSize - 1] = crc;
+            this->bytesWritten = 0;
+        }
+
+        template <typename Target>
+        static void sendStoredRecord(Target &printTo, uint8_t slot) {
+            uint8_t *address = slotAddress(slot);
+            printTo.print("[");
+            printTo.print(readSequence(slot), 16);
+            printTo.print("]{");
+            printTo.print(eeprom_read_word((const uint16_t *)(address + 4)), 16);
+            printTo.print(":");
+            uint8_t numBytes = eeprom_read_byte(address + 6);
+            for (int i = numBytes - 1; i >= 0; --i) {
+                byte b = eeprom_read_byte(address + headerSize + i);
+                printTo.print(b >> 4, 16);
+                printTo.print(b & 0xf, 16);
+            }
+            printTo.print("|}");
+        }
+
+    public:
+        /** \brief Finds the most recent record in EEPROM so that new ones go after it.
+         *  \details Call this from setup(), before the keyboard starts generating events.
+         */
+        void begin() {
+            bool foundAny = false;
+            uint16_t newestSequence = 0;
+            for (uint8_t slot = 0; slot < NumSlots; ++slot) {
+                if (isValid(slot)) {
+                    uint16_t sequence = readSequence(slot);
+                    if (!foundAny || (int16_t)(sequence - newestSequence) > 0) {
+                        newestSequence = sequence;
+                        this->nextSlot = (slot == NumSlots - 1) ? 0 : slot + 1;
+                        foundAny = true;
+                    }
+                }
+            }
+            this->nextSequence = foundAny ? newestSequence + 1 : 0;
+            this->errorSerialNumberSaved = this->getErrorSerialNumber();
+        }
+
+        /** \brief Does a little bit of the work of saving errors to EEPROM.  Call it from loop().
+         *  \returns True if there's nothing left to write.
+         */
+        bool flush() {
+            if (this->bytesWritten == recordSize) {
+                if (this->slotsToErase > 0) {
+                    if (!eeprom_is_ready()) {
+                        return false;
+                    }
+                    --this->slotsToErase;
+                    if (isValid(this->slotsToErase)) {
+                        // Flipping the bits in the CRC is enough to make the record invalid.
+                        uint8_t *crcAddress = slotAddress(this->slotsToErase) + recordSize - 1;
+                        eeprom_write_byte(crcAddress, eeprom_read_byte(crcAddress) ^ 0xff);
+                    }
+                    return false;
+                }
+
+                uint16_t errorSerialNumber = this->getErrorSerialNumber();
+                if (errorSerialNumber == this->errorSerialNumberSaved) {
+                    return true;
+                }
+                this->stageRecord(errorSerialNumber);
+                this->errorSerialNumberSaved = errorSerialNumber;
+            }
+
+            // eeprom_update_byte only programs the cell if the value changes; when it does, the
+            //  EEPROM will be busy for the next 3.4ms, so this usually writes one byte per call.
+            uint8_t *address = slotAddress(this->nextSlot);
+            while (this->bytesWritten < recordSize && eeprom_is_ready()) {
+                eeprom_update_byte(address + this->bytesWritten, this->record[this->bytesWritten]);
+                ++this->bytesWritten;
+            }
+
+            if (this->bytesWritten < recordSize) {
+                return false;
+            }
+            this->nextSlot = (this->nextSlot == NumSlots - 1) ? 0 : this->nextSlot + 1;
+            ++this->nextSequence;
+            return true;
+        }
+
+        /** \brief Invalidates all the records stored in EEPROM.  The work is done by \ref flush. */
+        void clearStoredReports() {
+            this->slotsToErase = NumSlots;
+        }
+
+        /** \brief Dumps the stored errors, oldest first, followed by the live data.
+         *  \details
+         *   Each stored error is printed as '[sequence]{failure-codes:history|}' - that is,
+         *   in the same format as \ref SimpleDiagnostics::sendReport, with no event data.
+         *   The live data follows in the usual format.
+         */
+        template <typename Target>
+        void sendReport(Target &printTo) {
+            for (uint8_t i = 0; i < NumSlots; ++i) {
+                uint8_t slot = this->nextSlot + i;
+                if (slot >= NumSlots) {
+                    slot -= NumSlots;
+                }
+                if (isValid(slot)) {
+                    sendStoredRecord(printTo, slot);
+                }
+            }
+            base::sendReport(printTo);
+        }
+    };
+}
@@ -18,21 +18,16 @@ USA
 */
 #pragma once
 
-#if defined(ARDUINO) && ARDUINO >= 100
-#include "Arduino.h" // for attachInterrupt, FALLING, HIGH & LOW
-#else
-#include "WProgram.h"
-#endif
-#include <stdint.h>
-#include <util/atomic.h>
+#include "ps2_Platform.h"
 #include "ps2_NullDiagnostics.h"
+#include "ps2_OptionalDiagnostics.h"
 #include "ps2_KeyboardLeds.h"
 #include "ps2_KeyboardOutput.h"
 #include "ps2_TypematicRate.h"
 #include "ps2_TypematicStartDelay.h"
 #include "ps2_ScanCodeSet.h"
-#include "ps2_Parity.h"
-#include "ps2_KeyboardOutputBuffer.h"
+#include "ps2_DeviceProfile.h"
+#include "ps2_Port.h"
 
 namespace ps2 {
 
@@ -58,6 +53,8 @@ namespace ps2 {
      *                    then 1 is enough.  Expect each keystroke to eat about 4 bytes, so 16
      *                    can hold up to 4 keystrokes.  There's nothing wrong with larger numbers,
      *                    but you probably want some amount of responsiveness to user commands.
+     *                    See \ref BufferSizing for more precise numbers.  It must be
+     *                    between 1 and 255.
      * \tparam Diagnostics A class that will record any unpleasantness that befalls your program
      *                     such as the aforementioned buffer overflows.  This is purely a debugging
      *                     aid.  If you don't need to be doing any debugging, you can stick wit the
@@ -65,7 +62,8 @@ namespace ps2 {
      *                     event handlers.  The C++ compiler will optimize empty implementations
      *                     completely away, so you pay no penalty for having this debug code in your
      *                     project if you don't use it.  The \ref SimpleDiagnostics implementation
-     *                     provides an implementation that records all the events.
+     *                     provides an implementation that records all the events, and
+     *                     \ref PerfDiagnostics keeps counters and interrupt timings instead.
      *
      * \details
      *  A great source of information about the PS2 keyboard can be found here: http://www.computer-engineering.org/ps2keyboard/.
@@ -104,11 +102,85 @@ namespace ps2 {
      *  With all things Arduino, you should understand the performance.  \ref readScanCode takes
      *  only a few machine instructions to complete.  The methods that push data to the keyboard
      *  take longer (on the order of milliseconds) because of the handshake between the two
-     *  devices and the throttling of sending one bit at a time at 10KHz.
+     *  devices and the throttling of sending one bit at a time at 10KHz.  Before each byte
+     *  they send, they also wait for any byte the keyboard is partway through sending, which
+     *  is up to 2ms more per byte if the keyboard is busy.  The queue methods, like
+     *  \ref queueLedStatus, never wait:  \ref readScanCode sends their bytes when the line
+     *  is free.
      *
      *  All of the keyboard setup methods return a bool that reports success or not; you can
      *  test them if you feel it necessary, but few applications will really need to.
      *
+     *  \section HotPlug Unplugging and Replugging
+     *
+     *  A keyboard that's unplugged and plugged back in (or that browns out) comes back with
+     *  its defaults:  LEDs off, scan code set 2, default typematic and all keys sending
+     *  breaks.  This class remembers what the setup methods asked for, and when the keyboard
+     *  announces that it has restarted (by sending batSuccessful), \ref readScanCode sends it
+     *  all again.  It does that a byte at a time, without waiting for the keyboard, so
+     *  loop() doesn't stall.  If you call \ref echo periodically to check that the keyboard
+     *  is there, a failed echo starts the same process, in case the keyboard's startup
+     *  message was lost.  Call \ref isRestoringConfiguration to find out if it's done.
+     *  If \ref enableProbing was called, the keyboard is probed before any of that.
+     *
+     *  \section BufferSizing Sizing the Buffer
+     *
+     *  Each call to \ref readScanCode takes one byte out of the buffer, and keyboards send bytes
+     *  in bursts, up to one every 0.7ms.  The smallest BufferSize that loses nothing depends on
+     *  how often you call readScanCode and on what the user types:
+     *
+     *      Interval between calls:                        1ms   2ms   5ms  10ms  20ms
+     *      Pause key (8 bytes)                              4     6     7     8     8
+     *      Print Screen (4 bytes down, 6 up)                3     5     6     6     6
+     *      6 keys rolled down together, then up             5     9    11    12    13
+     *      An extended key held down (30 repeats/sec)       2     2     2     2     -
+     *
+     *  These numbers come from a simulated keyboard at the fastest clock the protocol allows
+     *  (extras/sim/BufferSizing.cpp, with the keys let go 100ms after they went down); at
+     *  10KHz they are the same or lower.  The last row is the one to watch: an extended key sends
+     *  two bytes per repeat, so if you can't call readScanCode more often than every 16ms,
+     *  no buffer is big enough - it will overflow eventually however large it is.  If your
+     *  loop is slow, drain the buffer in a loop (call readScanCode until it returns none)
+     *  rather than reading one byte per pass.
+     *
+     *  If loop() stalls now and then, \ref enableBackpressure makes the keyboard hold on to
+     *  its bytes while the buffer is full, rather than have them overwrite older ones.
+     *
+     *  \section Dispatching Dispatching Instead of Polling
+     *
+     *  Calling \ref readScanCode as often as the table above asks keeps the processor busy
+     *  even when nobody's typing.  \ref dispatch is the alternative: it drains the buffer
+     *  into a handler of your choosing, and when nothing has arrived, it costs a single
+     *  test of a flag the interrupt handler sets.  Since the keyboard's clock interrupt
+     *  wakes the processor, loop() can sleep whenever \ref isIdle says so:
+     *
+     * \code
+     * #include <avr/sleep.h>
+     *
+     * void loop() {
+     *   ps2Keyboard.dispatch([](ps2::KeyboardOutput scanCode) {
+     *     respondTo(scanCode);
+     *   });
+     *   doOtherWork();
+     *   if (ps2Keyboard.isIdle()) {
+     *     set_sleep_mode(SLEEP_MODE_IDLE);
+     *     sleep_mode();
+     *   }
+     * }
+     * \endcode
+     *
+     *  If a byte starts to arrive between isIdle and sleep_mode, it's picked up when the next
+     *  interrupt wakes the processor - at most a millisecond later, as the Arduino core's
+     *  timer interrupt fires that often.  The buffer has to hold what arrives in that time
+     *  plus however long doOtherWork takes, just as for readScanCode.  isIdle is true while
+     *  a byte is only partway in, since each of its clock edges wakes the processor; if the
+     *  keyboard gives up partway, the timer's next tick is what gets it noticed.
+     *
+     *  extras/tests/DispatchTest counts what such a loop() wakes for:  the timer's 1000 ticks
+     *  a second when idle, plus 11 clock edges per byte while typing, with one pass per byte
+     *  doing any work.  The avr-bench target times each of those, so the time spent awake
+     *  on a given board is the sum of the counts times the cycles.
+     *
      *  The biggest source of legitimate error is long-running interrupts which cause
      *  the PS2 clock interrupt to be skipped.  The response to the clock pin must be swift
      *  and consistent, else you'll get garbled messages.  The protocol is just robust
@@ -116,25 +188,23 @@ namespace ps2 {
      *  If you're going to have another interrupt source in your project, see to it that
      *  its interrupt handler is as quick as possible.  For its part, the PS2 handler is
      *  just a few instructions in all cases.
+     *
+     *  To put a number on "as quick as possible":  the keyboard changes the data line
+     *  while the clock is high, so the data pin has to be read before the clock's low half
+     *  is over.  Modeling the keyboard as holding each bit 5us into the high half, the
+     *  longest the clock interrupt can be held off is (extras/sim/InterruptLatency.cpp):
+     *
+     *      Keyboard clock:        10KHz   12KHz   14KHz   16.7KHz
+     *      Maximum delay:          54us    45us    39us    34us
+     *
+     *  Plan for the fastest clock.  The delay includes the time the Arduino core spends
+     *  getting into the handler (a few microseconds), so no other interrupt handler (or
+     *  block of code with interrupts turned off) should run for more than about 25us.
+     *  Going past the limit garbles the byte; holding the interrupt off for a whole clock
+     *  period loses an edge, which is recovered as described in \ref readScanCode.
      */
     template<int DataPin, int ClockPin, int BufferSize = 16, typename Diagnostics = NullDiagnostics>
-    class Keyboard {
-        static const uint8_t immediateResponseTimeInMilliseconds = 10;
-
-        Diagnostics *diagnostics;
-
-        // These are not marked as volatile because they are only modified in the interrupt
-        // handler and at startup (before the interrupt handler is enabled).
-        uint8_t ioByte = 0;
-        uint8_t bitCounter = 0;
-        uint32_t failureTimeMicroseconds = 0;
-        uint32_t lastReadInterruptMicroseconds = 0;
-        Parity parity = Parity::even;
-        bool receivedHasFramingError = false;
-
-        // This guy is marked volatile because it's exchanged between the interrupt handler and normal code.
-        KeyboardOutputBuffer<BufferSize, Diagnostics> inputBuffer;
-
+    class Keyboard : public Port<DataPin, ClockPin, BufferSize, Diagnostics> {
         // Commands sent from the host to the ps2 keyboard.  Private to this class because
         //  the point of the class is to encapsulate the protocol.
         enum class ps2CommandCode : uint8_t {
@@ -157,291 +227,497 @@ namespace ps2 {
             setLeds = 0xed,
         };
 
-        void readInterruptHandler() {
-            // The timing of the PS2 keyboard is such that you really need to read the data
-            // line just as fast as possible.  If you do it with digitalRead, it'll work right
-            // almost all the time (like one character in 100 will suffer a failure - with the
-            // keyboards I have to-hand.)
-            //
-            // Although this looks fantastically more complicated than plain digitalRead, the
-            // instruction count is lower.  It'd be even lower if the methods listed here were
-            // implemented a little better (e.g. as template methods rather than macros).
-            uint8_t dataPinValue = (*portInputRegister(digitalPinToPort(DataPin)) & digitalPinToBitMask(DataPin)) ? 1 : 0; // ==digitalRead(DataPin);
-
-            lastReadInterruptMicroseconds = micros();
-            // TODO: Perhaps there should be code here that detects if bitCounter > 0 && the time since
-            //  the last read interrupt is > a millisecond and, if so, log that and reset
-            //  bitCounter.
-            //
-            //  It doesn't really need doing principally because the error-recovery code is already
-            //  going to catch this (even if it doesn't do it very well).  If you have other interrupts
-            //  in your system and they happen with concurrently with the keyboard, I think it's unlikely
-            //  you'll ever be able to craft a foolproof system.  That since the "Ack" request only
-            //  gets the previous byte.  What we'd really need to recover would be something that asks
-            //  the keyboard for all keys currently pressed, and there's no such thing.
-            //
-            //  But perhaps I'm wrong and it's not as bad as all that.
-
-            switch (bitCounter)
-            {
-            case 0:
-                if (dataPinValue == 0) {
-                    receivedHasFramingError = false;
-                }
-                else {
-                    this->diagnostics->packetDidNotStartWithZero();
+        // The settings the setup methods have changed, as bit flags.  When the keyboard
+        //  restarts, they're sent again in this order.
+        enum ConfigurationSetting : uint8_t {
+            scanCodeSetSetting = 0x01,
+            breakAndTypematicSetting = 0x02,
+            specificKeysSettings = 0x1c, // 0x04 << i for key list command 0xfd - i
+            enabledSetting = 0x20,
+            typematicRateSetting = 0x40,
+            ledsSetting = 0x80,
+        };
 
-                    // If we get a failure here, it should mean that previous byte is
-                    // not actually framed correctly and the stop bit and parity bit somehow
-                    // matched our expectations (or maybe they didn't and we got here anyway?)
-                    receivedHasFramingError = true;
-                    failureTimeMicroseconds = lastReadInterruptMicroseconds;
-                }
-                ++bitCounter;
-                parity = Parity::even;
-                break;
-            case 1:
-            case 2:
-            case 3:
-            case 4:
-            case 5:
-            case 6:
-            case 7:
-            case 8:
-                if (dataPinValue)
-                {
-                    ioByte |= (1 << (bitCounter - 1));
-                    parity ^= 1;
-                }
-                ++bitCounter;
-                break;
-            case 9:
-                if (parity != (Parity)dataPinValue) {
-                    this->diagnostics->parityError();
-                    receivedHasFramingError = true;
-                    failureTimeMicroseconds = lastReadInterruptMicroseconds;
-                }
-                ++bitCounter;
-                break;
-            case 10:
-                if (dataPinValue == 0) {
-                    this->diagnostics->packetDidNotEndWithOne();
-                    receivedHasFramingError = true;
-                    failureTimeMicroseconds = lastReadInterruptMicroseconds;
-                }
+        // The settings whose last acknowledged value is kept, so that commands that wouldn't
+        //  change anything can be skipped.
+        static const uint8_t cachedSettings = scanCodeSetSetting | typematicRateSetting | ledsSetting;
+
+        // If the keyboard doesn't answer while its configuration is being restored, this
+        //  is how long to wait before trying again.
+        static const uint16_t restoreRetryIntervalInMilliseconds = 500;
+
+        // The commands enableProbing sends, in order.  They go through the same machinery as
+        //  the settings restored after a restart, which marks them with probeSetting.
+        enum class ProbeStep : uint8_t {
+            none,
+            disable,
+            readId,
+            selectPs2ScanCodeSet,
+            readScanCodeSet,
+            selectPcatScanCodeSet,
+            enable,
+        };
+        static const uint8_t probeSetting = 0xff;
+
+        uint8_t configuredSettings = 0;
+        uint8_t settingsToRestore = 0;
+        ScanCodeSet configuredScanCodeSet;
+        ps2CommandCode configuredBreakAndTypematic;
+        const byte *configuredSpecificKeys[3];
+        uint8_t configuredSpecificKeyCounts[3];
+        bool configuredIsEnabled;
+        byte configuredTypematicRate;
+        KeyboardLeds configuredLeds;
+
+        uint8_t acknowledgedSettings = 0;
+        byte acknowledgedScanCodeSet;
+        byte acknowledgedTypematicRate;
+        byte acknowledgedLeds;
+
+        // The command being sent to restore a setting.
+        uint8_t settingBeingRestored = 0;
+        ps2CommandCode restoreCommand;
+        byte restoreArgument;
+        const byte *restoreKeys;
+        uint8_t restoreByteCount;
+        uint8_t restoreByteIndex;
+        uint8_t restoreRetryNumber;
+        bool isRestoreByteWaiting;
+        uint16_t restoreDelayInMilliseconds = 0;
+        unsigned long restoreTimeInMilliseconds = 0;
+
+        // The number of bytes the keyboard answers with after acknowledging the last byte of
+        //  the command, and the ones that have arrived.  Only probe commands have any.
+        uint8_t restoreAnswerLength = 0;
+        uint8_t restoreAnswerCount;
+        byte restoreAnswer[2];
+
+        bool isProbingEnabled = false;
+        ProbeStep probeStep = ProbeStep::none;
+        uint16_t probedId;
+        uint8_t probedScanCodeSets;
+        DeviceProfile profile = { 0xffff, 0 };
 
-                if (!receivedHasFramingError) {
-                    this->diagnostics->receivedByte(ioByte);
-                    this->inputBuffer.push((KeyboardOutput)ioByte);
+        bool sendCommand(ps2CommandCode command) {
+            this->finishRestoringCommand();
+            return this->sendData((byte)command);
+        }
+
+        bool sendCommand(ps2CommandCode command, byte data) {
+            return this->sendCommand(command)
+                && this->sendData(data);
+        }
+
+        bool sendCommand(ps2CommandCode command, const byte *data, int numBytes) {
+            if (!this->sendCommand(command)) {
+                return false;
+            }
+            for (int i = 0; i < numBytes; ++i) {
+                if (!this->sendData(data[i])) {
+                    return false;
                 }
-                bitCounter = 0;
-                ioByte = 0;
             }
+            return true;
         }
 
-        void writeInterruptHandler() {
-            int valueToSend;
+        byte configuredValue(uint8_t setting) {
+            return setting == scanCodeSetSetting ? (byte)this->configuredScanCodeSet
+                : (setting == typematicRateSetting ? this->configuredTypematicRate : (byte)this->configuredLeds);
+        }
 
-            switch (bitCounter)
-            {
-            case 0:
-                ++bitCounter;
-                break;
-            case 1:
-            case 2:
-            case 3:
-            case 4:
-            case 5:
-            case 6:
-            case 7:
-            case 8:
-                valueToSend = (this->ioByte & (1 << (bitCounter - 1))) ? HIGH : LOW;
-                digitalWrite(DataPin, valueToSend);
-                parity ^= valueToSend;
-                ++bitCounter;
-                break;
-            case 9:
-                digitalWrite(DataPin, (uint8_t)parity);
-                ++bitCounter;
-                break;
-            case 10:
-                pinMode(DataPin, INPUT_PULLUP);
-                ++bitCounter;
-                break;
-            case 11:
-                if (digitalRead(DataPin) != LOW) {
-                    // It'd be better to actually resend, but I don't think it's a thing,
-                    //  and it seems impossible to test anyway.
-                    this->diagnostics->sendFrameError();
-                }
+        byte &acknowledgedValue(uint8_t setting) {
+            return setting == scanCodeSetSetting ? this->acknowledgedScanCodeSet
+                : (setting == typematicRateSetting ? this->acknowledgedTypematicRate : this->acknowledgedLeds);
+        }
 
-                enableReadInterrupts();
-                break;
+        // True if the keyboard is known to have the given value for a cached setting.
+        bool isAcknowledged(uint8_t setting, byte value) {
+            return (this->acknowledgedSettings & setting) != 0 && this->acknowledgedValue(setting) == value;
+        }
+
+        // Records the outcome of sending a value for a setting; if it failed, the keyboard's
+        //  value is unknown.
+        bool acknowledge(uint8_t setting, byte value, bool isAcknowledged) {
+            if (isAcknowledged && (setting & cachedSettings) != 0) {
+                this->acknowledgedSettings |= setting;
+                this->acknowledgedValue(setting) = value;
+            }
+            else {
+                this->acknowledgedSettings &= ~setting;
             }
+            return isAcknowledged;
         }
 
-        void sendByte(uint8_t byte1) {
-            // ISSUE:  If we really want to be tight about it, we should check to see if the keyboard
-            //   is already in the middle of transmitting something before we launch into this.
+        // Records that the keyboard has gone back to its defaults for the given settings.
+        //  The others keep whatever value was acknowledged for them (e.g. "Set Default" leaves
+        //  the LEDs alone).
+        void acknowledgeDefaults(uint8_t settings) {
+            this->acknowledgedSettings |= settings & cachedSettings;
+            if (settings & scanCodeSetSetting) {
+                this->acknowledgedScanCodeSet = (byte)ScanCodeSet::defaultScanCodeSet;
+            }
+            if (settings & typematicRateSetting) {
+                this->acknowledgedTypematicRate = (byte)TypematicRate::defaultRate | ((byte)TypematicStartDelay::defaultDelay << 4);
+            }
+            if (settings & ledsSetting) {
+                this->acknowledgedLeds = (byte)KeyboardLeds::none;
+            }
+        }
 
-            detachInterrupt(digitalPinToInterrupt(ClockPin));
+        // Sends a command that sets a cached setting, unless the keyboard already has that value.
+        bool sendSetting(uint8_t setting, ps2CommandCode command) {
+            this->finishRestoringCommand();
+            byte value = this->configuredValue(setting);
+            if (this->isAcknowledged(setting, value)) {
+                return true;
+            }
+            return this->acknowledge(setting, value, this->sendCommand(command, value));
+        }
 
-            // Inhibit communication by pulling Clock low for at least 100 microseconds.
-            pinMode(ClockPin, OUTPUT);
-            digitalWrite(ClockPin, LOW);
-            delayMicroseconds(120);
+        // Arranges for readScanCode to send a cached setting, if the keyboard doesn't already
+        //  have that value.  If a previous value is still waiting to be sent, it's replaced.
+        void queueSetting(uint8_t setting) {
+            this->configuredSettings |= setting;
+            if (this->isAcknowledged(setting, this->configuredValue(setting))) {
+                this->settingsToRestore &= ~setting;
+            }
+            else {
+                this->settingsToRestore |= setting;
+            }
+        }
 
-            // Make sure when interrupts resume, we start in the right state - note that we
-            //  start sending data immediately on the first byte, because we will initiate
-            //  the start bit in this clock pulse.
-            this->receivedHasFramingError = false;
-            this->inputBuffer.clear();
-            this->bitCounter = 0;
-            this->parity = Parity::even;
-            this->ioByte = byte1;
-            attachInterrupt(digitalPinToInterrupt(ClockPin), Keyboard::staticWriteInterruptHandler, FALLING);
+        void configure(uint8_t setting) {
+            this->configuredSettings |= setting;
+            this->settingsToRestore &= ~setting;
+        }
+
+        void forget(uint8_t settings) {
+            this->configuredSettings &= ~settings;
+            this->settingsToRestore &= ~settings;
+        }
 
-            // Apply "Request-to-send" by pulling Data low, then release Clock.
-            pinMode(DataPin, OUTPUT);
-            digitalWrite(DataPin, LOW);
-            pinMode(ClockPin, INPUT_PULLUP);
+        void configureBreakAndTypematic(ps2CommandCode command) {
+            // Applies to all keys, so it overrides any key lists.
+            this->forget(specificKeysSettings);
+            this->configure(breakAndTypematicSetting);
+            this->configuredBreakAndTypematic = command;
         }
 
-        void enableReadInterrupts() {
-            this->receivedHasFramingError = false;
-            this->bitCounter = 0;
-            this->ioByte = 0;
-            this->parity = Parity::even;
-            this->inputBuffer.clear(); // gratuitious?  Probably...
+        void configureSpecificKeys(ps2CommandCode command, const byte *specificKeys, int numKeys) {
+            // The key list commands are 0xfb-0xfd; each has its own setting.
+            uint8_t i = (uint8_t)ps2CommandCode::disableBreakAndTypematicForSpecificKeys - (uint8_t)command;
+            this->configure(0x04 << i);
+            this->configuredSpecificKeys[i] = specificKeys;
+            this->configuredSpecificKeyCounts[i] = numKeys;
 
-            attachInterrupt(digitalPinToInterrupt(ClockPin), Keyboard::staticReadInterruptHandler, FALLING);
+            // The keyboard is disabled after any of these.
+            this->configure(enabledSetting);
+            this->configuredIsEnabled = false;
         }
 
-        static Keyboard *instance;
+        byte restoreByte() {
+            if (this->restoreByteIndex == 0) {
+                return (byte)this->restoreCommand;
+            }
+            else if (this->restoreKeys != nullptr) {
+                return this->restoreKeys[this->restoreByteIndex - 1];
+            }
+            else {
+                return this->restoreArgument;
+            }
+        }
 
-        static void staticReadInterruptHandler() {
-            instance->readInterruptHandler();
+        void sendRestoreByte() {
+            // Rather than wait for a byte the keyboard is sending to finish, as sendData would,
+            //  come back for it on a later call.
+            this->isRestoreByteWaiting = this->isReceivingFrame();
+            if (this->isRestoreByteWaiting) {
+                return;
+            }
+
+            byte data = this->restoreByte();
+            bool isLastByte = this->restoreByteIndex + 1 == this->restoreByteCount;
+            this->diagnostics->sentByte(data);
+            this->sendByte(data, isLastByte ? 1 + this->restoreAnswerLength : 1);
+            this->restoreTimeInMilliseconds = millis();
         }
 
-        static void staticWriteInterruptHandler() {
-            instance->writeInterruptHandler();
+        void startRestoring(uint8_t setting) {
+            this->settingBeingRestored = setting;
+            this->restoreKeys = nullptr;
+            this->restoreByteCount = 2;
+            this->restoreByteIndex = 0;
+            this->restoreRetryNumber = 0;
+            this->restoreAnswerLength = 0;
+
+            switch (setting) {
+            case scanCodeSetSetting:
+                this->restoreCommand = ps2CommandCode::setScanCodeSet;
+                this->restoreArgument = this->configuredValue(setting);
+                break;
+            case breakAndTypematicSetting:
+                this->restoreCommand = this->configuredBreakAndTypematic;
+                this->restoreByteCount = 1;
+                break;
+            case enabledSetting:
+                this->restoreCommand = this->configuredIsEnabled ? ps2CommandCode::enable : ps2CommandCode::disable;
+                this->restoreByteCount = 1;
+                break;
+            case typematicRateSetting:
+                this->restoreCommand = ps2CommandCode::setTypematicRate;
+                this->restoreArgument = this->configuredValue(setting);
+                break;
+            case ledsSetting:
+                this->restoreCommand = ps2CommandCode::setLeds;
+                this->restoreArgument = this->configuredValue(setting);
+                break;
+            default: {
+                uint8_t i = setting == 0x04 ? 0 : (setting == 0x08 ? 1 : 2);
+                this->restoreCommand = (ps2CommandCode)((uint8_t)ps2CommandCode::disableBreakAndTypematicForSpecificKeys - i);
+                this->restoreKeys = this->configuredSpecificKeys[i];
+                this->restoreByteCount = 1 + this->configuredSpecificKeyCounts[i];
+                break;
+            }
+            }
+
+            this->sendRestoreByte();
         }
 
-        /** \brief  Waits for a byte to be sent from the keyboard for a limited amount of time.
-         *          It peeks from the buffer, so a subsequent call to inputbuffer.pop will be
-         *          necessary to prevent a future call to the readScanCode method from picking it up.
-         *  \returns It returns the value it read or none if nothing showed up in the time alotted
-         *           or garbled if there was a communcation error in that time.
-         */
-        KeyboardOutput expectResponse(uint16_t timeoutInMilliseconds = immediateResponseTimeInMilliseconds)
-        {
-            unsigned long startMilliseconds = millis();
-            unsigned long stopMilliseconds = startMilliseconds + timeoutInMilliseconds;
-            unsigned long nowMilliseconds;
-            KeyboardOutput actualResponse;
-            do
-            {
-                actualResponse = this->inputBuffer.peek();
-                if (actualResponse == KeyboardOutput::none && this->receivedHasFramingError) {
-                    actualResponse = KeyboardOutput::garbled;
-                    // Note that clearing this is intended to prevent future polling from trying to get the
-                    //  bad character re-sent, but it might not work, depending on the nature of the error.
-                    //  Future interrupts could set it again.
-                    this->receivedHasFramingError = false;
+        void startProbeStep() {
+            this->settingBeingRestored = probeSetting;
+            this->restoreKeys = nullptr;
+            this->restoreByteCount = 2;
+            this->restoreByteIndex = 0;
+            this->restoreRetryNumber = 0;
+            this->restoreAnswerLength = 0;
+            this->restoreAnswerCount = 0;
+            switch (this->probeStep) {
+            case ProbeStep::disable:
+                // Besides keeping keystrokes out of the way, this puts the keyboard back to its
+                //  defaults, so it's in a known state.
+                this->restoreCommand = ps2CommandCode::disable;
+                this->restoreByteCount = 1;
+                break;
+            case ProbeStep::readId:
+                this->restoreCommand = ps2CommandCode::readId;
+                this->restoreByteCount = 1;
+                this->restoreAnswerLength = 2;
+                break;
+            case ProbeStep::selectPs2ScanCodeSet:
+                this->restoreCommand = ps2CommandCode::setScanCodeSet;
+                this->restoreArgument = (byte)ScanCodeSet::ps2;
+                break;
+            case ProbeStep::readScanCodeSet:
+                this->restoreCommand = ps2CommandCode::setScanCodeSet;
+                this->restoreArgument = 0;
+                this->restoreAnswerLength = 1;
+                break;
+            case ProbeStep::selectPcatScanCodeSet:
+                this->restoreCommand = ps2CommandCode::setScanCodeSet;
+                this->restoreArgument = (byte)ScanCodeSet::pcat;
+                break;
+            default:
+                this->restoreCommand = ps2CommandCode::enable;
+                this->restoreByteCount = 1;
+                break;
+            }
+            this->sendRestoreByte();
+        }
+
+        // Records what a probe command found out and moves on to the next one.  A command
+        //  the keyboard refused just means it doesn't have that feature.
+        void finishProbeStep(bool isAcknowledged) {
+            switch (this->probeStep) {
+            case ProbeStep::disable:
+                // The keyboard's back to its defaults, so everything has to be sent again
+                //  once the probe is done.
+                this->restoreConfiguration();
+                this->acknowledgeDefaults(cachedSettings);
+                break;
+            case ProbeStep::readId:
+                // Keyboards from before the PS2 acknowledge the command but don't send an ID.
+                this->probedId = this->restoreAnswerCount == 2 ? (this->restoreAnswer[0] << 8) | this->restoreAnswer[1] : 0;
+                break;
+            case ProbeStep::readScanCodeSet:
+                // Some keyboards that don't have set 3 acknowledge the command to select it
+                //  anyway, so this asks which set it's really in.
+                if (this->restoreAnswerCount == 1 && this->restoreAnswer[0] == (byte)ScanCodeSet::ps2) {
+                    this->probedScanCodeSets |= 1 << (uint8_t)ScanCodeSet::ps2;
+                }
+                break;
+            case ProbeStep::selectPcatScanCodeSet:
+                if (isAcknowledged) {
+                    this->probedScanCodeSets |= 1 << (uint8_t)ScanCodeSet::pcat;
                 }
-                nowMilliseconds = millis();
-            } while (actualResponse == KeyboardOutput::none && (nowMilliseconds < stopMilliseconds || (stopMilliseconds < startMilliseconds && startMilliseconds <= nowMilliseconds)));
+                break;
+            default:
+                break;
+            }
 
-            if (actualResponse == KeyboardOutput::none) {
-                this->diagnostics->noResponse(KeyboardOutput::none);
+            if (this->probeStep == ProbeStep::enable) {
+                this->profile.id = this->probedId;
+                this->profile.scanCodeSets = this->probedScanCodeSets;
+                this->probeStep = ProbeStep::none;
             }
-            return actualResponse;
+            else {
+                this->probeStep = (ProbeStep)((uint8_t)this->probeStep + 1);
+            }
+            this->settingBeingRestored = 0;
+            this->restoreDelayInMilliseconds = 0;
         }
 
-        /** \brief Waits a limited amount of time for a specific byte to be written by the keyboard.
-         *         If it appears, this method returns true.  If a different keycode appears, it will return
-         *         false and leave that byte on the input queue.
-         */
-        bool expectResponse(KeyboardOutput expectedResponse, uint16_t timeoutInMilliseconds = immediateResponseTimeInMilliseconds) {
-            KeyboardOutput actualResponse = expectResponse(timeoutInMilliseconds);
+        void startProbing() {
+            this->probedScanCodeSets = 0;
+            this->probeStep = ProbeStep::disable;
+        }
 
-            if (actualResponse == KeyboardOutput::none) {
-                // diagnostics already reported
+        // Moves the restoration of the keyboard's configuration (or queued settings) along
+        //  without waiting on the keyboard.  Returns true while a command is in progress,
+        //  which means that whatever the keyboard sends is the answer to it.
+        bool continueRestoring() {
+            if (this->settingBeingRestored == 0) {
+                if ((this->settingsToRestore == 0 && this->probeStep == ProbeStep::none)
+                 || millis() - this->restoreTimeInMilliseconds < this->restoreDelayInMilliseconds) {
+                    return false;
+                }
+                if (this->probeStep != ProbeStep::none) {
+                    // The probe goes first; it leaves the keyboard at its defaults.
+                    this->startProbeStep();
+                    return true;
+                }
+                while (this->settingsToRestore != 0) {
+                    // The flag is cleared now, so that if the setting is queued again while
+                    //  this command is in progress, the newer value gets sent afterwards.
+                    uint8_t setting = this->settingsToRestore & -this->settingsToRestore;
+                    this->settingsToRestore &= ~setting;
+                    if (!this->isAcknowledged(setting, this->configuredValue(setting))) {
+                        this->startRestoring(setting);
+                        return true;
+                    }
+                }
                 return false;
             }
-            else if ( actualResponse != expectedResponse ) {
-                this->diagnostics->incorrectResponse(actualResponse, expectedResponse);
-                return false;
+
+            if (this->isRestoreByteWaiting) {
+                this->sendRestoreByte();
+                return true;
             }
-            else {
-                this->inputBuffer.pop();
+
+            if (this->restoreByteIndex == this->restoreByteCount) {
+                // Everything's acknowledged; this is the keyboard's answer.
+                KeyboardOutput answer;
+                while (this->restoreAnswerCount < this->restoreAnswerLength && this->responseBuffer.pop(answer)) {
+                    this->restoreAnswer[this->restoreAnswerCount++] = (byte)answer;
+                }
+                if (this->restoreAnswerCount == this->restoreAnswerLength
+                 || millis() - this->restoreTimeInMilliseconds > this->sendResponseTimeoutInMilliseconds) {
+                    this->responseBytesExpected = 0;
+                    this->finishProbeStep(true);
+                }
                 return true;
             }
-        }
 
-        bool expectAck() {
-            return this->expectResponse(KeyboardOutput::ack);
-        }
+            KeyboardOutput response;
+            bool isAnswered = this->responseBuffer.pop(response);
+            if (!isAnswered && this->receivedHasFramingError) {
+                response = KeyboardOutput::garbled;
+                isAnswered = true;
+                this->receivedHasFramingError = false;
+            }
 
-        bool sendCommand(ps2CommandCode command) {
-            return this->sendData((byte)command);
-        }
+            if (isAnswered && response != KeyboardOutput::ack && response != KeyboardOutput::nack) {
+                // Same as expectAnswer.
+                this->passResponseAlong(response);
+                ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                    ++this->responseBytesExpected;
+                }
+                return true;
+            }
 
-        bool sendCommand(ps2CommandCode command, byte data) {
-            return this->sendCommand(command)
-                && this->sendData(data);
-        }
+            if (isAnswered && response == KeyboardOutput::ack) {
+                if (++this->restoreByteIndex < this->restoreByteCount) {
+                    this->restoreRetryNumber = 0;
+                    this->sendRestoreByte();
+                }
+                else if (this->settingBeingRestored == probeSetting) {
+                    if (this->restoreAnswerLength == 0) {
+                        this->finishProbeStep(true);
+                    }
+                }
+                else {
+                    uint8_t setting = this->settingBeingRestored;
+                    this->acknowledge(setting, this->restoreArgument, true);
+                    if ((setting & cachedSettings) != 0 && this->restoreArgument != this->configuredValue(setting)) {
+                        // It changed while this was being sent.
+                        this->settingsToRestore |= setting;
+                    }
+                    this->settingBeingRestored = 0;
+                    this->restoreDelayInMilliseconds = 0;
+                }
+                return true;
+            }
 
-        bool sendCommand(ps2CommandCode command, const byte *data, int numBytes) {
-            if (!this->sendCommand(command)) {
+            if (!isAnswered && !this->sendHasFramingError
+             && millis() - this->restoreTimeInMilliseconds <= this->sendResponseTimeoutInMilliseconds) {
+                return true;
+            }
+
+            // Same policy as sendData.
+            bool isWorthRetrying = isAnswered || this->sendHasFramingError;
+            if (isAnswered) {
+                this->diagnostics->incorrectResponse(response, KeyboardOutput::ack);
+            }
+            if (isWorthRetrying && this->restoreRetryNumber < this->maxSendRetries) {
+                ++this->restoreRetryNumber;
+                optionalDiagnostics::sendRetried(this->diagnostics, this->restoreByte(), this->restoreRetryNumber);
+                this->sendRestoreByte();
+                return true;
+            }
+
+            // If the keyboard asked for the byte again every time, it doesn't support this
+            //  setting, so it's dropped.  If it didn't answer, try again in a while.  If the
+            //  keyboard is gone, it'll send its startup message when it's plugged back in,
+            //  which restarts this anyway.
+            if (isAnswered && this->settingBeingRestored == probeSetting) {
+                this->responseBytesExpected = 0;
+                this->finishProbeStep(false);
                 return false;
             }
-            for (int i = 0; i < numBytes; ++i) {
-                if (!this->sendData(data[i])) {
-                    return false;
+            if (this->settingBeingRestored != probeSetting) {
+                this->acknowledge(this->settingBeingRestored, 0, false);
+            }
+            if (!isAnswered) {
+                this->responseBytesExpected = 0;
+                this->diagnostics->noResponse(KeyboardOutput::ack);
+                if (!this->isReading) {
+                    this->enableReadInterrupts();
+                }
+                if (this->settingBeingRestored == probeSetting) {
+                    // The keyboard's state is anybody's guess, so start the probe over.
+                    this->probeStep = ProbeStep::disable;
+                }
+                else {
+                    this->settingsToRestore |= this->settingBeingRestored;
                 }
+                this->restoreDelayInMilliseconds = restoreRetryIntervalInMilliseconds;
             }
-            return true;
+            this->settingBeingRestored = 0;
+            return false;
         }
 
-        bool sendData(byte data) {
-            this->diagnostics->sentByte(data);
-            this->sendByte(data);
-            bool isOk = this->expectAck();
-            if (!isOk)
-            {
-                this->enableReadInterrupts();
+        // The keyboard can only handle one command at a time, so a restore command that's
+        //  in progress has to be finished before sending another one.  So does a probe that's
+        //  underway, since it leaves the keyboard disabled and maybe in another scan code set.
+        void finishRestoringCommand() {
+            while (this->settingBeingRestored != 0 || this->probeStep > ProbeStep::disable) {
+                this->continueRestoring();
             }
-            return isOk;
-        }
-
-        void sendNack() {
-            this->diagnostics->sentByte((byte)ps2CommandCode::resend);
-            this->sendByte((byte)ps2CommandCode::resend);
         }
 
     public:
         Keyboard(Diagnostics &diagnostics = *Diagnostics::defaultInstance())
-            : inputBuffer(diagnostics)
+            : Port<DataPin, ClockPin, BufferSize, Diagnostics>(diagnostics)
         {
-            this->diagnostics = &diagnostics;
-            instance = this;
-        }
-
-        /**
-         * Starts the keyboard "service" by registering the external interrupt.
-         * setting the pin modes correctly and driving those needed to high.
-         * The best place to call this method is in the setup routine.
-         */
-        void begin() {
-            pinMode(ClockPin, INPUT_PULLUP);
-            pinMode(DataPin, INPUT_PULLUP);
-
-            // If the pin that support PWM output, we need to turn it off
-            // before getting a digital reading.  DigitalRead does that
-            digitalRead(DataPin);
-
-            this->enableReadInterrupts();
         }
 
         /** \brief After the keyboard gets power, the PS2 keyboard sends a code that indicates successful
@@ -470,6 +746,7 @@ namespace ps2 {
          *    specifically looks for that code and drops it on the floor when it arrives.
          */
         bool awaitStartup(uint16_t timeoutInMillis = 750) {
+            this->responseBytesExpected = 1;
             return this->expectResponse(KeyboardOutput::batSuccessful, timeoutInMillis);
         }
 
@@ -483,50 +760,24 @@ namespace ps2 {
          *   If there is nothing to read, this method will return 'none'.
          *
          *   It can also return 'garbled' if there's been a framing error.  A retry will be attempted,
-         *   but that's far from a sure-thing.  If you get this result, it likely indicates a collision
+         *   but it only works if this method gets called before the keyboard has finished sending
+         *   the byte after the bad one (about a millisecond).  A byte that lost a clock edge is only
+         *   noticed once the clock has been quiet for a while, so it's often too late for those.
+         *   If you get this result, it likely indicates a collision
          *   with one of your interrupt handlers.  Look into reducing the amount of processing you do
          *   in your interrupt handlers.
          *
          *   In any case, if you see a 'garbled' result, you might be losing some keystrokes, so do
          *   what you can to make sure that it doesn't impact the device too badly.
+         *
+         *   While the keyboard's configuration is being restored (see \ref HotPlug), this sends
+         *   the next byte of it when the keyboard is ready.
          */
         KeyboardOutput readScanCode() {
-            KeyboardOutput code = this->inputBuffer.pop();
-
-            if (code == KeyboardOutput::none && this->receivedHasFramingError)
-            {
-                // NACK's affect what the device perceives as the last character sent, so if we
-                //  interrupt immediately, it might decide to send the last scan code (which we
-                //  already have) again.  The clock is between 17KHz and 10KHz, so the fastest
-                //  send time for the 12 bits is going to be around 12*1000000/17000 700us and the
-                //  slowest would be 1200us.  Again, that's the full cycle.  Most of the errors
-                //  are going to be found at the parity & stop bit, so we'll wait 200us, as a guess,
-                //  before asking for a retry.
-                //
-                // In hindsight, I think likely the most effective way to do error detection would
-                //  be to wait for a certain amount of time after the last read interrupt when a
-                //  failure has previously been detected.  For that to work, then when the keyboard
-                //  sends a multi-byte sequence, there'd have to be a pause between one byte and
-                //  the next; I haven't validated that such a pause actually exists, however.
-                //
-                // The other concern is how to ensure that we can get Arduino-time during that
-                //  window; it'll be hard to guarantee that in a general purpose library.
-                if (failureTimeMicroseconds + 200 > micros()) {
-                    return KeyboardOutput::none;
-                }
-                if (this->bitCounter > 3) {
-                    this->sendNack();
-                }
-                else {
-                    this->diagnostics->clockLineGlitch(this->bitCounter);
-                    this->receivedHasFramingError = false;
-                    this->bitCounter = 0;
-                    this->ioByte = 0;
-                    this->parity = Parity::even;
-                }
-                return KeyboardOutput::garbled;
-            }
-            else if (code == KeyboardOutput::batSuccessful) {
+            bool isSending = this->continueRestoring();
+            KeyboardOutput code;
+            this->readByte(isSending, code);
+            if (code == KeyboardOutput::batSuccessful) {
                 // The keyboard will send either batSuccessful or batFailure on startup.
                 //   The way this class is structured, we can't really be sure that begin()
                 //   will be called immediately after power-up, nor can we be sure that the
@@ -534,26 +785,88 @@ namespace ps2 {
                 //   So we can't write code in begin() that just waits for the message.
                 //   We could have a flag that is true until the first action is taken
                 //   with the keyboard, but that seems needlessly wasteful.
+                //
+                //   If the keyboard was unplugged or browned out, though, it's back to its
+                //   defaults, so whatever the application set up has to be sent again.
+                this->restoreConfiguration();
+                this->acknowledgeDefaults(cachedSettings);
+                if (this->isProbingEnabled) {
+                    this->startProbing();
+                }
                 code = this->inputBuffer.pop();
             }
             else if (code == KeyboardOutput::batFailure) {
-                diagnostics->startupFailure();
+                this->diagnostics->startupFailure();
                 code = this->inputBuffer.pop();
             }
 
+            if (code != KeyboardOutput::none && code != KeyboardOutput::garbled) {
+                // garbled isn't a byte that came from the keyboard.
+                optionalDiagnostics::dequeuedByte(this->diagnostics, (byte)code);
+            }
             return code;
         }
 
+        /** \brief Calls handler with each scan code that has arrived, if any have.
+         *  \details
+         *   This does what calling \ref readScanCode until it returns none does, but when
+         *   nothing has happened since the last call (which is almost every call), it returns
+         *   after checking a flag set by the interrupt handler.  See \ref Dispatching.
+         *
+         *  \param handler A function, lambda or object with an operator(), taking a
+         *                 \ref KeyboardOutput.  It's a template parameter, so the call is
+         *                 made directly (and usually inlined); no pointer to it is kept.
+         *  \returns The number of scan codes passed to handler.
+         */
+        template<typename Handler>
+        uint8_t dispatch(Handler &&handler) {
+            if (!this->takePendingInput() && this->isIdle()) {
+                return 0;
+            }
+
+            uint8_t count = 0;
+            KeyboardOutput code;
+            while ((code = this->readScanCode()) != KeyboardOutput::none) {
+                handler(code);
+                ++count;
+            }
+            return count;
+        }
+
+        /** \brief Returns true if \ref dispatch has nothing to do until the keyboard sends
+         *         something, so loop() can put the processor to sleep.
+         */
+        bool isIdle() const {
+            return !this->hasPendingInput() && !this->isRestoringConfiguration() && !this->isProbing();
+        }
+
         /** \brief Sets the keyboard's onboard LED's.
          *  \details
-         *   This method takes several milliseconds and ties up the communication line with the keyboard.
-         *   You'll probably want to keep a variable somewhere that records what the current state of the
-         *   LED's are, and ensure that you only call this function when they actually change.
+         *   This method takes several milliseconds and ties up the communication line with the keyboard,
+         *   unless the keyboard has already acknowledged this state, in which case it returns true
+         *   without sending anything.  If the keyboard is sending a byte when it's called, it waits
+         *   for that to finish first, which can add up to 2ms for each of the command's two bytes.
+         *   If the LEDs can change faster than that, e.g. because they follow what a USB host asks
+         *   for, use \ref queueLedStatus instead.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool sendLedStatus(KeyboardLeds ledStatus)
         {
-            return sendCommand(ps2CommandCode::setLeds, (byte)ledStatus);
+            this->configure(ledsSetting);
+            this->configuredLeds = ledStatus;
+            return this->sendSetting(ledsSetting, ps2CommandCode::setLeds);
+        }
+
+        /** \brief Sets the keyboard's onboard LED's without waiting for the keyboard.
+         *  \details
+         *   The command is sent by \ref readScanCode once the keyboard isn't busy with another
+         *   one.  If this is called again before then, only the newest state is sent, and if
+         *   the keyboard already shows this state, nothing is sent at all.
+         */
+        void queueLedStatus(KeyboardLeds ledStatus)
+        {
+            this->configuredLeds = ledStatus;
+            this->queueSetting(ledsSetting);
         }
 
         /** \brief Resets the keyboard and returns true if the keyboard appears well, false otherwise.
@@ -564,27 +877,32 @@ namespace ps2 {
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool reset(uint16_t timeoutInMillis = 1000) {
+            this->forget(0xff);
+            this->finishRestoringCommand();
+            this->acknowledgedSettings = 0;
             this->inputBuffer.clear();
-            this->sendCommand(ps2CommandCode::reset);
-            return this->expectResponse(KeyboardOutput::batSuccessful, timeoutInMillis);
+            this->sendData((byte)ps2CommandCode::reset, 2);
+            if (!this->expectResponse(KeyboardOutput::batSuccessful, timeoutInMillis)) {
+                return false;
+            }
+            this->acknowledgeDefaults(cachedSettings);
+            return true;
         }
 
         /** \brief Returns the device ID returned by the keyboard - according to the documentation, this
          *         will always be 0xab83.  In the event of an error, this will return 0xffff.
          */
         uint16_t readId() {
-            this->sendCommand(ps2CommandCode::readId);
-            KeyboardOutput response = this->expectResponse();
-            if (response == KeyboardOutput::none) {
+            this->finishRestoringCommand();
+            this->sendData((byte)ps2CommandCode::readId, 3);
+            KeyboardOutput response;
+            if (!this->readResponse(response)) {
                 return 0xffff;
             }
-            this->inputBuffer.pop();
             uint16_t id = ((uint8_t)response) << 8;
-            response = this->expectResponse();
-            if (response == KeyboardOutput::none) {
+            if (!this->readResponse(response)) {
                 return 0xffff;
             }
-            this->inputBuffer.pop();
             id |= (uint8_t)response;
             return id;
         }
@@ -592,12 +910,12 @@ namespace ps2 {
         /** \brief Gets the current scancode set.
          */
         ScanCodeSet getScanCodeSet() {
-            if (!this->sendCommand(ps2CommandCode::setScanCodeSet, 0)) {
+            if (!this->sendCommand(ps2CommandCode::setScanCodeSet) || !this->sendData(0, 2)) {
                 return ScanCodeSet::error;
             }
-            ScanCodeSet result = (ScanCodeSet)this->expectResponse();
+            KeyboardOutput response;
+            ScanCodeSet result = this->readResponse(response) ? (ScanCodeSet)response : ScanCodeSet::error;
             if (result == ScanCodeSet::pcxt || result == ScanCodeSet::pcat || result == ScanCodeSet::ps2) {
-                this->inputBuffer.pop();
                 return result;
             }
             else {
@@ -606,29 +924,66 @@ namespace ps2 {
         }
 
         /** \brief Sets the current scancode set.
+        *   \details If the keyboard has already acknowledged this set, nothing is sent.
         *   \returns Returns true if the keyboard responded appropriately and false otherwise.
         */
         bool setScanCodeSet(ScanCodeSet newScanCodeSet) {
-            return this->sendCommand(ps2CommandCode::setScanCodeSet, (byte)newScanCodeSet);
+            this->configure(scanCodeSetSetting);
+            this->configuredScanCodeSet = newScanCodeSet;
+            return this->sendSetting(scanCodeSetSetting, ps2CommandCode::setScanCodeSet);
+        }
+
+        /** \brief Sets the current scancode set without waiting for the keyboard.
+         *  \details Works like \ref queueLedStatus.
+         */
+        void queueScanCodeSet(ScanCodeSet newScanCodeSet) {
+            this->configuredScanCodeSet = newScanCodeSet;
+            this->queueSetting(scanCodeSetSetting);
         }
 
         /** \brief
          *    Sends the "Echo" command to the keyboard, which should send an "Echo" in return.
          *   This can be used to verifies that a keyboard is connected and working properly.
+         *   Like the other commands, it first waits (up to 2ms) for any byte the keyboard is
+         *   sending to finish.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool echo() {
+            this->finishRestoringCommand();
+            this->waitForFrameToFinish();
             this->sendByte((byte)ps2CommandCode::echo);
-            return this->expectResponse(KeyboardOutput::echo);
+            KeyboardOutput response;
+            if (this->expectAnswer(KeyboardOutput::echo, response, this->immediateResponseTimeInMilliseconds)
+             && response == KeyboardOutput::echo) {
+                return true;
+            }
+
+            if (!this->isReading) {
+                // The keyboard never clocked the byte in.
+                this->enableReadInterrupts();
+            }
+            // The keyboard may have restarted without our seeing it say so.
+            this->restoreConfiguration();
+            return false;
         }
 
         /** \brief Sets the typematic rate (how fast presses come) and the delay (the time
          *         between key down and the start of auto-repeating.
+         *  \details If the keyboard has already acknowledged these values, nothing is sent.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool setTypematicRateAndDelay(TypematicRate rate, TypematicStartDelay startDelay) {
-            byte combined = (byte)rate | (((byte)startDelay) << 4);
-            return this->sendCommand(ps2CommandCode::setTypematicRate, combined);
+            this->configure(typematicRateSetting);
+            this->configuredTypematicRate = (byte)rate | (((byte)startDelay) << 4);
+            return this->sendSetting(typematicRateSetting, ps2CommandCode::setTypematicRate);
+        }
+
+        /** \brief Sets the typematic rate and delay without waiting for the keyboard.
+         *  \details Works like \ref queueLedStatus.
+         */
+        void queueTypematicRateAndDelay(TypematicRate rate, TypematicStartDelay startDelay) {
+            this->configuredTypematicRate = (byte)rate | (((byte)startDelay) << 4);
+            this->queueSetting(typematicRateSetting);
         }
 
         /** \brief Restores scan code set, typematic rate, and typematic delay.
@@ -636,23 +991,39 @@ namespace ps2 {
          */
         bool resetToDefaults()
         {
-            return this->sendCommand(ps2CommandCode::useDefaultSettings);
+            const uint8_t defaultedSettings = scanCodeSetSetting | breakAndTypematicSetting | specificKeysSettings | typematicRateSetting;
+            this->forget(defaultedSettings);
+            if (!this->sendCommand(ps2CommandCode::useDefaultSettings)) {
+                this->acknowledgedSettings &= ~defaultedSettings;
+                return false;
+            }
+            this->acknowledgeDefaults(defaultedSettings);
+            return true;
         }
 
         /** \brief Allows the keyboard to start sending data again.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
-        bool enable() { return this->sendCommand(ps2CommandCode::enable); }
+        bool enable() {
+            this->configure(enabledSetting);
+            this->configuredIsEnabled = true;
+            return this->sendCommand(ps2CommandCode::enable);
+        }
 
         /** \brief Makes it so the keyboard will no longer responsd to keystrokes.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
-        bool disable() { return this->sendCommand(ps2CommandCode::disable); }
+        bool disable() {
+            this->configure(enabledSetting);
+            this->configuredIsEnabled = false;
+            return this->sendCommand(ps2CommandCode::disable);
+        }
 
         /** \brief Re-enables typematic and break (unmake, key release) for all keys.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool enableBreakAndTypematic() {
+            this->configureBreakAndTypematic(ps2CommandCode::enableBreakAndTypeMaticForAllKeys);
             return this->sendCommand(ps2CommandCode::enableBreakAndTypeMaticForAllKeys);
         }
 
@@ -660,6 +1031,7 @@ namespace ps2 {
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool disableBreakCodes() {
+            this->configureBreakAndTypematic(ps2CommandCode::disableBreaksForAllKeys);
             return this->sendCommand(ps2CommandCode::disableBreaksForAllKeys);
         }
 
@@ -672,17 +1044,22 @@ namespace ps2 {
          *   After calling this method, the keyboard will be disabled. call enable to fix that.
          *
          * \param specificKeys An array consisting of valid set-3 scan codes.  If it contains a
-         *                     single invalid one, mayhem could ensue.
+         *                     single invalid one, mayhem could ensue.  It's kept so that it can
+         *                     be sent again if the keyboard restarts, so it can't be a temporary.
          * \param numKeys The number of keys to change
          */
         bool disableBreakCodes(const byte *specificKeys, int numKeys) {
+            this->configureSpecificKeys(ps2CommandCode::disableBreaksForSpecificKeys, specificKeys, numKeys);
             return this->sendCommand(ps2CommandCode::disableBreaksForSpecificKeys, specificKeys, numKeys);
         }
 
         /** \brief Makes the keyboard no longer send multiple key down events while a key is held down.
+         *  \details Keyboards only honor this in scan code set 3.  Pair it with a
+         *           \ref TypematicGenerator to repeat keys without the wire traffic.
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool disableTypematic() {
+            this->configureBreakAndTypematic(ps2CommandCode::disableTypematicForAllKeys);
             return this->sendCommand(ps2CommandCode::disableTypematicForAllKeys);
         }
 
@@ -690,6 +1067,7 @@ namespace ps2 {
          *  \returns Returns true if the keyboard responded appropriately and false otherwise.
          */
         bool disableBreakAndTypematic() {
+            this->configureBreakAndTypematic(ps2CommandCode::disableBreakAndTypematicForAllKeys);
             return this->sendCommand(ps2CommandCode::disableBreakAndTypematicForAllKeys);
         }
 
@@ -701,10 +1079,12 @@ namespace ps2 {
          *   After calling this method, the keyboard will be disabled. call enable to fix that.
          *
          * \param specificKeys An array consisting of valid set-3 scan codes.  If it contains a
-         *                     single invalid one, mayhem could ensue.
+         *                     single invalid one, mayhem could ensue.  It's kept so that it can
+         *                     be sent again if the keyboard restarts, so it can't be a temporary.
          * \param numKeys The number of keys to change
          */
         bool disableTypematic(const byte *specificKeys, int numKeys) {
+            this->configureSpecificKeys(ps2CommandCode::disableTypematicForSpecificKeys, specificKeys, numKeys);
             return this->sendCommand(ps2CommandCode::disableTypematicForSpecificKeys, specificKeys, numKeys);
         }
 
@@ -718,14 +1098,74 @@ namespace ps2 {
          *   After calling this method, the keyboard will be disabled. call enable to fix that.
          *
          * \param specificKeys An array consisting of valid set-3 scan codes.  If it contains a
-         *                     single invalid one, mayhem could ensue.
+         *                     single invalid one, mayhem could ensue.  It's kept so that it can
+         *                     be sent again if the keyboard restarts, so it can't be a temporary.
          * \param numKeys The number of keys to change
          */
         bool disableBreakAndTypematic(const byte *specificKeys, int numKeys) {
+            this->configureSpecificKeys(ps2CommandCode::disableBreakAndTypematicForSpecificKeys, specificKeys, numKeys);
             return this->sendCommand(ps2CommandCode::disableBreakAndTypematicForSpecificKeys, specificKeys, numKeys);
         }
-    };
 
-    template<int DataPin, int ClockPin, int BufferSize, typename Diagnostics>
-    Keyboard<DataPin, ClockPin, BufferSize, Diagnostics> *Keyboard<DataPin, ClockPin, BufferSize, Diagnostics>::instance = nullptr;
+        /** \brief Sends everything the setup methods have set up to the keyboard again.
+         *  \details
+         *   This happens automatically when the keyboard restarts (see \ref HotPlug), but you
+         *   can also call it yourself, e.g. if your circuit can cut the keyboard's power.  It
+         *   returns right away; the commands are sent by \ref readScanCode.
+         */
+        void restoreConfiguration() {
+            this->settingsToRestore = this->configuredSettings;
+            this->acknowledgedSettings = 0;
+            this->restoreDelayInMilliseconds = 0;
+        }
+
+        /** \brief Returns true if some of the keyboard's configuration (or a queued setting)
+         *         has yet to be sent.
+         */
+        bool isRestoringConfiguration() const {
+            return this->settingsToRestore != 0 || this->settingBeingRestored != 0;
+        }
+
+        /** \brief Finds out what the keyboard can do, now and every time it restarts.
+         *  \details
+         *   Instead of calling \ref readId and \ref getScanCodeSet yourself (and setting a scan
+         *   code set to see if it takes), call this after \ref begin, and the answers show up
+         *   in \ref getDeviceProfile.  Like the configuration after a restart (see \ref HotPlug),
+         *   the commands are sent a byte at a time by \ref readScanCode, so nothing waits on
+         *   the keyboard.  It takes about 25ms, against most of a second for \ref awaitStartup
+         *   and the same questions asked one at a time if the keyboard didn't just restart
+         *   (extras/tests/ProbeTest times both).
+         *
+         *   The keyboard is disabled while it's being probed, so keys pressed in that time are
+         *   lost, and the probe puts it back to its defaults.  Once it's done, everything the
+         *   setup methods asked for is sent again.  If the keyboard isn't there (or is still
+         *   starting up), the probe is tried again every half second.
+         *
+         *  \param probeNow If false, the keyboard isn't probed until it restarts.  Use that
+         *                  if you've given it a profile you saved with \ref setDeviceProfile.
+         */
+        void enableProbing(bool probeNow = true) {
+            this->isProbingEnabled = true;
+            if (probeNow) {
+                this->startProbing();
+            }
+        }
+
+        /** \brief Returns true until the probe started by \ref enableProbing is done. */
+        bool isProbing() const {
+            return this->probeStep != ProbeStep::none;
+        }
+
+        /** \brief Returns what the last probe found out.  Until the first one finishes, it's
+         *         whatever was given to \ref setDeviceProfile, or not \ref DeviceProfile::isValid.
+         */
+        const DeviceProfile &getDeviceProfile() const {
+            return this->profile;
+        }
+
+        /** \brief Supplies a profile from an earlier probe, e.g. one kept in EEPROM. */
+        void setDeviceProfile(const DeviceProfile &profile) {
+            this->profile = profile;
+        }
+    };
 }
@@ -18,9 +18,9 @@ USA
 */
 #pragma once
 
+#include "ps2_Platform.h"
 #include "ps2_KeyboardOutput.h"
 #include "ps2_NullDiagnostics.h"
-#include <util/atomic.h>
 
 namespace ps2 {
     /** @private
@@ -35,7 +35,14 @@ namespace ps2 {
         KeyboardOutput buffer[Size];
         TDiagnostics *diagnostics;
 
-        const uint8_t EmptyMarker = 0xff;
+        static const uint8_t EmptyMarker = 0xff;
+
+        // AVR has no divide instruction, so '% Size' would be a call into the runtime library
+        //  on every byte unless Size happens to be a power of two.  This is a compare and a
+        //  branch.
+        static uint8_t next(uint8_t index) {
+            return (index == Size - 1) ? 0 : index + 1;
+        }
 
     public:
         KeyboardOutputBuffer(TDiagnostics &diagnostics) {
@@ -48,13 +55,13 @@ namespace ps2 {
          *  expects to be run from inside an interrupt handler
          */
         void push(KeyboardOutput valueAtTop) {
-            uint8_t nextTail = (this->tail + 1) % Size;
+            uint8_t nextTail = next(this->tail);
             if (this->head == EmptyMarker) {
                 this->head = this->tail;
             }
             else if (this->head == this->tail) {
                 this->diagnostics->bufferOverflow();
-                ++this->head;
+                this->head = next(this->head);
             }
             buffer[this->tail] = valueAtTop;
             this->tail = nextTail;
@@ -65,18 +72,28 @@ namespace ps2 {
          */
         KeyboardOutput pop() {
             KeyboardOutput valueAtTop;
+            this->pop(valueAtTop);
+            return valueAtTop;
+        }
+
+        /** Like pop(), but returns whether there was anything in the queue, so that a 0 byte
+         *  (which a mouse sends all the time) can be told apart from an empty queue.
+         */
+        bool pop(KeyboardOutput &valueAtTop) {
+            bool isAvailable;
             ATOMIC_BLOCK(ATOMIC_FORCEON)
             {
-                if (this->head == EmptyMarker) {
-                    valueAtTop = KeyboardOutput::none;
-                }
-                else {
+                isAvailable = this->head != EmptyMarker;
+                if (isAvailable) {
                     valueAtTop = buffer[this->head];
-                    int h = (this->head + 1) % Size;
+                    uint8_t h = next(this->head);
                     this->head = (h == this->tail) ? EmptyMarker : h;
                 }
             }
-            return valueAtTop;
+            if (!isAvailable) {
+                valueAtTop = KeyboardOutput::none;
+            }
+            return isAvailable;
         }
 
         KeyboardOutput peek() {
@@ -94,6 +111,16 @@ namespace ps2 {
                 this->head = EmptyMarker;
             }
         }
+
+        /** Returns the number of bytes in the queue.  This code expects to be run from
+         *  inside an interrupt handler.
+         */
+        uint8_t count() const {
+            if (this->head == EmptyMarker) {
+                return 0;
+            }
+            return (this->tail > this->head) ? this->tail - this->head : this->tail + Size - this->head;
+        }
     };
 
 
@@ -136,6 +163,12 @@ namespace ps2 {
             return valueAtTop;
         }
 
+        // A one-byte buffer can't hold a 0 byte, which is why Mouse doesn't allow it.
+        bool pop(KeyboardOutput &valueAtTop) {
+            valueAtTop = this->pop();
+            return valueAtTop != KeyboardOutput::none;
+        }
+
         KeyboardOutput peek() {
             return this->buffer;
         }
@@ -144,5 +177,9 @@ namespace ps2 {
         void clear() {
             this->buffer = KeyboardOutput::none;
         }
+
+        uint8_t count() const {
+            return this->buffer == KeyboardOutput::none ? 0 : 1;
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+#include "ps2_Platform.h"
+#include "ps2_KeyboardOutput.h"
+
+namespace ps2 {
+    /** \brief Measures how long keystrokes take to get from the wire to wherever your
+     *         application sends them.
+     *
+     *  \details
+     *   Each byte is stamped with micros() when its stop bit arrives in the read interrupt
+     *   handler.  When \ref Keyboard::readScanCode hands the byte to your program, the stamp
+     *   is picked up again, and your program marks the remaining stages by calling
+     *   \ref keyTranslated and \ref reportSent.  That gives four latency histograms:
+     *
+     *   - receiveToDequeue: stop bit to readScanCode.  This is the time spent in the buffer,
+     *     which is what grows if loop() is slow.
+     *   - dequeueToTranslate: readScanCode to \ref keyTranslated.
+     *   - translateToReport: \ref keyTranslated to \ref reportSent.
+     *   - receiveToReport: the whole trip.
+     *
+     *   When a key produces a multi-byte sequence, the stamp that's carried through is the
+     *   one for the last byte of the sequence - the one that let the translator produce a key.
+     *
+     *  \code
+     *   static ps2::LatencyDiagnostics<> diagnostics;
+     *   static ps2::UsbTranslator<ps2::LatencyDiagnostics<>> keyMapping(diagnostics);
+     *   static ps2::Keyboard<3,2,16,ps2::LatencyDiagnostics<>> ps2Keyboard(diagnostics);
+     *
+     *   void loop() {
+     *     ps2::KeyboardOutput scanCode = ps2Keyboard.readScanCode();
+     *     if (scanCode != ps2::KeyboardOutput::none && scanCode != ps2::KeyboardOutput::garbled) {
+     *       ps2::UsbKeyAction action = keyMapping.translatePs2Keycode(scanCode);
+     *       if (action.gesture == ps2::UsbKeyAction::KeyDown) {
+     *         diagnostics.keyTranslated();
+     *         BootKeyboard.press((KeyboardKeycode)action.hidCode);
+     *         diagnostics.reportSent();
+     *       }
+     *     }
+     *   }
+     *  \endcode
+     *
+     *   Bucket 0 of each histogram counts latencies under 16us and bucket N counts latencies
+     *   from 2^(N+3) to 2^(N+4) microseconds; the last bucket also holds anything longer.
+     *
+     *  \tparam Depth The number of stamps to hold.  It should be at least as large as the
+     *                BufferSize of the \ref Keyboard, else stamps for the oldest bytes will be
+     *                lost when the buffer backs up.
+     */
+    template <uint8_t Depth = 16>
+    class LatencyDiagnostics
+    {
+    public:
+        /** \brief The stages that are measured, in the order they appear in \ref sendReport. */
+        enum class Stage : uint8_t {
+            receiveToDequeue = 0,
+            dequeueToTranslate = 1,
+            translateToReport = 2,
+            receiveToReport = 3,
+            _count = 4,
+        };
+
+        static const uint8_t numBuckets = 16;
+
+    private:
+        struct Stamp {
+            byte value;
+            uint32_t receivedMicros;
+        };
+
+        Stamp stamps[Depth];
+        uint8_t firstStamp = 0;
+        uint8_t numStamps = 0;
+
+        uint32_t receivedMicros = 0;
+        uint32_t dequeuedMicros = 0;
+        uint32_t translatedMicros = 0;
+        bool haveDequeued = false;
+        bool haveTranslated = false;
+
+        uint16_t histograms[(uint8_t)Stage::_count][numBuckets];
+        uint32_t maxMicros[(uint8_t)Stage::_count];
+
+        void record(Stage stage, uint32_t elapsedMicros) {
+            uint32_t v = elapsedMicros >> 4;
+            uint8_t bucket = 0;
+            while (v != 0 && bucket < numBuckets - 1) {
+                v >>= 1;
+                ++bucket;
+            }
+
+            uint16_t &count = this->histograms[(uint8_t)stage][bucket];
+            if (count != 0xffff) {
+                ++count;
+            }
+            if (elapsedMicros > this->maxMicros[(uint8_t)stage]) {
+                this->maxMicros[(uint8_t)stage] = elapsedMicros;
+            }
+        }
+
+    public:
+        LatencyDiagnostics() {
+            this->reset();
+        }
+
+        /** \brief Call this when the scan code most recently returned by readScanCode has been
+         *         turned into a key by your translator.
+         */
+        void keyTranslated() {
+            if (this->haveDequeued) {
+                uint32_t now = micros();
+                this->record(Stage::dequeueToTranslate, now - this->dequeuedMicros);
+                this->translatedMicros = now;
+                this->haveTranslated = true;
+            }
+        }
+
+        /** \brief Call this when the key passed to \ref keyTranslated has been sent on (e.g.
+         *         after BootKeyboard.press returns).
+         */
+        void reportSent() {
+            if (this->haveTranslated) {
+                uint32_t now = micros();
+                this->record(Stage::translateToReport, now - this->translatedMicros);
+                this->record(Stage::receiveToReport, now - this->receivedMicros);
+                this->haveTranslated = false;
+            }
+        }
+
+        /** \brief Returns the longest latency seen for the given stage, in microseconds. */
+        uint32_t getMaxMicros(Stage stage) const { return this->maxMicros[(uint8_t)stage]; }
+
+        /** \brief Dumps the histograms to a print-based class.
+         *  \details
+         *   Each stage is printed as 'max:bucket0,bucket1,...', in hex, and the stages
+         *   are separated by '|' and wrapped in braces.
+         */
+        template <typename Target>
+        void sendReport(Target &printTo) {
+            printTo.print("{");
+            for (uint8_t stage = 0; stage < (uint8_t)Stage::_count; ++stage) {
+                if (stage > 0) {
+                    printTo.print("|");
+                }
+                printTo.print(this->maxMicros[stage], 16);
+                printTo.print(":");
+                for (uint8_t bucket = 0; bucket < numBuckets; ++bucket) {
+                    if (bucket > 0) {
+                        printTo.print(",");
+                    }
+                    printTo.print(this->histograms[stage][bucket], 16);
+                }
+            }
+            printTo.print("}");
+        }
+
+        /** \brief Clears all recorded data. */
+        void reset() {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                for (uint8_t stage = 0; stage < (uint8_t)Stage::_count; ++stage) {
+                    for (uint8_t bucket = 0; bucket < numBuckets; ++bucket) {
+                        this->histograms[stage][bucket] = 0;
+                    }
+                    this->maxMicros[stage] = 0;
+                }
+                this->numStamps = 0;
+                this->haveDequeued = false;
+                this->haveTranslated = false;
+            }
+        }
+
+        void packetDidNotStartWithZero() {}
+        void parityError() {}
+        void packetDidNotEndWithOne() {}
+        void packetIncomplete() {}
+        void sendFrameError() {}
+        void startupFailure() {}
+        void bufferOverflow() {}
+        void incorrectResponse(KeyboardOutput scanCode, KeyboardOutput expectedScanCode) {}
+        void noResponse(KeyboardOutput expectedScanCode) {}
+        void noTranslationForKey(bool isExtended, KeyboardOutput code) {}
+        void sentByte(byte b) {}
+        void clockLineGlitch(uint8_t numBitsSent) {}
+        void sendRetried(byte b, uint8_t retryNumber) {}
+        void readInterruptStarted() {}
+        void readInterruptCompleted() {}
+        void writeInterruptStarted() {}
+        void writeInterruptCompleted() {}
+        void bufferDepth(uint8_t numBytesQueued) {}
+
+        // Called from the read interrupt handler when the stop bit arrives.
+        void receivedByte(byte b) {
+            uint8_t i = this->firstStamp + this->numStamps;
+            if (i >= Depth) {
+                i -= Depth;
+            }
+            this->stamps[i].value = b;
+            this->stamps[i].receivedMicros = micros();
+
+            if (this->numStamps == Depth) {
+                // Full - the oldest stamp is gone.
+                this->firstStamp = (this->firstStamp == Depth - 1) ? 0 : this->firstStamp + 1;
+            }
+            else {
+                ++this->numStamps;
+            }
+        }
+
+        // Called from readScanCode.  Bytes the Keyboard consumes itself (e.g. acks to commands)
+        //  never come through here, so stamps ahead of the matching one are skipped over.  If
+        //  nothing matches (the byte's stamp was pushed out by newer ones), the stamps are left
+        //  alone, since they still belong to the bytes waiting in the buffer.
+        void dequeuedByte(byte b) {
+            uint32_t now = micros();
+            this->haveDequeued = false;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                uint8_t i = this->firstStamp;
+                for (uint8_t n = 0; n < this->numStamps; ++n) {
+                    if (this->stamps[i].value == b) {
+                        this->receivedMicros = this->stamps[i].receivedMicros;
+                        this->haveDequeued = true;
+                        this->firstStamp = (i == Depth - 1) ? 0 : i + 1;
+                        this->numStamps -= n + 1;
+                        break;
+                    }
+                    i = (i == Depth - 1) ? 0 : i + 1;
+                }
+            }
+
+            if (this->haveDequeued) {
+                this->record(Stage::receiveToDequeue, now - this->receivedMicros);
+                this->dequeuedMicros = now;
+            }
+        }
+    };
+}
@@ -0,0 +1,345 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+#include "ps2_Platform.h"
+#include "ps2_NullDiagnostics.h"
+#include "ps2_KeyboardOutput.h"
+#include "ps2_MousePacket.h"
+#include "ps2_Port.h"
+
+namespace ps2 {
+    /**
+     * \brief
+     *  Instances of this class can be used to interface with a PS2 mouse or trackball.  It uses
+     *  the same wiring, interrupt handling and error recovery as \ref Keyboard; what's different
+     *  is the setup and that the mouse reports in packets of 3 or 4 bytes, which this class
+     *  puts back together.
+     *
+     * \tparam DataPin The pin number of the pin that's connected to the PS2 data wire.
+     * \tparam ClockPin The pin number of the pin that's connected to the PS2 clock wire.  This
+     *                  pin must be one that supports interrupts on your board.
+     * \tparam BufferSize The number of bytes held between the clock interrupt and
+     *                    \ref readPacket.  A packet is 3 or 4 bytes and a mouse sends up to
+     *                    200 of them a second, so the default of 16 covers a loop() that
+     *                    takes up to about 20ms.  It must be at least 4.
+     * \tparam Diagnostics See \ref Keyboard.
+     *
+     * \details
+     *  Most programs will use this class like this:
+     *
+     * \code
+     * static ps2::Mouse<4,2> ps2Mouse;
+     *
+     * void setup() {
+     *   ps2Mouse.begin();
+     *   ps2Mouse.initialize(100);
+     * }
+     *
+     * void loop() {
+     *   ps2::MousePacket packet;
+     *   while (ps2Mouse.readPacket(packet)) {
+     *     moveBy(packet.x, packet.y);
+     *   }
+     * }
+     * \endcode
+     *
+     *  \ref initialize resets the mouse, turns on the wheel (and buttons 4 and 5) if the mouse
+     *  has them, sets the sample rate and starts it streaming.  It takes about half a second,
+     *  most of which is the mouse's self-test.
+     *
+     *  If a byte arrives garbled or goes missing (say because another interrupt handler held
+     *  off the clock interrupt for too long), \ref readPacket doesn't try to put the packet
+     *  back together.  It turns the mouse's reporting off and back on, which makes the mouse
+     *  start over with a fresh packet, and returns false.  That takes a few milliseconds, and
+     *  the movement in the packets that were lost is lost with them.  The same happens if a
+     *  packet doesn't start the way every packet does (with bit 3 set).
+     *
+     *  Unlike a keyboard, a mouse doesn't say much when it's plugged back in, and it comes
+     *  back with streaming turned off.  If your device might see that, call \ref initialize
+     *  again when \ref readPacket has returned nothing for longer than you'd expect.
+     */
+    template<int DataPin, int ClockPin, int BufferSize = 16, typename Diagnostics = NullDiagnostics>
+    class Mouse : public Port<DataPin, ClockPin, BufferSize, Diagnostics> {
+        // A one-byte buffer can't tell a 0 byte from an empty buffer, and a mouse sends lots of them.
+        static_assert(BufferSize >= 4, "BufferSize must be at least 4 for a mouse");
+
+        // Commands sent from the host to the mouse.
+        enum class ps2CommandCode : uint8_t {
+            reset = 0xff,
+            resend = 0xfe,
+            setDefaults = 0xf6,
+            disableDataReporting = 0xf5,
+            enableDataReporting = 0xf4,
+            setSampleRate = 0xf3,
+            getDeviceId = 0xf2,
+            setRemoteMode = 0xf0,
+            readData = 0xeb,
+            setStreamMode = 0xea,
+            statusRequest = 0xe9,
+            setResolution = 0xe8,
+        };
+
+        // The IDs a mouse reports after the sample rate "knock" sequences in detectExtensions.
+        static const uint8_t wheelMouseId = 0x03;
+        static const uint8_t fiveButtonMouseId = 0x04;
+
+        uint8_t deviceId = 0;
+        uint8_t packetSize = 3;
+        uint8_t packetByteCount = 0;
+        byte packetBytes[4];
+        uint8_t lastReceiveErrorCount = 0;
+
+        bool sendCommand(ps2CommandCode command) {
+            return this->sendData((byte)command);
+        }
+
+        bool sendCommand(ps2CommandCode command, byte data) {
+            return this->sendCommand(command)
+                && this->sendData(data);
+        }
+
+        // IntelliMouse-compatible mice switch on their extra features when they see a particular
+        //  sequence of sample rates, and say so by changing their ID.
+        uint8_t knock(uint8_t rate1, uint8_t rate2, uint8_t rate3) {
+            if (!this->setSampleRate(rate1) || !this->setSampleRate(rate2) || !this->setSampleRate(rate3)) {
+                return 0xff;
+            }
+            return this->readId();
+        }
+
+        // Gets the packets back in step after a byte was lost or garbled.  Asking for the byte
+        //  again, as Keyboard does, doesn't work here:  the mouse only keeps its last byte, and
+        //  by the time the error is noticed, it has usually sent another.  Turning reporting
+        //  off and back on makes the mouse throw away what it had and start on a fresh packet.
+        void resynchronize() {
+            this->hasLostByte = false;
+            this->disableStreaming();
+            this->enableStreaming();
+        }
+
+        void decode(MousePacket &packet) {
+            byte flags = this->packetBytes[0];
+            packet.x = (int16_t)this->packetBytes[1] - ((flags & 0x10) ? 0x100 : 0);
+            packet.y = (int16_t)this->packetBytes[2] - ((flags & 0x20) ? 0x100 : 0);
+            packet.isOverflowed = (flags & 0xc0) != 0;
+            uint8_t buttons = flags & 0x07;
+            packet.wheel = 0;
+            if (this->packetSize == 4) {
+                byte extra = this->packetBytes[3];
+                if (this->deviceId == fiveButtonMouseId) {
+                    // The wheel gets the low 4 bits, and buttons 4 and 5 are in bits 4 and 5.
+                    packet.wheel = (int8_t)(extra << 4) >> 4;
+                    buttons |= (extra & 0x30) >> 1;
+                }
+                else {
+                    packet.wheel = (int8_t)extra;
+                }
+            }
+            packet.buttons = (MouseButtons)buttons;
+        }
+
+    public:
+        Mouse(Diagnostics &diagnostics = *Diagnostics::defaultInstance())
+            : Port<DataPin, ClockPin, BufferSize, Diagnostics>(diagnostics)
+        {
+        }
+
+        /** \brief Resets the mouse, finds out what it can do, and starts it sending packets.
+         *  \param samplesPerSecond How many packets a second the mouse sends while it's moving;
+         *                          see \ref setSampleRate.
+         *  \returns Returns true if the mouse responded appropriately and false otherwise.
+         */
+        bool initialize(uint8_t samplesPerSecond = 100) {
+            return this->reset()
+                && this->detectExtensions()
+                && this->setSampleRate(samplesPerSecond)
+                && this->enableStreaming();
+        }
+
+        /** \brief Resets the mouse and returns true if it passed its self-test.
+         *  \details
+         *   This can take up to a second to complete.  Afterwards the mouse is in stream mode
+         *   with reporting turned off, sending 3-byte packets at 100 samples per second.
+         */
+        bool reset(uint16_t timeoutInMillis = 1000) {
+            this->deviceId = 0;
+            this->packetSize = 3;
+            this->packetByteCount = 0;
+            this->inputBuffer.clear();
+            if (!this->sendData((byte)ps2CommandCode::reset, 3)) {
+                return false;
+            }
+
+            KeyboardOutput response;
+            if (!this->readResponse(response, timeoutInMillis) || response != KeyboardOutput::batSuccessful) {
+                return false;
+            }
+            return this->readResponse(response) && (uint8_t)response == 0;
+        }
+
+        /** \brief Turns on the wheel, and then buttons 4 and 5, if the mouse has them.
+         *  \details
+         *   \ref initialize calls this; you only need it if you're doing the setup yourself.
+         *   Afterwards, \ref hasWheel says what was found, and the sample rate is 80.
+         *  \returns Returns true if the mouse responded appropriately and false otherwise.
+         */
+        bool detectExtensions() {
+            // If an answer goes missing, the mouse may have switched modes without our knowing
+            //  which, so that has to count as a failure.
+            uint8_t id = this->knock(200, 100, 80);
+            if (id == wheelMouseId) {
+                id = this->knock(200, 200, 80);
+            }
+            if (id == 0xff) {
+                return false;
+            }
+
+            this->deviceId = id;
+            this->packetSize = (id == wheelMouseId || id == fiveButtonMouseId) ? 4 : 3;
+            return true;
+        }
+
+        /** \brief Returns the mouse's ID: 0 for a plain mouse, 3 for one with a wheel and 4 for
+         *         one with a wheel and 5 buttons.  In the event of an error, returns 0xff.
+         */
+        uint8_t readId() {
+            KeyboardOutput response;
+            if (!this->sendData((byte)ps2CommandCode::getDeviceId, 2) || !this->readResponse(response)) {
+                return 0xff;
+            }
+            return (uint8_t)response;
+        }
+
+        /** \brief Sets how many packets a second the mouse sends while it's being moved.
+         *  \param samplesPerSecond One of 10, 20, 40, 60, 80, 100 or 200.
+         *  \returns Returns true if the mouse responded appropriately and false otherwise.
+         */
+        bool setSampleRate(uint8_t samplesPerSecond) {
+            return this->sendCommand(ps2CommandCode::setSampleRate, samplesPerSecond);
+        }
+
+        /** \brief Sets how far the mouse has to move for each count.
+         *  \param resolution 0 for 1 count per millimeter, 1 for 2, 2 for 4 and 3 for 8.
+         *  \returns Returns true if the mouse responded appropriately and false otherwise.
+         */
+        bool setResolution(uint8_t resolution) {
+            return this->sendCommand(ps2CommandCode::setResolution, resolution);
+        }
+
+        /** \brief Makes the mouse send packets whenever it moves or a button changes.
+         *  \returns Returns true if the mouse responded appropriately and false otherwise.
+         */
+        bool enableStreaming() {
+            bool result = this->sendCommand(ps2CommandCode::setStreamMode)
+                && this->sendCommand(ps2CommandCode::enableDataReporting);
+            // Errors from before now don't matter to the packets that are coming.
+            this->packetByteCount = 0;
+            this->lastReceiveErrorCount = this->receiveErrorCount;
+            return result;
+        }
+
+        /** \brief Stops the mouse from sending packets.
+         *  \details
+         *   A packet byte can look just like an acknowledgement, so the mouse has to be quiet
+         *   while it's sent commands.  Call this before any of the setup methods, other than
+         *   \ref reset and \ref initialize, if the mouse is streaming.
+         *  \returns Returns true if the mouse responded appropriately and false otherwise.
+         */
+        bool disableStreaming() {
+            bool result = this->sendCommand(ps2CommandCode::disableDataReporting);
+            this->packetByteCount = 0;
+            this->inputBuffer.clear();
+            return result;
+        }
+
+        /** \brief Returns true if the mouse reports a wheel (and so sends 4-byte packets). */
+        bool hasWheel() const {
+            return this->packetSize == 4;
+        }
+
+        /** \brief Returns true if the mouse reports buttons 4 and 5 as well as a wheel. */
+        bool hasFiveButtons() const {
+            return this->deviceId == fiveButtonMouseId;
+        }
+
+        /** \brief Calls handler with each packet that has arrived, if any have.
+         *  \details
+         *   Works like \ref Keyboard::dispatch: when nothing has come in since the last call,
+         *   it returns after checking a flag, and loop() can sleep if \ref isIdle says so.
+         *  \param handler A function, lambda or object with an operator(), taking a
+         *                 const \ref MousePacket &.
+         *  \returns The number of packets passed to handler.
+         */
+        template<typename Handler>
+        uint8_t dispatch(Handler &&handler) {
+            if (!this->takePendingInput()) {
+                return 0;
+            }
+
+            uint8_t count = 0;
+            MousePacket packet;
+            while (this->readPacket(packet)) {
+                handler((const MousePacket &)packet);
+                ++count;
+            }
+            return count;
+        }
+
+        /** \brief Returns true if \ref dispatch has nothing to do until the mouse sends something. */
+        bool isIdle() const {
+            return !this->hasPendingInput();
+        }
+
+        /** \brief Gets the next packet from the mouse, if a whole one has arrived.
+         *  \details
+         *   Call this from loop(), as often as you can, and until it returns false if loop()
+         *   takes a while.  It takes the bytes that have arrived out of the buffer and puts
+         *   them together; part of a packet is kept until the rest arrives.
+         *  \returns Returns true if packet was filled in, false if there wasn't a whole packet.
+         */
+        bool readPacket(MousePacket &packet) {
+            for (;;) {
+                if (this->receiveErrorCount != this->lastReceiveErrorCount || this->hasAbandonedFrame()) {
+                    this->resynchronize();
+                    return false;
+                }
+
+                KeyboardOutput code;
+                if (!this->readByte(true, code)) {
+                    return false;
+                }
+
+                byte data = (byte)code;
+                if (this->packetByteCount == 0 && (data & 0x08) == 0) {
+                    // Every packet starts with bit 3 set, so this is out of step somehow.
+                    this->resynchronize();
+                    return false;
+                }
+
+                this->packetBytes[this->packetByteCount++] = data;
+                if (this->packetByteCount == this->packetSize) {
+                    this->packetByteCount = 0;
+                    this->decode(packet);
+                    return true;
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include <stdint.h>
+
+namespace ps2 {
+    /** \brief The buttons on a PS2 mouse. */
+    enum class MouseButtons : uint8_t {
+        left = 0x01,
+        right = 0x02,
+        middle = 0x04,
+        button4 = 0x08, // Only reported by 5-button mice (device ID 4)
+        button5 = 0x10,
+
+        none = 0x00,
+    };
+    inline MouseButtons operator|(MouseButtons a, MouseButtons b)
+    {
+        return static_cast<MouseButtons>(static_cast<uint8_t>(a) | static_cast<uint8_t>(b));
+    }
+    inline MouseButtons operator&(MouseButtons a, MouseButtons b)
+    {
+        return static_cast<MouseButtons>(static_cast<uint8_t>(a) & static_cast<uint8_t>(b));
+    }
+
+    /** \brief One movement report from a mouse, as assembled by \ref Mouse::readPacket. */
+    struct MousePacket {
+        /** \brief Movement to the right since the last packet, in counts. */
+        int16_t x;
+        /** \brief Movement away from you since the last packet, in counts. */
+        int16_t y;
+        /** \brief Wheel movement since the last packet, as the mouse reports it.  Always 0 for
+         *         a mouse without a wheel.
+         */
+        int8_t wheel;
+        /** \brief The buttons that are down. */
+        MouseButtons buttons;
+        /** \brief True if the mouse moved further than it could report, so x or y is short. */
+        bool isOverflowed;
+    };
+}
@@ -19,6 +19,7 @@ USA
 */
 
 #pragma once
+#include <stdint.h>
 #include "ps2_KeyboardOutput.h"
 
 namespace ps2
@@ -239,7 +240,9 @@ namespace ps2
         KeyCode modifiers = PS2_NONE;
 
     public:
-        NeutralTranslator() { }
+        NeutralTranslator() {
+            this->reset();
+        }
 
         /**
          * If a scancode is read from the PS2 interface itself, it should be sent here.
@@ -310,6 +313,10 @@ namespace ps2
             return result;
         }
 
+        /** \brief Forgets any partially-received multi-byte sequence.  Call this when
+         *         \ref Keyboard::readScanCode returns garbled, as a byte of the sequence
+         *         may have been lost.
+         */
         void reset()
         {
             this->isUnmake = false;
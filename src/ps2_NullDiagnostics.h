@@ -17,7 +17,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
 #pragma once
-#include <stdint.h>
+#include "ps2_Platform.h"
 #include "ps2_KeyboardLeds.h"
 #include "ps2_KeyboardOutput.h"
 
@@ -59,6 +59,26 @@ namespace ps2 {
         void receivedByte(byte b) {}
         void clockLineGlitch(uint8_t numBitsSent) {}
 
+        //-------------------------------------------------------------------------------
+        // Everything from here down is optional - a diagnostics class that leaves any of these
+        //  out still compiles, and the library just doesn't make that call.
+
+        void dequeuedByte(byte b) {}
+
+        // The keyboard asked for a byte to be sent again (or it didn't get it right), so it was.
+        //  retryNumber is 1 for the first retry of the byte, 2 for the second and so on.
+        void sendRetried(byte b, uint8_t retryNumber) {}
+
+        //-------------------------------------------------------------------------------
+        // Performance hooks.  These get called on every clock interrupt, so implementations
+        //  that don't care about timing should leave them empty, as they are here.
+
+        void readInterruptStarted() {}
+        void readInterruptCompleted() {}
+        void writeInterruptStarted() {}
+        void writeInterruptCompleted() {}
+        void bufferDepth(uint8_t numBytesQueued) {}
+
         // Only the Null class should provide this interface.  Note that this implementation
         //  returns something bogus, which is only okay because all of the implementations are empty,
         //  and get optimized away by the compiler.
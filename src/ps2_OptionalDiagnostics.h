@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include "ps2_Platform.h"
+
+namespace ps2 {
+    /** @private
+     *  Calls the diagnostics methods that were added after the original set - the ones from
+     *  dequeuedByte on in \ref NullDiagnostics.  A Diagnostics class written before they
+     *  existed doesn't have them, so each of these compiles to nothing unless the class (or a
+     *  base of it) has the method.  Where it does, the int overload of the ...IfDeclared pair is
+     *  the better match for the 0 that's passed; where it doesn't, that one drops out and the
+     *  ... one is left.
+     */
+    namespace optionalDiagnostics {
+        template <typename D>
+        inline auto dequeuedByteIfDeclared(D *diagnostics, byte b, int) -> decltype(diagnostics->dequeuedByte(b), void()) {
+            diagnostics->dequeuedByte(b);
+        }
+        template <typename D>
+        inline void dequeuedByteIfDeclared(D *, byte, ...) {}
+        template <typename D>
+        inline void dequeuedByte(D *diagnostics, byte b) {
+            dequeuedByteIfDeclared(diagnostics, b, 0);
+        }
+
+        template <typename D>
+        inline auto sendRetriedIfDeclared(D *diagnostics, byte b, uint8_t retryNumber, int) -> decltype(diagnostics->sendRetried(b, retryNumber), void()) {
+            diagnostics->sendRetried(b, retryNumber);
+        }
+        template <typename D>
+        inline void sendRetriedIfDeclared(D *, byte, uint8_t, ...) {}
+        template <typename D>
+        inline void sendRetried(D *diagnostics, byte b, uint8_t retryNumber) {
+            sendRetriedIfDeclared(diagnostics, b, retryNumber, 0);
+        }
+
+        template <typename D>
+        inline auto readInterruptStartedIfDeclared(D *diagnostics, int) -> decltype(diagnostics->readInterruptStarted(), void()) {
+            diagnostics->readInterruptStarted();
+        }
+        template <typename D>
+        inline void readInterruptStartedIfDeclared(D *, ...) {}
+        template <typename D>
+        inline void readInterruptStarted(D *diagnostics) {
+            readInterruptStartedIfDeclared(diagnostics, 0);
+        }
+
+        template <typename D>
+        inline auto readInterruptCompletedIfDeclared(D *diagnostics, int) -> decltype(diagnostics->readInterruptCompleted(), void()) {
+            diagnostics->readInterruptCompleted();
+        }
+        template <typename D>
+        inline void readInterruptCompletedIfDeclared(D *, ...) {}
+        template <typename D>
+        inline void readInterruptCompleted(D *diagnostics) {
+            readInterruptCompletedIfDeclared(diagnostics, 0);
+        }
+
+        template <typename D>
+        inline auto writeInterruptStartedIfDeclared(D *diagnostics, int) -> decltype(diagnostics->writeInterruptStarted(), void()) {
+            diagnostics->writeInterruptStarted();
+        }
+        template <typename D>
+        inline void writeInterruptStartedIfDeclared(D *, ...) {}
+        template <typename D>
+        inline void writeInterruptStarted(D *diagnostics) {
+            writeInterruptStartedIfDeclared(diagnostics, 0);
+        }
+
+        template <typename D>
+        inline auto writeInterruptCompletedIfDeclared(D *diagnostics, int) -> decltype(diagnostics->writeInterruptCompleted(), void()) {
+            diagnostics->writeInterruptCompleted();
+        }
+        template <typename D>
+        inline void writeInterruptCompletedIfDeclared(D *, ...) {}
+        template <typename D>
+        inline void writeInterruptCompleted(D *diagnostics) {
+            writeInterruptCompletedIfDeclared(diagnostics, 0);
+        }
+
+        template <typename D>
+        inline auto bufferDepthIfDeclared(D *diagnostics, uint8_t numBytesQueued, int) -> decltype(diagnostics->bufferDepth(numBytesQueued), void()) {
+            diagnostics->bufferDepth(numBytesQueued);
+        }
+        template <typename D>
+        inline void bufferDepthIfDeclared(D *, uint8_t, ...) {}
+        template <typename D>
+        inline void bufferDepth(D *diagnostics, uint8_t numBytesQueued) {
+            bufferDepthIfDeclared(diagnostics, numBytesQueued, 0);
+        }
+    }
+}
@@ -17,6 +17,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
 #pragma once
+#include <stdint.h>
 namespace ps2 {
 
     enum class Parity : uint8_t {
@@ -26,5 +27,6 @@ namespace ps2 {
     inline Parity operator^=(Parity& a, int bit)
     {
         a = bit ? ((a == Parity::odd) ? Parity::even : Parity::odd) : a;
+        return a;
     }
 }
@@ -0,0 +1,298 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+#include "ps2_Platform.h"
+#include "ps2_KeyboardOutput.h"
+
+namespace ps2 {
+    /** \brief A recorder that keeps performance counters rather than an event log.
+     *
+     *  \details
+     *   Where \ref SimpleDiagnostics records what happened, this class records how much
+     *   and how fast.  It uses a fixed amount of memory no matter how long it runs, so it's
+     *   suited to units that stay in the field for a long time between reports.  It keeps:
+     *
+     *   - A count of each kind of event (saturating at 0xffff).
+     *   - The high-water mark of the keyboard's input buffer.  If this reaches the
+     *     BufferSize you gave to \ref Keyboard, then you've either overflowed or come close.
+     *   - A histogram of the time between bytes received from the keyboard.  Bucket 0 counts
+     *     gaps under 1ms (e.g. the bytes within a multi-byte sequence), bucket N counts gaps
+     *     from 2^(N-1) to 2^N milliseconds, and the last bucket counts everything longer.
+     *   - The minimum, mean and maximum time spent in the read and write interrupt handlers.
+     *
+     *   The interrupt timings are in CPU cycles, counted by Timer1, which \ref begin sets to
+     *   run at the CPU clock.  That takes Timer1 away from anything else, such as PWM on
+     *   pins 9 and 10 of an Uno or the Servo library.  The mean is a running one:  once
+     *   65534 samples have been taken, the sum and the count are both halved, so it keeps
+     *   following the traffic for as long as the unit runs, with the older samples counting
+     *   for less.
+     *
+     *  \code
+     *   static ps2::PerfDiagnostics diagnostics;
+     *   static ps2::Keyboard<4,2,16,ps2::PerfDiagnostics> ps2Keyboard(diagnostics);
+     *
+     *   void setup() {
+     *     diagnostics.begin();
+     *     ps2Keyboard.begin();
+     *   }
+     *
+     *   void loop() {
+     *     if ( <magic-user-gesture> ) {
+     *       diagnostics.sendReport(Serial);
+     *       diagnostics.reset();
+     *     }
+     *   }
+     *  \endcode
+     */
+    class PerfDiagnostics
+    {
+    public:
+        /** \brief The events that are counted, in the order they appear in \ref sendReport. */
+        enum class Counter : uint8_t {
+            packetDidNotStartWithZero = 0,
+            parityError = 1,
+            packetDidNotEndWithOne = 2,
+            packetIncomplete = 3,
+            sendFrameError = 4,
+            bufferOverflow = 5,
+            incorrectResponse = 6,
+            noResponse = 7,
+            noTranslationForKey = 8,
+            startupFailure = 9,
+            sentByte = 10,
+            receivedByte = 11,
+            clockLineGlitch = 12,
+            sendRetried = 13,
+            _count = 14,
+        };
+
+        static const uint8_t numIntervalBuckets = 12;
+
+    private:
+        struct InterruptTiming {
+            uint16_t minCycles;
+            uint16_t maxCycles;
+            uint16_t numSamples;
+            uint32_t totalCycles;
+            uint16_t startCycle;
+        };
+
+        uint16_t counts[(uint8_t)Counter::_count];
+        uint16_t intervalHistogram[numIntervalBuckets];
+        uint8_t bufferHighWaterMark;
+        uint32_t microsAtLastReceivedByte;
+        InterruptTiming readTiming;
+        InterruptTiming writeTiming;
+
+        void count(Counter counter) {
+            uint16_t &c = this->counts[(uint8_t)counter];
+            if (c != 0xffff) {
+                ++c;
+            }
+        }
+
+        static void startTiming(InterruptTiming &timing) {
+            timing.startCycle = TCNT1;
+        }
+
+        static void stopTiming(InterruptTiming &timing) {
+            // Unsigned 16-bit arithmetic takes care of the counter wrapping once;  the handlers
+            //  aren't going to run for 65536 cycles.
+            uint16_t elapsed = TCNT1 - timing.startCycle;
+            if (elapsed < timing.minCycles) {
+                timing.minCycles = elapsed;
+            }
+            if (elapsed > timing.maxCycles) {
+                timing.maxCycles = elapsed;
+            }
+            if (timing.numSamples == 0xfffe) {
+                // Halving both keeps the mean where it was and makes room for more samples.
+                timing.numSamples = 0x7fff;
+                timing.totalCycles >>= 1;
+            }
+            ++timing.numSamples;
+            timing.totalCycles += elapsed;
+        }
+
+        static void resetTiming(InterruptTiming &timing) {
+            timing.minCycles = 0xffff;
+            timing.maxCycles = 0;
+            timing.numSamples = 0;
+            timing.totalCycles = 0;
+        }
+
+        template <typename Target>
+        static void sendTiming(Target &printTo, const InterruptTiming &timing) {
+            uint16_t minCycles;
+            uint16_t maxCycles;
+            uint16_t numSamples;
+            uint32_t totalCycles;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                minCycles = timing.minCycles;
+                maxCycles = timing.maxCycles;
+                numSamples = timing.numSamples;
+                totalCycles = timing.totalCycles;
+            }
+            printTo.print(numSamples == 0 ? 0 : minCycles, 16);
+            printTo.print(",");
+            printTo.print(numSamples == 0 ? 0 : (uint16_t)((totalCycles + numSamples / 2) / numSamples), 16);
+            printTo.print(",");
+            printTo.print(maxCycles, 16);
+        }
+
+    public:
+        PerfDiagnostics() {
+            this->reset();
+        }
+
+        /** \brief Sets Timer1 counting CPU cycles, for the interrupt timings.  Call it from
+         *         setup(); the Arduino core sets Timer1 up for PWM before setup runs.
+         */
+        void begin() {
+            TCCR1A = 0;
+            TCCR1B = _BV(CS10);
+        }
+
+        /** \brief Dumps the counters to a print-based class.
+         *  \details
+         *   The format is compact rather than pretty:
+         *
+         *      {counts|high-water-mark|interval-histogram|read-min,mean,max|write-min,mean,max}
+         *
+         *   Where counts and interval-histogram are comma-separated lists.  All numbers are in
+         *   hex, and the interrupt timings are in CPU cycles, from the start of the handler's
+         *   work to the end of it.  Getting into and out of the interrupt isn't counted; that
+         *   costs the same whatever the handler does.
+         */
+        template <typename Target>
+        void sendReport(Target &printTo) {
+            printTo.print("{");
+            for (uint8_t i = 0; i < (uint8_t)Counter::_count; ++i) {
+                if (i > 0) {
+                    printTo.print(",");
+                }
+                printTo.print(this->getCount((Counter)i), 16);
+            }
+            printTo.print("|");
+            printTo.print(this->bufferHighWaterMark, 16);
+            printTo.print("|");
+            for (uint8_t i = 0; i < numIntervalBuckets; ++i) {
+                uint16_t value;
+                ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                    value = this->intervalHistogram[i];
+                }
+                if (i > 0) {
+                    printTo.print(",");
+                }
+                printTo.print(value, 16);
+            }
+            printTo.print("|");
+            sendTiming(printTo, this->readTiming);
+            printTo.print("|");
+            sendTiming(printTo, this->writeTiming);
+            printTo.print("}");
+        }
+
+        /** \brief Returns the number of times the given event has happened since the last \ref reset. */
+        uint16_t getCount(Counter counter) const {
+            uint16_t value;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                value = this->counts[(uint8_t)counter];
+            }
+            return value;
+        }
+
+        /** \brief Returns the largest number of bytes that have been waiting in the input buffer. */
+        uint8_t getBufferHighWaterMark() const { return this->bufferHighWaterMark; }
+
+        /** \brief Returns true if any errors have been recorded since the last call to \ref reset. */
+        bool anyErrors() const {
+            for (uint8_t i = 0; i < (uint8_t)Counter::sentByte; ++i) {
+                if (this->getCount((Counter)i) != 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /** \brief Clears all the counters. */
+        void reset() {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                for (uint8_t i = 0; i < (uint8_t)Counter::_count; ++i) {
+                    this->counts[i] = 0;
+                }
+                for (uint8_t i = 0; i < numIntervalBuckets; ++i) {
+                    this->intervalHistogram[i] = 0;
+                }
+                this->bufferHighWaterMark = 0;
+                this->microsAtLastReceivedByte = micros();
+                resetTiming(this->readTiming);
+                resetTiming(this->writeTiming);
+            }
+        }
+
+        void packetDidNotStartWithZero() { this->count(Counter::packetDidNotStartWithZero); }
+        void parityError() { this->count(Counter::parityError); }
+        void packetDidNotEndWithOne() { this->count(Counter::packetDidNotEndWithOne); }
+        void packetIncomplete() { this->count(Counter::packetIncomplete); }
+        void sendFrameError() { this->count(Counter::sendFrameError); }
+        void bufferOverflow() { this->count(Counter::bufferOverflow); }
+        void incorrectResponse(KeyboardOutput scanCode, KeyboardOutput expectedScanCode) {
+            this->count(Counter::incorrectResponse);
+        }
+        void noResponse(KeyboardOutput expectedScanCode) { this->count(Counter::noResponse); }
+        void noTranslationForKey(bool isExtended, KeyboardOutput code) {
+            this->count(Counter::noTranslationForKey);
+        }
+        void startupFailure() { this->count(Counter::startupFailure); }
+        void clockLineGlitch(uint8_t numBitsSent) { this->count(Counter::clockLineGlitch); }
+        void sentByte(byte b) { this->count(Counter::sentByte); }
+        void dequeuedByte(byte b) {}
+        void sendRetried(byte b, uint8_t retryNumber) { this->count(Counter::sendRetried); }
+
+        void receivedByte(byte b) {
+            this->count(Counter::receivedByte);
+
+            uint32_t microsNow = micros();
+            uint32_t interval = (microsNow - this->microsAtLastReceivedByte) >> 10;
+            this->microsAtLastReceivedByte = microsNow;
+
+            uint8_t bucket = 0;
+            while (interval != 0 && bucket < numIntervalBuckets - 1) {
+                interval >>= 1;
+                ++bucket;
+            }
+            if (this->intervalHistogram[bucket] != 0xffff) {
+                ++this->intervalHistogram[bucket];
+            }
+        }
+
+        void readInterruptStarted() { startTiming(this->readTiming); }
+        void readInterruptCompleted() { stopTiming(this->readTiming); }
+        void writeInterruptStarted() { startTiming(this->writeTiming); }
+        void writeInterruptCompleted() { stopTiming(this->writeTiming); }
+
+        void bufferDepth(uint8_t numBytesQueued) {
+            if (numBytesQueued > this->bufferHighWaterMark) {
+                this->bufferHighWaterMark = numBytesQueued;
+            }
+        }
+    };
+}
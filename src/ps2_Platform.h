@@ -0,0 +1,48 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+// Everything this library uses from the Arduino core and avr-libc comes in through this file,
+//  so that's the only thing that needs to be stood in for to compile the library somewhere
+//  else - e.g. on a PC, to test it.  Outside of the Arduino build (when ARDUINO isn't defined)
+//  it picks up whatever Arduino.h and util/atomic.h are on the include path; extras/host has
+//  a set that simulates the pins, the clock and the interrupts, which is what the tests and
+//  simulations under extras use (see CMakeLists.txt).  A stand-in needs to provide:
+//
+//   - byte, HIGH, LOW, INPUT_PULLUP, OUTPUT, FALLING, LED_BUILTIN
+//   - pinMode, digitalRead, digitalWrite
+//   - portInputRegister, digitalPinToPort, digitalPinToBitMask (the read interrupt handler
+//     uses these to sample the data pin quickly)
+//   - attachInterrupt, detachInterrupt, digitalPinToInterrupt
+//   - millis, micros, delayMicroseconds
+//   - PROGMEM and pgm_read_byte
+//   - ATOMIC_BLOCK and ATOMIC_FORCEON
+//
+//  PerfDiagnostics also uses Timer1 (TCNT1, TCCR1A, TCCR1B, CS10 and _BV), EepromDiagnostics
+//  uses avr/eeprom.h, and it and StreamingDiagnostics use util/crc16.h.
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h" // for attachInterrupt, FALLING, HIGH & LOW
+#elif defined(ARDUINO)
+#include "WProgram.h"
+#else
+#include "Arduino.h"
+#endif
+#include <stdint.h>
+#include <util/atomic.h>
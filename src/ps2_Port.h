@@ -0,0 +1,788 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+
+#include "ps2_Platform.h"
+#include "ps2_NullDiagnostics.h"
+#include "ps2_OptionalDiagnostics.h"
+#include "ps2_KeyboardOutput.h"
+#include "ps2_Parity.h"
+#include "ps2_KeyboardOutputBuffer.h"
+
+namespace ps2 {
+    /**
+     * \brief
+     *  The part of the PS2 protocol that's the same for every kind of device:  clocking bytes
+     *  in and out over the two wires, buffering what comes in, acknowledgements, retries and
+     *  recovering from errors on the line.  \ref Keyboard and \ref Mouse are built on it, and
+     *  its public methods are available on both.
+     *
+     * \tparam DataPin The pin number of the pin that's connected to the PS2 data wire.
+     * \tparam ClockPin The pin number of the pin that's connected to the PS2 clock wire.  This
+     *                  pin must be one that supports interrupts on your board.
+     * \tparam BufferSize The number of bytes that can be held between the interrupt handler
+     *                    and the device class's read method.
+     * \tparam Diagnostics A class that records what happens on the line; see \ref Keyboard.
+     */
+    template<int DataPin, int ClockPin, int BufferSize = 16, typename Diagnostics = NullDiagnostics>
+    class Port {
+        static_assert(BufferSize >= 1 && BufferSize <= 255, "BufferSize must be between 1 and 255");
+
+    protected:
+
+        static const uint8_t immediateResponseTimeInMilliseconds = 10;
+
+        // The clock runs between 10 and 16.7KHz, depending on the keyboard.  Rather than plan
+        //  for the slowest, the time each good frame takes is measured, and the timing of the
+        //  error handling follows a running average of it.  These are the limits on what's
+        //  believable as a frame's length (10 clock periods); they're a little wider than the
+        //  spec allows for.
+        static const uint16_t minFrameMicroseconds = 400;
+        static const uint16_t maxFrameMicroseconds = 2000;
+
+        Diagnostics *diagnostics;
+
+        // These are not marked as volatile because they are only modified in the interrupt
+        // handler and at startup (before the interrupt handler is enabled).
+        uint8_t ioByte = 0;
+        uint8_t bitCounter = 0;
+        uint32_t lastReadInterruptMicroseconds = 0;
+        uint32_t frameStartMicroseconds = 0;
+        Parity parity = Parity::even;
+        bool receivedHasFramingError = false;
+        bool isErrorFrameOver = false; // true once the frame with receivedHasFramingError has ended
+        bool isReading = false; // false while a byte is being sent to the keyboard
+        bool sendHasFramingError = false;
+
+        // The time from the start bit to the stop bit of the last good frame, or 0 if it's
+        //  been taken into the estimate already.
+        volatile uint16_t measuredFrameMicroseconds = 0;
+
+        // The running estimate of the keyboard's clock, starting at the slowest it could be.
+        //  A gap between bits of more than frameTimeoutMicroseconds (5 clock periods) means a
+        //  clock edge was missed.  The interrupt handler reads frameTimeoutMicroseconds, so it's
+        //  only changed with interrupts off.
+        uint16_t averageFrameMicroseconds = 1000;
+        uint16_t clockPeriodMicroseconds = 100;
+        uint16_t frameTimeoutMicroseconds = 500;
+
+        uint8_t maxSendRetries = 2;
+        uint8_t sendResponseTimeoutInMilliseconds = immediateResponseTimeInMilliseconds;
+
+        // This guy is marked volatile because it's exchanged between the interrupt handler and normal code.
+        KeyboardOutputBuffer<BufferSize, Diagnostics> inputBuffer;
+
+        // The keyboard's answers to commands go here instead, so that sending a command doesn't
+        //  disturb the keystrokes waiting in inputBuffer.  The interrupt handler puts the next
+        //  responseBytesExpected bytes here.
+        KeyboardOutputBuffer<3, Diagnostics> responseBuffer;
+        volatile uint8_t responseBytesExpected = 0;
+
+        // See enableBackpressure.  A high water mark of 0 means backpressure is off.
+        uint8_t backpressureHighWaterMark = 0;
+        uint8_t backpressureLowWaterMark = 0;
+        volatile bool isInhibited = false;
+
+        // Counts the frames that arrived with errors, or were cut short.  It's for devices that
+        //  stream bytes (like a mouse), where the next frame can finish, and clear
+        //  receivedHasFramingError, before the bad one is noticed.
+        volatile uint8_t receiveErrorCount = 0;
+
+        // Set by the interrupt handler when it had to give up on a frame that it can't ask to
+        //  have sent again (see receiveBit).  readByte reports it as garbled once the bytes
+        //  ahead of it have been read.
+        volatile bool hasLostByte = false;
+
+        // Set by the interrupt handler when a frame starts, so that dispatch can skip all the
+        //  work of readByte when nothing has come in.
+        volatile bool isInputPending = false;
+
+        // The command that asks the device to send its last byte again.  It's the same for
+        //  all devices.
+        static const uint8_t resendCommand = 0xfe;
+
+        // Called by the interrupt handler for each error it finds in a frame.
+        void noteFramingError() {
+            if (receivedHasFramingError && isErrorFrameOver) {
+                // The last bad frame was never asked for again, and asking now would get
+                //  this one instead.
+                this->hasLostByte = true;
+            }
+            receivedHasFramingError = true;
+            isErrorFrameOver = false;
+            ++this->receiveErrorCount;
+        }
+
+        void readInterruptHandler() {
+            // The timing of the PS2 keyboard is such that you really need to read the data
+            // line just as fast as possible.  If you do it with digitalRead, it'll work right
+            // almost all the time (like one character in 100 will suffer a failure - with the
+            // keyboards I have to-hand.)
+            //
+            // Although this looks fantastically more complicated than plain digitalRead, the
+            // instruction count is lower.  It'd be even lower if the methods listed here were
+            // implemented a little better (e.g. as template methods rather than macros).
+            uint8_t dataPinValue = (*portInputRegister(digitalPinToPort(DataPin)) & digitalPinToBitMask(DataPin)) ? 1 : 0; // ==digitalRead(DataPin);
+            optionalDiagnostics::readInterruptStarted(this->diagnostics);
+
+            // Pulling the clock low to hold the keyboard off makes a falling edge of our own.
+            if (!this->isInhibited) {
+                this->receiveBit(dataPinValue, micros());
+            }
+
+            optionalDiagnostics::readInterruptCompleted(this->diagnostics);
+        }
+
+        void writeInterruptHandler() {
+            int valueToSend;
+            optionalDiagnostics::writeInterruptStarted(this->diagnostics);
+
+            switch (bitCounter)
+            {
+            case 0:
+                ++bitCounter;
+                break;
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            case 8:
+                valueToSend = (this->ioByte & 1) ? HIGH : LOW;
+                this->ioByte >>= 1;
+                digitalWrite(DataPin, valueToSend);
+                parity ^= valueToSend;
+                ++bitCounter;
+                break;
+            case 9:
+                digitalWrite(DataPin, (uint8_t)parity);
+                ++bitCounter;
+                break;
+            case 10:
+                pinMode(DataPin, INPUT_PULLUP);
+                ++bitCounter;
+                break;
+            case 11:
+                if (digitalRead(DataPin) != LOW) {
+                    // The keyboard didn't acknowledge the frame.  sendData will send it again
+                    //  if the keyboard doesn't answer.
+                    this->diagnostics->sendFrameError();
+                    this->sendHasFramingError = true;
+                }
+
+                enableReadInterrupts();
+                break;
+            }
+
+            optionalDiagnostics::writeInterruptCompleted(this->diagnostics);
+        }
+
+        // Waits for a byte the keyboard is sending to finish (that takes 1.1ms at most) rather
+        //  than cut it off.  It can still start one between this check and the clock going low;
+        //  if so, it sends that byte again once it has answered the command, or sometimes
+        //  before (see expectAnswer).  A device that sends bytes back to back could keep a
+        //  frame in progress indefinitely, so this gives up after the longest a frame can take.
+        //  Code that mustn't wait at all, like the configuration restore, checks
+        //  isReceivingFrame and comes back later instead.
+        void waitForFrameToFinish() {
+            uint32_t startMicroseconds = micros();
+            while (this->isReceivingFrame() && micros() - startMicroseconds < maxFrameMicroseconds) {
+            }
+        }
+
+        // Sends a byte right away, cutting off anything the keyboard is sending.
+        void sendByte(uint8_t byte1, uint8_t responseLength = 1) {
+            detachInterrupt(digitalPinToInterrupt(ClockPin));
+            this->isReading = false;
+            this->isInhibited = false;
+
+            // Inhibit communication by pulling Clock low for at least 100 microseconds.
+            pinMode(ClockPin, OUTPUT);
+            digitalWrite(ClockPin, LOW);
+            delayMicroseconds(120);
+
+            // Make sure when interrupts resume, we start in the right state - note that we
+            //  start sending data immediately on the first byte, because we will initiate
+            //  the start bit in this clock pulse.
+            this->receivedHasFramingError = false;
+            this->sendHasFramingError = false;
+            this->responseBuffer.clear();
+            this->responseBytesExpected = responseLength;
+            this->bitCounter = 0;
+            this->parity = Parity::even;
+            this->ioByte = byte1;
+            attachInterrupt(digitalPinToInterrupt(ClockPin), Port::staticWriteInterruptHandler, FALLING);
+
+            // Apply "Request-to-send" by pulling Data low, then release Clock.
+            pinMode(DataPin, OUTPUT);
+            digitalWrite(DataPin, LOW);
+            pinMode(ClockPin, INPUT_PULLUP);
+        }
+
+        void enableReadInterrupts() {
+            this->receivedHasFramingError = false;
+            this->bitCounter = 0;
+            this->ioByte = 0;
+            this->parity = Parity::even;
+            this->isReading = true;
+
+            attachInterrupt(digitalPinToInterrupt(ClockPin), Port::staticReadInterruptHandler, FALLING);
+        }
+
+        // Holds the keyboard off by pulling the clock low.  The keyboard keeps what's typed
+        //  in the meantime and sends it once the clock is released.
+        void inhibit() {
+            this->isInhibited = true;
+            pinMode(ClockPin, OUTPUT);
+            digitalWrite(ClockPin, LOW);
+        }
+
+        void releaseInhibit() {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                // If a byte was on its way when the clock went low, the keyboard abandoned it
+                //  and will send it again from the start.
+                this->isInhibited = false;
+                this->bitCounter = 0;
+                this->ioByte = 0;
+                this->parity = Parity::even;
+            }
+            pinMode(ClockPin, INPUT_PULLUP);
+        }
+
+        // Called from readScanCode; the interrupt handler does the inhibiting as the buffer
+        //  fills, this catches the case where it filled while a command was being sent.
+        void applyBackpressure() {
+            if (this->backpressureHighWaterMark == 0 || !this->isReading || this->responseBytesExpected != 0) {
+                return;
+            }
+
+            bool shouldRelease = false;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                uint8_t count = this->inputBuffer.count();
+                if (this->isInhibited) {
+                    shouldRelease = count <= this->backpressureLowWaterMark;
+                }
+                else if (count >= this->backpressureHighWaterMark && this->bitCounter == 0) {
+                    this->inhibit();
+                }
+            }
+            if (shouldRelease) {
+                this->releaseInhibit();
+            }
+        }
+
+        // Returns how many bits of the frame being received have arrived, and how long ago the last one did.
+        uint8_t getFrameProgress(uint32_t &microsecondsSinceLastBit) {
+            uint8_t bitsReceived;
+            uint32_t lastInterruptMicroseconds;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                bitsReceived = this->isReading ? this->bitCounter : 0;
+                lastInterruptMicroseconds = this->lastReadInterruptMicroseconds;
+            }
+            microsecondsSinceLastBit = micros() - lastInterruptMicroseconds;
+            return bitsReceived;
+        }
+
+        // True if a frame was started but the clock has since gone quiet.
+        bool hasAbandonedFrame() {
+            uint32_t microsecondsSinceLastBit;
+            return this->getFrameProgress(microsecondsSinceLastBit) > 0 && microsecondsSinceLastBit > this->frameTimeoutMicroseconds;
+        }
+
+        // True if the keyboard is partway through sending a byte.
+        bool isReceivingFrame() {
+            uint32_t microsecondsSinceLastBit;
+            return this->getFrameProgress(microsecondsSinceLastBit) > 0 && microsecondsSinceLastBit <= this->frameTimeoutMicroseconds;
+        }
+
+        // Folds the length of the last good frame into the estimate of the clock period.
+        void updateClockPeriod() {
+            uint16_t sample;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                sample = this->measuredFrameMicroseconds;
+                this->measuredFrameMicroseconds = 0;
+            }
+            if (sample < minFrameMicroseconds || sample > maxFrameMicroseconds) {
+                return;
+            }
+
+            // Each new frame counts for a quarter, so a newly plugged-in keyboard is measured
+            //  within a keystroke or two, and one stretched frame doesn't move it far.
+            this->averageFrameMicroseconds += ((int16_t)(sample - this->averageFrameMicroseconds)) / 4;
+            uint16_t period = (this->averageFrameMicroseconds + 5) / 10;
+            this->clockPeriodMicroseconds = period;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                this->frameTimeoutMicroseconds = period * 5;
+            }
+        }
+
+        static Port *instance;
+
+        static void staticReadInterruptHandler() {
+            instance->readInterruptHandler();
+        }
+
+        static void staticWriteInterruptHandler() {
+            instance->writeInterruptHandler();
+        }
+
+        /** \brief  Waits for the keyboard to answer a command for a limited amount of time, and
+         *          takes the answer out of responseBuffer.
+         *  \details It takes the byte out rather than peeking at it because 0 is a legitimate
+         *           answer (a mouse's device ID, or a byte it sends again before an ack), and
+         *           peek can't tell that from an empty buffer.
+         *  \returns False if nothing showed up in the time alotted.  If there was a communication
+         *           error in that time, it returns true and sets response to garbled.
+         */
+        bool readResponse(KeyboardOutput &response, uint16_t timeoutInMilliseconds = immediateResponseTimeInMilliseconds) {
+            unsigned long startMilliseconds = millis();
+            while (!this->responseBuffer.pop(response)) {
+                if (this->receivedHasFramingError) {
+                    response = KeyboardOutput::garbled;
+                    // Note that clearing this is intended to prevent future polling from trying to get the
+                    //  bad character re-sent, but it might not work, depending on the nature of the error.
+                    //  Future interrupts could set it again.
+                    this->receivedHasFramingError = false;
+                    return true;
+                }
+                if (millis() - startMilliseconds > timeoutInMilliseconds) {
+                    // Whatever comes later isn't an answer to anything.
+                    this->responseBytesExpected = 0;
+                    this->diagnostics->noResponse(KeyboardOutput::none);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Hands a byte that came in while waiting for an answer over to readScanCode.
+        void passResponseAlong(KeyboardOutput response) {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                this->inputBuffer.push(response);
+            }
+        }
+
+        // Waits for the keyboard to answer the byte just sent with the given response, or to
+        //  ask for it again.  The keyboard is supposed to answer before it sends anything else,
+        //  but if sending the byte cut it off partway through one of its own, some keyboards
+        //  send that byte again first, so anything else is passed along to readScanCode.
+        //  Returns false if the keyboard didn't answer; otherwise response is the answer or nack.
+        bool expectAnswer(KeyboardOutput answer, KeyboardOutput &response, uint16_t timeoutInMilliseconds) {
+            while (this->readResponse(response, timeoutInMilliseconds)) {
+                if (response == answer || response == KeyboardOutput::nack) {
+                    return true;
+                }
+                this->passResponseAlong(response);
+                ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                    ++this->responseBytesExpected;
+                }
+            }
+            return false;
+        }
+
+        /** \brief Waits a limited amount of time for a specific byte to be written by the keyboard.
+         *         If it appears, this method returns true.  If a different keycode appears, it will return
+         *         false and pass that byte along to readScanCode.
+         */
+        bool expectResponse(KeyboardOutput expectedResponse, uint16_t timeoutInMilliseconds = immediateResponseTimeInMilliseconds) {
+            KeyboardOutput actualResponse;
+            if (!this->readResponse(actualResponse, timeoutInMilliseconds)) {
+                // diagnostics already reported
+                return false;
+            }
+            else if ( actualResponse != expectedResponse ) {
+                this->diagnostics->incorrectResponse(actualResponse, expectedResponse);
+                this->passResponseAlong(actualResponse);
+                return false;
+            }
+            else {
+                return true;
+            }
+        }
+
+        // Sends a byte and waits for the ack.  responseLength is the number of bytes the keyboard
+        //  answers with, including the ack; the ones after it are left in responseBuffer.
+        bool sendData(byte data, uint8_t responseLength = 1) {
+            for (uint8_t retryNumber = 0; ; ++retryNumber) {
+                if (retryNumber > 0) {
+                    optionalDiagnostics::sendRetried(this->diagnostics, data, retryNumber);
+                }
+                this->diagnostics->sentByte(data);
+                this->waitForFrameToFinish();
+                this->sendByte(data, responseLength);
+
+                KeyboardOutput response;
+                bool isAnswered = this->expectAnswer(KeyboardOutput::ack, response, this->sendResponseTimeoutInMilliseconds);
+                if (isAnswered && response == KeyboardOutput::ack) {
+                    return true;
+                }
+
+                // The keyboard asks for a resend if the byte didn't reach it intact.  Note that
+                //  resend has the same value as garbled, which is what we get when its answer
+                //  didn't reach us intact, and that's worth a retry too.  If the keyboard didn't
+                //  acknowledge the frame and then said nothing, it probably never saw the byte,
+                //  so that's worth a retry as well.
+                bool isWorthRetrying = isAnswered ? response == KeyboardOutput::nack : this->sendHasFramingError;
+                if (isAnswered) {
+                    this->diagnostics->incorrectResponse(response, KeyboardOutput::ack);
+                }
+                if (!isWorthRetrying || retryNumber >= this->maxSendRetries) {
+                    if (!this->isReading) {
+                        // The keyboard never clocked the byte in.
+                        this->enableReadInterrupts();
+                    }
+                    return false;
+                }
+            }
+        }
+
+        void sendNack() {
+            this->diagnostics->sentByte(resendCommand);
+            // The keyboard answers by sending its last byte again, which is for readScanCode.
+            this->sendByte(resendCommand, 0);
+        }
+
+        // Returns true if the interrupt handler has started receiving anything since the last
+        //  call.  A frame that's only partly received, or that had an error, keeps it true,
+        //  since readByte still has to look at it even if no more clock edges come.
+        bool takePendingInput() {
+            if (!this->isInputPending) {
+                return false;
+            }
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                if (this->bitCounter == 0 && !this->receivedHasFramingError && !this->hasLostByte) {
+                    this->isInputPending = false;
+                }
+            }
+            return true;
+        }
+
+        // Returns true if dispatch would find something to do.  A frame that's still arriving
+        //  doesn't count, as long as nothing is waiting behind it, since its next clock edge
+        //  will wake the processor anyway.
+        bool hasPendingInput() const {
+            if (!this->isInputPending) {
+                return false;
+            }
+            bool hasInput;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                hasInput = this->bitCounter == 0 || this->receivedHasFramingError || this->hasLostByte || this->inputBuffer.count() != 0;
+            }
+            return hasInput;
+        }
+
+        // Takes the next byte out of the buffer, dealing with any errors receiving it on the
+        //  way.  While a command is in progress, errors are its to deal with.  Returns false
+        //  if there was nothing to read, in which case code is none, or garbled if there was
+        //  an error.
+        bool readByte(bool isCommandInProgress, KeyboardOutput &code) {
+            this->updateClockPeriod();
+
+            bool isAvailable = this->inputBuffer.pop(code);
+            this->applyBackpressure();
+
+            if (!isAvailable && !isCommandInProgress && this->hasLostByte) {
+                // The interrupt handler already started on the next frame, so all that can be
+                //  done is to say so.
+                this->hasLostByte = false;
+                code = KeyboardOutput::garbled;
+                return false;
+            }
+            else if (!isAvailable && !isCommandInProgress && this->receivedHasFramingError)
+            {
+                // A resend request makes the keyboard send the last byte it finished sending.
+                //  Once the bad frame is over, and for as long as the flag stays set, no other
+                //  frame has finished since, so it's safe to ask even if that means cutting off
+                //  the frame after it, which the keyboard then sends again.  Ignoring the clock
+                //  from here on makes sure that frame can't finish before the request goes out.
+                bool isBadFrameOver;
+                ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                    isBadFrameOver = this->receivedHasFramingError && this->isErrorFrameOver;
+                    if (isBadFrameOver) {
+                        this->isInhibited = true;
+                    }
+                }
+                if (isBadFrameOver) {
+                    this->sendNack();
+                    code = KeyboardOutput::garbled;
+                    return false;
+                }
+                if (!this->receivedHasFramingError) {
+                    // Too late; the interrupt handler has set hasLostByte instead.
+                    return false;
+                }
+
+                // If we ask while the bad frame is still coming in, we cut it off, and the
+                //  keyboard sends the byte before it instead.  Errors are often caught before
+                //  the end of the frame (a bad start bit is caught at the first clock), so wait
+                //  until the clock has been quiet for a clock period and a half - long enough
+                //  to know the frame is over, but no longer, since keystrokes are waiting.
+                uint32_t microsecondsSinceLastBit;
+                uint8_t bitsReceived = this->getFrameProgress(microsecondsSinceLastBit);
+                if (microsecondsSinceLastBit < this->clockPeriodMicroseconds + this->clockPeriodMicroseconds / 2) {
+                    return false;
+                }
+                if (bitsReceived == 0 || bitsReceived > 3) {
+                    // The clock stopped partway through the frame, but enough of it arrived
+                    //  to be sure it was a frame and not a glitch.
+                    this->sendNack();
+                }
+                else {
+                    this->diagnostics->clockLineGlitch(this->bitCounter);
+                    this->receivedHasFramingError = false;
+                    this->bitCounter = 0;
+                    this->ioByte = 0;
+                    this->parity = Parity::even;
+                }
+                code = KeyboardOutput::garbled;
+                return false;
+            }
+            else if (!isAvailable && !isCommandInProgress && this->hasAbandonedFrame()) {
+                // The keyboard stopped clocking in the middle of a byte, which means we missed
+                //  an edge.  It's done sending, so asking for the byte again is safe, provided
+                //  enough of it arrived to be sure it wasn't just noise on the clock line.
+                this->diagnostics->packetIncomplete();
+                if (this->bitCounter > 3) {
+                    this->sendNack();
+                }
+                else {
+                    this->diagnostics->clockLineGlitch(this->bitCounter);
+                    this->bitCounter = 0;
+                    this->ioByte = 0;
+                    this->parity = Parity::even;
+                }
+                code = KeyboardOutput::garbled;
+                return false;
+            }
+            return isAvailable;
+        }
+
+    public:
+        Port(Diagnostics &diagnostics)
+            : inputBuffer(diagnostics), responseBuffer(diagnostics)
+        {
+            this->diagnostics = &diagnostics;
+            instance = this;
+        }
+
+        /**
+         * Starts the device "service" by registering the external interrupt.
+         * setting the pin modes correctly and driving those needed to high.
+         * The best place to call this method is in the setup routine.
+         */
+        void begin() {
+            pinMode(ClockPin, INPUT_PULLUP);
+            pinMode(DataPin, INPUT_PULLUP);
+
+            // If the pin that support PWM output, we need to turn it off
+            // before getting a digital reading.  DigitalRead does that
+            digitalRead(DataPin);
+
+            this->enableReadInterrupts();
+        }
+
+        /** \brief Sets how hard the setup methods try to get each byte through.
+         *  \param maxRetries The number of times a byte is sent again after the device
+         *                    asks for a resend or the frame isn't acknowledged.  The default
+         *                    is 2; 0 turns retrying off.
+         *  \param responseTimeoutInMilliseconds How long to wait for the device to respond
+         *                    to each byte.  The default is 10.
+         *  \details
+         *   Retries are reported to the Diagnostics class through sendRetried.  Note that a
+         *   setup method can take up to (maxRetries + 1) * (responseTimeoutInMilliseconds + 2)
+         *   per byte to fail:  each try first waits up to 2ms for a byte the device is sending
+         *   to finish.
+         */
+        void setSendRetryPolicy(uint8_t maxRetries, uint8_t responseTimeoutInMilliseconds) {
+            this->maxSendRetries = maxRetries;
+            this->sendResponseTimeoutInMilliseconds = responseTimeoutInMilliseconds;
+        }
+
+        /** \brief Makes the keyboard wait, rather than lose keystrokes, when the buffer fills up.
+         *  \param highWaterMark When this many bytes are waiting to be read, the clock line is
+         *                       held low, which tells the keyboard to stop sending.  The default
+         *                       is BufferSize.
+         *  \param lowWaterMark Once \ref Keyboard::readScanCode (or \ref Mouse::readPacket) has
+         *                      taken the buffer down to this many bytes, the clock is released
+         *                      and the keyboard sends what it has been holding.  The default is
+         *                      half of BufferSize.
+         *  \details
+         *   Without this, a byte that arrives when the buffer is full overwrites the oldest one
+         *   (and is reported through bufferOverflow).  With it, a loop() that sometimes stalls -
+         *   on a USB transfer, a display update and so on - delays keystrokes instead of losing
+         *   them.  Keyboards buffer at least 16 bytes of their own, so it's good for about 4
+         *   keystrokes' worth of stall on top of what BufferSize holds.  extras/tests/KeyboardTest
+         *   types a minute of bursts against a loop() that stalls, with and without it, and
+         *   prints how many bytes each loses.
+         *
+         *   Commands sent to the keyboard take over the clock line, so if the buffer is full
+         *   when one is sent, the keyboard may get a byte in between its answer and the next
+         *   call to readScanCode.  If you send commands while the keyboard may be typing (e.g.
+         *   \ref Keyboard::queueLedStatus), leave room for that by setting highWaterMark a
+         *   byte or two below BufferSize.
+         */
+        void enableBackpressure(uint8_t highWaterMark = BufferSize, uint8_t lowWaterMark = BufferSize / 2) {
+            if (highWaterMark > BufferSize || highWaterMark == 0) {
+                highWaterMark = BufferSize;
+            }
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                this->backpressureLowWaterMark = lowWaterMark < highWaterMark ? lowWaterMark : highWaterMark - 1;
+                this->backpressureHighWaterMark = highWaterMark;
+            }
+        }
+
+        /** \brief Goes back to dropping the oldest byte when the buffer overflows. */
+        void disableBackpressure() {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                this->backpressureHighWaterMark = 0;
+            }
+            if (this->isInhibited) {
+                this->releaseInhibit();
+            }
+        }
+
+        /** \brief Returns the device's clock period, as measured from the frames it has sent.
+         *  \details This is what decides how long to wait before asking for a garbled byte
+         *           again, and how long a gap between bits means an edge was missed.  Until
+         *           the device has sent something, it's 100us, the slowest the spec allows.
+         */
+        uint16_t getClockPeriodInMicroseconds() const {
+            return this->clockPeriodMicroseconds;
+        }
+
+        /** \brief Feeds one falling edge of the clock line to the receiver.
+         *  \param dataPinValue The state of the data line at the edge (0 or 1).
+         *  \param nowMicroseconds The time of the edge, on the micros() clock.
+         *  \details
+         *   The read interrupt handler calls this for every edge; you shouldn't call it while
+         *   \ref begin has the interrupt enabled.  It's public so that the protocol decoding can
+         *   be driven from something other than the pins - for example, to run a waveform
+         *   recorded with a logic analyzer through exactly the code the device runs, and see the
+         *   bytes and diagnostics it would have produced.  The bytes end up in the buffer, so
+         *   they're retrieved with \ref Keyboard::readScanCode as usual.
+         */
+        void receiveBit(uint8_t dataPinValue, uint32_t nowMicroseconds) {
+            // If an edge got lost (say because another interrupt handler ran long), the frame
+            //  we're assembling will never complete.  Left alone, the next frame's start bit
+            //  would be taken for one of this frame's bits and every byte after it would be
+            //  misaligned until a framing error happened to knock it back into step.  Since the
+            //  bits within a frame are never more than 100us apart, a long gap means this edge
+            //  has to be the start of a new frame.  The lost byte can't be recovered at this
+            //  point, but at least the next one will be read correctly.  hasLostByte tells
+            //  readByte to return garbled, so that readScanCode's caller knows to resynchronize.
+            if (bitCounter > 0 && nowMicroseconds - lastReadInterruptMicroseconds > this->frameTimeoutMicroseconds) {
+                this->diagnostics->packetIncomplete();
+                this->hasLostByte = true;
+                receivedHasFramingError = false;
+                ++this->receiveErrorCount;
+                bitCounter = 0;
+                ioByte = 0;
+            }
+            lastReadInterruptMicroseconds = nowMicroseconds;
+
+            switch (bitCounter)
+            {
+            case 0:
+                // A framing error from the last frame stays set through this one, so that
+                //  readByte can still ask for that frame again (see case 10).
+                if (dataPinValue != 0) {
+                    this->diagnostics->packetDidNotStartWithZero();
+
+                    // If we get a failure here, it should mean that previous byte is
+                    // not actually framed correctly and the stop bit and parity bit somehow
+                    // matched our expectations (or maybe they didn't and we got here anyway?)
+                    this->noteFramingError();
+                }
+                frameStartMicroseconds = nowMicroseconds;
+                this->isInputPending = true;
+                ++bitCounter;
+                parity = Parity::even;
+                break;
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            case 8:
+                // Bits arrive least-significant first, so shift each one in from the top.  AVR
+                //  can only shift one place per instruction, so this is much quicker than
+                //  or-ing in (1 << (bitCounter - 1)).
+                ioByte >>= 1;
+                if (dataPinValue)
+                {
+                    ioByte |= 0x80;
+                    parity ^= 1;
+                }
+                ++bitCounter;
+                break;
+            case 9:
+                if (parity != (Parity)dataPinValue) {
+                    this->diagnostics->parityError();
+                    this->noteFramingError();
+                }
+                ++bitCounter;
+                break;
+            case 10:
+                if (dataPinValue == 0) {
+                    this->diagnostics->packetDidNotEndWithOne();
+                    this->noteFramingError();
+                }
+
+                if (receivedHasFramingError && !isErrorFrameOver) {
+                    // This frame is the bad one.  readByte asks for it again.
+                    isErrorFrameOver = true;
+                }
+                else {
+                    if (receivedHasFramingError) {
+                        // A good frame came after the bad one before readByte got to it, so
+                        //  a resend request would get this one back, not the bad one.
+                        receivedHasFramingError = false;
+                        this->hasLostByte = true;
+                    }
+
+                    this->measuredFrameMicroseconds = (uint16_t)(nowMicroseconds - frameStartMicroseconds);
+                    this->diagnostics->receivedByte(ioByte);
+                    if (this->responseBytesExpected > 0) {
+                        --this->responseBytesExpected;
+                        this->responseBuffer.push((KeyboardOutput)ioByte);
+                    }
+                    else {
+                        this->inputBuffer.push((KeyboardOutput)ioByte);
+                        uint8_t count = this->inputBuffer.count();
+                        optionalDiagnostics::bufferDepth(this->diagnostics, count);
+                        if (count >= this->backpressureHighWaterMark && this->backpressureHighWaterMark != 0) {
+                            // The keyboard's done with this frame (it's past the 10th clock), so
+                            //  inhibiting now costs nothing but the wait.
+                            this->inhibit();
+                        }
+                    }
+                }
+                bitCounter = 0;
+                ioByte = 0;
+            }
+        }
+    };
+
+    template<int DataPin, int ClockPin, int BufferSize, typename Diagnostics>
+    Port<DataPin, ClockPin, BufferSize, Diagnostics> *Port<DataPin, ClockPin, BufferSize, Diagnostics>::instance = nullptr;
+}
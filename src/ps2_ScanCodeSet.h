@@ -17,6 +17,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
 #pragma once
+#include <stdint.h>
 
 namespace ps2 {
     enum class ScanCodeSet : uint8_t {
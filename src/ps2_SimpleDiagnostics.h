@@ -17,10 +17,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
 #pragma once
-#include <stdint.h>
+#include "ps2_Platform.h"
 #include "ps2_Keyboard.h"
 #include "ps2_KeyboardOutput.h"
-#include <util/atomic.h>
 
 namespace ps2 {
     /** \brief Used with \ref SimpleDiagnostics to control the behavior of a pin that
@@ -44,6 +43,53 @@ namespace ps2 {
         toggleLow
     };
 
+    /** \brief The event identifiers that \ref SimpleDiagnostics records.
+     *  \details Identifiers less than 16 are errors.  Applications can define their own
+     *           events starting at _firstUnusedError and _firstUnusedInfo.
+     */
+    enum class DiagnosticsCode : uint8_t {
+        packetDidNotStartWithZero = 0,
+        parityError = 1,
+        packetDidNotEndWithOne = 2,
+        packetIncomplete = 3,
+        sendFrameError = 4,
+        bufferOverflow = 5,
+        incorrectResponse = 6,
+        noResponse = 7,
+        noTranslationForKey = 8,
+        startupFailure = 9,
+        _firstUnusedError = 10,
+
+        sentByte = 16,
+        receivedByte = 17,
+        pause = 18, // Data is one byte, milliseconds+4/8 (0 to 2.043sec)
+        clockLineGlitch = 19, // data is # of bits received
+        eventsLost = 20, // data is the number of events dropped, two bytes (used by StreamingDiagnostics)
+        sendRetried = 21, // data is the byte being resent and the number of the retry
+        // Reserve a few so that more info-level events can come in without jacking up
+        // any existing readers.
+        _firstUnusedInfo = 22,
+    };
+
+    /** \brief Bit masks for the RecordedEvents parameter of \ref SimpleDiagnostics.
+     *  \details
+     *   Each event identifier has one bit in the mask; combine them with '|'.  Events whose
+     *   bit is clear are compiled out entirely.  Identifiers defined by subclasses get bits
+     *   too, either by name with \ref event or all at once with \ref applicationEvents.
+     */
+    struct DiagnosticsEvents {
+        static constexpr uint64_t event(uint8_t code) { return 1ULL << code; }
+        static constexpr uint64_t event(DiagnosticsCode code) { return 1ULL << (uint8_t)code; }
+
+        static const uint64_t errors = 0xffffULL;
+        static const uint64_t sentAndReceivedBytes = (1ULL << (uint8_t)DiagnosticsCode::sentByte) | (1ULL << (uint8_t)DiagnosticsCode::receivedByte);
+        static const uint64_t pauses = 1ULL << (uint8_t)DiagnosticsCode::pause;
+        static const uint64_t clockLineGlitches = 1ULL << (uint8_t)DiagnosticsCode::clockLineGlitch;
+        static const uint64_t sendRetries = 1ULL << (uint8_t)DiagnosticsCode::sendRetried;
+        static const uint64_t applicationEvents = ~0ULL << (uint8_t)DiagnosticsCode::_firstUnusedInfo;
+        static const uint64_t all = ~0ULL;
+    };
+
     /** \brief A basic recorder for events coming from the PS2 keyboard class library.
      *
      *  \details
@@ -100,6 +146,41 @@ namespace ps2 {
      *
      *    Note that there are a maximum of 16 error identifiers and a maximum of 48 non-error identifiers.
      *
+     *   \section Filtering Filtering Events
+     *
+     *    Recording every byte sent and received fills the queue with routine traffic and costs
+     *    time in the interrupt handler for each byte.  The RecordedEvents parameter selects which
+     *    events get recorded; the rest compile to nothing, just like \ref NullDiagnostics.  Some
+     *    typical configurations:
+     *
+     *    \code
+     *     // Errors only - the smallest and fastest.
+     *     typedef ps2::SimpleDiagnostics<32, 30, ps2::DiagnosticsEvents::errors> ErrorsOnly;
+     *
+     *     // Errors plus the keys the Ps2ToUsbKeyboardAdapter sends to the host (its own events)
+     *     typedef ps2::SimpleDiagnostics<254, 60,
+     *         ps2::DiagnosticsEvents::errors | ps2::DiagnosticsEvents::applicationEvents> ErrorsAndKeys;
+     *
+     *     // Everything (the default) - a full trace of the wire.
+     *     typedef ps2::SimpleDiagnostics<512, 60> FullTrace;
+     *    \endcode
+     *
+     *    With errors only, the receivedByte call in the read interrupt handler disappears, which
+     *    takes the ring-buffer update and the millis() call for the pause event out of every byte.
+     *    Masked-out errors are not recorded in the error bit-field either, so \ref anyErrors will
+     *    not report them.
+     *
+     *    For a keystroke as the Ps2ToUsbKeyboardAdapter sees it (a make, a break and a USB key
+     *    down and up, with a pause before each), extras/tests/DiagnosticsTest.cpp measures:
+     *
+     *        Configuration:                          ErrorsOnly  ErrorsAndKeys  FullTrace
+     *        Ring bytes per keystroke                         0              4         14
+     *        millis() calls per byte received                 0              0          1
+     *
+     *    So the 254 bytes of ErrorsAndKeys hold the last 63 keystrokes and the 512 of FullTrace
+     *    the last 36.  The avr-footprint and avr-bench build targets (see extras/avr) give the
+     *    flash, SRAM and interrupt handler cycles of each on the board itself.
+     *
      *    \section AuthorsNote Author's Note
      *     Debugging and logging are often areas where we wish we could do more, but they can be
      *     infinite pits of labor if you let them.  Further, when neglected, the rest of the project
@@ -109,8 +190,10 @@ namespace ps2 {
      *     diagnostic data interpreter.
      *
      *  \tparam Size  The number of bytes to use for recording events.
+     *  \tparam LastErrorSize  The number of bytes to use for the events leading up to the last error.
+     *  \tparam RecordedEvents  A mask built from \ref DiagnosticsEvents that selects the events to record.
      */
-    template <uint16_t Size = 60, uint16_t LastErrorSize = 30>
+    template <uint16_t Size = 60, uint16_t LastErrorSize = 30, uint64_t RecordedEvents = DiagnosticsEvents::all>
     class SimpleDiagnostics
     {
         byte data[Size];
@@ -118,36 +201,14 @@ namespace ps2 {
         uint16_t bytesInLastError = 0;
         int index = -1;
         uint16_t failureCodes = 0;
+        uint16_t errorSerialNumber = 0; // Not cleared by reset; see getErrorSerialNumber
         uint32_t millisAtLastRecording = 0;
 
-        enum class Ps2Code : uint8_t {
-            packetDidNotStartWithZero = 0,
-            parityError = 1,
-            packetDidNotEndWithOne = 2,
-            packetIncomplete = 3,
-            sendFrameError = 4,
-            bufferOverflow = 5,
-            incorrectResponse = 6,
-            noResponse = 7,
-            noTranslationForKey = 8,
-            startupFailure = 9,
-            _firstUnusedError = 10,
-
-            sentByte = 16,
-            receivedByte = 17,
-            pause = 18, // Data is one byte, milliseconds+4/8 (0 to 2.043sec)
-            clockLineGlitch = 19, // data is # of bits received
-            reserved2 = 20,
-            reserved3 = 21,
-            // Reserve a few so that more info-level events can come in without jacking up
-            // any existing readers.
-            _firstUnusedInfo = 22,
-        };
-
         void recordFailure(uint8_t code) {
             if (code < 16) {
                 ATOMIC_BLOCK(ATOMIC_FORCEON) {
                     this->failureCodes |= 1 << code;
+                    ++this->errorSerialNumber;
                 }
 
                 uint16_t numBytesCopied = 0;
@@ -203,10 +264,14 @@ namespace ps2 {
 
         void recordPause()
         {
+            if (!isRecorded((uint8_t)DiagnosticsCode::pause)) {
+                return;
+            }
+
             unsigned long millisNow = millis();
             unsigned long timeDelta = millisNow - millisAtLastRecording;
             if (timeDelta >= 4 && timeDelta < 2044) {
-                pushRaw((byte)Ps2Code::pause, (byte)((timeDelta + 4) >> 3));
+                pushRaw((byte)DiagnosticsCode::pause, (byte)((timeDelta + 4) >> 3));
                 millisAtLastRecording = millisNow;
             }
             else if (timeDelta >= 2044) {
@@ -214,30 +279,72 @@ namespace ps2 {
                 if (lowResDelay > 0xffff) {
                     lowResDelay = 0xffff;
                 }
-                pushRaw((byte)Ps2Code::pause, (byte)(lowResDelay >>8), (byte)(lowResDelay & 0xff));
+                pushRaw((byte)DiagnosticsCode::pause, (byte)(lowResDelay >>8), (byte)(lowResDelay & 0xff));
                 millisAtLastRecording = millisNow;
             }
             // Else it's too short to make note of
         }
 
     protected:
-        static const uint8_t firstUnusedFailureCode = (uint8_t)Ps2Code::_firstUnusedError;
-        static const uint8_t firstUnusedInfoCode = (uint8_t)Ps2Code::_firstUnusedInfo;
+        static const uint8_t firstUnusedFailureCode = (uint8_t)DiagnosticsCode::_firstUnusedError;
+        static const uint8_t firstUnusedInfoCode = (uint8_t)DiagnosticsCode::_firstUnusedInfo;
+
+        /** \brief True if the event is selected by RecordedEvents.  The push methods are always
+         *         called with constant codes, so this folds away at compile time.
+         */
+        static bool isRecorded(uint8_t code) {
+            return (RecordedEvents >> code) & 1;
+        }
+
+        /** \brief Returns a number that changes every time an error is recorded.  Unlike the rest
+         *         of the data, it is not cleared by \ref reset, so subclasses can use it to see
+         *         whether there's a new error to deal with.
+         */
+        uint16_t getErrorSerialNumber() const {
+            uint16_t value;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                value = this->errorSerialNumber;
+            }
+            return value;
+        }
+
+        /** \brief Copies the events leading up to the most recent error into \p target, which
+         *         must have room for LastErrorSize bytes, along with the error bit-field.
+         *  \returns The number of bytes copied.  They are in the same order that they are kept
+         *           in, which is the reverse of the order \ref sendReport prints them.
+         */
+        uint16_t copyLastError(byte *target, uint16_t &failureCodesAtLastError) const {
+            uint16_t numBytes;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                numBytes = this->bytesInLastError;
+                for (uint16_t i = 0; i < numBytes; ++i) {
+                    target[i] = this->lastError[i];
+                }
+                failureCodesAtLastError = this->failureCodes;
+            }
+            return numBytes;
+        }
 
         template <typename E>
         void push(E code) {
-            recordPause();
-            pushRaw((byte)code);
+            if (isRecorded((uint8_t)code)) {
+                recordPause();
+                pushRaw((byte)code);
+            }
         }
         template <typename E1,typename E2>
         void push(E1 code, E2 extraData1) {
-            recordPause();
-            pushRaw((byte)code, (uint8_t)extraData1);
+            if (isRecorded((uint8_t)code)) {
+                recordPause();
+                pushRaw((byte)code, (uint8_t)extraData1);
+            }
         }
         template <typename E1, typename E2, typename E3>
         void push(E1 code, E2 extraData1, E3 extraData2) {
-            recordPause();
-            pushRaw((byte)code, (byte)extraData1, (byte)extraData2);
+            if (isRecorded((uint8_t)code)) {
+                recordPause();
+                pushRaw((byte)code, (byte)extraData1, (byte)extraData2);
+            }
         }
 
     public:
@@ -316,27 +423,30 @@ namespace ps2 {
             digitalWrite(DiagnosticLedPin, value ? HIGH : LOW);
         }
 
-        void packetDidNotStartWithZero() { this->push(Ps2Code::packetDidNotStartWithZero); }
-        void parityError() { this->push(Ps2Code::parityError); }
-        void packetDidNotEndWithOne() { this->push(Ps2Code::packetDidNotEndWithOne); }
-        void packetIncomplete() { this->push(Ps2Code::packetIncomplete); }
-        void sendFrameError() { this->push(Ps2Code::sendFrameError); }
-        void bufferOverflow() { this->push(Ps2Code::bufferOverflow); }
+        void packetDidNotStartWithZero() { this->push(DiagnosticsCode::packetDidNotStartWithZero); }
+        void parityError() { this->push(DiagnosticsCode::parityError); }
+        void packetDidNotEndWithOne() { this->push(DiagnosticsCode::packetDidNotEndWithOne); }
+        void packetIncomplete() { this->push(DiagnosticsCode::packetIncomplete); }
+        void sendFrameError() { this->push(DiagnosticsCode::sendFrameError); }
+        void bufferOverflow() { this->push(DiagnosticsCode::bufferOverflow); }
         void incorrectResponse(KeyboardOutput scanCode, KeyboardOutput expectedScanCode) {
-            this->push(Ps2Code::incorrectResponse, scanCode, expectedScanCode);
+            this->push(DiagnosticsCode::incorrectResponse, scanCode, expectedScanCode);
         }
         void noResponse(KeyboardOutput expectedScanCode) {
-            this->push(Ps2Code::noResponse, expectedScanCode);
+            this->push(DiagnosticsCode::noResponse, expectedScanCode);
         }
         void noTranslationForKey(bool isExtended, KeyboardOutput code) {
-            this->push(Ps2Code::noTranslationForKey, isExtended, code);
+            this->push(DiagnosticsCode::noTranslationForKey, isExtended, code);
         }
-        void startupFailure() { this->push(Ps2Code::startupFailure); }
+        void startupFailure() { this->push(DiagnosticsCode::startupFailure); }
         void clockLineGlitch(uint8_t numBitsSent) {
-            this->push(Ps2Code::clockLineGlitch, numBitsSent);
+            this->push(DiagnosticsCode::clockLineGlitch, numBitsSent);
         }
 
-        void sentByte(byte b) { this->push(Ps2Code::sentByte, b); }
-        void receivedByte(byte b) { this->push(Ps2Code::receivedByte, b); }
+        void sentByte(byte b) { this->push(DiagnosticsCode::sentByte, b); }
+        void receivedByte(byte b) { this->push(DiagnosticsCode::receivedByte, b); }
+        void sendRetried(byte b, uint8_t retryNumber) {
+            this->push(DiagnosticsCode::sendRetried, b, retryNumber);
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,253 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include <stdint.h>
+#include <util/crc16.h>
+#include "ps2_SimpleDiagnostics.h"
+#include "ps2_DiagnosticsQueue.h"
+
+namespace ps2 {
+    /** \brief A recorder that streams events to a serial port as they happen.
+     *
+     *  \details
+     *   \ref SimpleDiagnostics is good for capturing what went wrong on a device that's out
+     *   in the world; this one is for the bench, where there's a computer at the other end of
+     *   the cable and you want to watch (or log) everything over a long soak test.
+     *
+     *   Events are encoded into a queue as they happen (including from the interrupt handlers)
+     *   and \ref drain copies as much of the queue to the target as it can take without
+     *   blocking.  If the link can't keep up, whole events are dropped and, as soon as there's
+     *   room, an eventsLost event is sent with the number that were dropped.
+     *
+     *   Each event is sent as a frame in the style of SLIP (RFC 1055):
+     *
+     *      C0 <header> <data...> <crc> C0
+     *
+     *   The header byte has the event ID (see \ref DiagnosticsCode) in the upper six bits and
+     *   the number of data bytes in the lower two, just like \ref SimpleDiagnostics.  The crc
+     *   is the Dallas/iButton CRC8 of the header and data.  Within a frame, C0 is sent as DB DC
+     *   and DB is sent as DB DD, so a receiver that joins mid-stream (or sees a corrupt frame)
+     *   can always resynchronize at the next C0.  The extras/StreamingDiagnosticsReceiver.py
+     *   script decodes the stream on the host side.
+     *
+     *   A typical receivedByte frame is 5 bytes, so a 1Mbaud link (100,000 bytes per second)
+     *   can carry around 19,500 events per second without losing any - more than ten times what
+     *   a keyboard can produce.  At 115200 baud it's about 2,200, which is still enough for a
+     *   full trace.  Pushed well past that, it still gets about 16,500 a second through at
+     *   1Mbaud, with the rest counted as lost.  extras/tests/DiagnosticsTest.cpp checks these
+     *   figures against the simulated serial port in extras/host.
+     *
+     *  \code
+     *   typedef ps2::StreamingDiagnostics<> Diagnostics;
+     *   static Diagnostics diagnostics;
+     *   static ps2::Keyboard<4,2,16,Diagnostics> ps2Keyboard(diagnostics);
+     *
+     *   void setup() {
+     *     Serial.begin(1000000);
+     *     ps2Keyboard.begin();
+     *   }
+     *
+     *   void loop() {
+     *     diagnostics.drain(Serial);
+     *     ...
+     *   }
+     *  \endcode
+     *
+     *   Like \ref SimpleDiagnostics, it can be subclassed to add application events, and the
+     *   RecordedEvents parameter compiles out the events you don't want to see.
+     *
+     *  \tparam QueueSize  The number of bytes to hold between calls to drain.
+     *  \tparam RecordedEvents  A mask built from \ref DiagnosticsEvents.
+     */
+    template <uint16_t QueueSize = 64, uint64_t RecordedEvents = DiagnosticsEvents::all>
+    class StreamingDiagnostics
+    {
+        static const byte frameEnd = 0xc0;
+        static const byte frameEscape = 0xdb;
+        static const byte escapedFrameEnd = 0xdc;
+        static const byte escapedFrameEscape = 0xdd;
+
+        // The worst case: two delimiters plus a header, two data bytes and a CRC, all escaped.
+        static const uint8_t maxFrameSize = 2 + 2 * 4;
+
+        DiagnosticsQueue<QueueSize> queue;
+        uint16_t eventsLost = 0;
+        uint16_t failureCodes = 0;
+
+        static_assert(QueueSize >= 2 * maxFrameSize, "The queue must be able to hold at least two events");
+
+        // Once events are being dropped, they go on being dropped until the queue is half
+        //  empty.  Starting again as soon as there's room for one would send an eventsLost
+        //  marker for every event or two, and the markers would take up half the link.
+        static const uint16_t roomToResume = QueueSize / 2 > 2 * maxFrameSize ? QueueSize / 2 : 2 * maxFrameSize;
+
+        // Must be called with interrupts off.
+        bool sendEventsLost() {
+            if (this->queue.room() < roomToResume) {
+                return false;
+            }
+            this->enqueueFrame((byte)DiagnosticsCode::eventsLost, 2, this->eventsLost >> 8, this->eventsLost & 0xff);
+            this->eventsLost = 0;
+            return true;
+        }
+
+        void enqueueEscaped(byte b) {
+            if (b == frameEnd) {
+                this->queue.push(frameEscape);
+                this->queue.push(escapedFrameEnd);
+            }
+            else if (b == frameEscape) {
+                this->queue.push(frameEscape);
+                this->queue.push(escapedFrameEscape);
+            }
+            else {
+                this->queue.push(b);
+            }
+        }
+
+        void enqueueFrame(byte code, uint8_t numData, byte data1, byte data2) {
+            byte header = (code << 2) | numData;
+            uint8_t crc = _crc_ibutton_update(0, header);
+            this->queue.push(frameEnd);
+            this->enqueueEscaped(header);
+            if (numData > 0) {
+                crc = _crc_ibutton_update(crc, data1);
+                this->enqueueEscaped(data1);
+            }
+            if (numData > 1) {
+                crc = _crc_ibutton_update(crc, data2);
+                this->enqueueEscaped(data2);
+            }
+            this->enqueueEscaped(crc);
+            this->queue.push(frameEnd);
+        }
+
+        void pushRaw(byte code, uint8_t numData, byte data1, byte data2) {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                if (code < 16) {
+                    this->failureCodes |= 1 << code;
+                }
+
+                // Room is checked for the worst case rather than the actual encoded size, which
+                //  is simpler and only matters when the queue is nearly full anyway.
+                if (this->eventsLost != 0 && !this->sendEventsLost()) {
+                    if (this->eventsLost != 0xffff) {
+                        ++this->eventsLost;
+                    }
+                    return;
+                }
+
+                if (this->queue.room() < maxFrameSize) {
+                    this->eventsLost = 1;
+                    return;
+                }
+                this->enqueueFrame(code, numData, data1, data2);
+            }
+        }
+
+    protected:
+        static const uint8_t firstUnusedFailureCode = (uint8_t)DiagnosticsCode::_firstUnusedError;
+        static const uint8_t firstUnusedInfoCode = (uint8_t)DiagnosticsCode::_firstUnusedInfo;
+
+        static bool isRecorded(uint8_t code) {
+            return (RecordedEvents >> code) & 1;
+        }
+
+        template <typename E>
+        void push(E code) {
+            if (isRecorded((uint8_t)code)) {
+                this->pushRaw((byte)code, 0, 0, 0);
+            }
+        }
+        template <typename E1, typename E2>
+        void push(E1 code, E2 extraData1) {
+            if (isRecorded((uint8_t)code)) {
+                this->pushRaw((byte)code, 1, (byte)extraData1, 0);
+            }
+        }
+        template <typename E1, typename E2, typename E3>
+        void push(E1 code, E2 extraData1, E3 extraData2) {
+            if (isRecorded((uint8_t)code)) {
+                this->pushRaw((byte)code, 2, (byte)extraData1, (byte)extraData2);
+            }
+        }
+
+    public:
+        /** \brief Sends as much of the queued data as the target can take without blocking.
+         *  \details Call this from loop().  The target must implement availableForWrite, as
+         *           HardwareSerial and the USB Serial class do.
+         */
+        template <typename Target>
+        void drain(Target &target) {
+            this->queue.drain(target);
+
+            // The events that were lost get reported even if nothing else happens.
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                if (this->eventsLost != 0) {
+                    this->sendEventsLost();
+                }
+            }
+        }
+
+        /** \brief Returns true if any errors have been recorded since the last call to \ref reset. */
+        bool anyErrors() const { return this->failureCodes != 0; }
+
+        /** \brief Discards anything that hasn't been sent yet and clears the error flags. */
+        void reset() {
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                this->queue.clear();
+                this->eventsLost = 0;
+                this->failureCodes = 0;
+            }
+        }
+
+        void packetDidNotStartWithZero() { this->push(DiagnosticsCode::packetDidNotStartWithZero); }
+        void parityError() { this->push(DiagnosticsCode::parityError); }
+        void packetDidNotEndWithOne() { this->push(DiagnosticsCode::packetDidNotEndWithOne); }
+        void packetIncomplete() { this->push(DiagnosticsCode::packetIncomplete); }
+        void sendFrameError() { this->push(DiagnosticsCode::sendFrameError); }
+        void bufferOverflow() { this->push(DiagnosticsCode::bufferOverflow); }
+        void incorrectResponse(KeyboardOutput scanCode, KeyboardOutput expectedScanCode) {
+            this->push(DiagnosticsCode::incorrectResponse, scanCode, expectedScanCode);
+        }
+        void noResponse(KeyboardOutput expectedScanCode) {
+            this->push(DiagnosticsCode::noResponse, expectedScanCode);
+        }
+        void noTranslationForKey(bool isExtended, KeyboardOutput code) {
+            this->push(DiagnosticsCode::noTranslationForKey, isExtended, code);
+        }
+        void startupFailure() { this->push(DiagnosticsCode::startupFailure); }
+        void clockLineGlitch(uint8_t numBitsSent) {
+            this->push(DiagnosticsCode::clockLineGlitch, numBitsSent);
+        }
+
+        void sentByte(byte b) { this->push(DiagnosticsCode::sentByte, b); }
+        void receivedByte(byte b) { this->push(DiagnosticsCode::receivedByte, b); }
+        void dequeuedByte(byte b) {}
+        void sendRetried(byte b, uint8_t retryNumber) {
+            this->push(DiagnosticsCode::sendRetried, b, retryNumber);
+        }
+
+        void readInterruptStarted() {}
+        void readInterruptCompleted() {}
+        void writeInterruptStarted() {}
+        void writeInterruptCompleted() {}
+        void bufferDepth(uint8_t numBytesQueued) {}
+    };
+}
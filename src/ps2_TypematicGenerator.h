@@ -0,0 +1,286 @@
+/*
+Copyright (C) 2017 Steve Benz <s8878992@hotmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+#pragma once
+#include "ps2_Platform.h"
+#include "ps2_KeyboardOutput.h"
+#include "ps2_TypematicRate.h"
+#include "ps2_TypematicStartDelay.h"
+
+namespace ps2 {
+    /** \brief Repeats held keys in software, instead of having the keyboard do it.
+     *
+     *  \details
+     *   When the keyboard does typematic itself, every repeat is a byte (two for extended
+     *   keys) on the wire, and each of those costs 11 clock interrupts plus a trip through
+     *   the input buffer.  At 30 characters per second, that's up to 660 interrupts a
+     *   second for as long as the key is held.  This class watches the scan codes on their
+     *   way from \ref Keyboard::readScanCode to your translator and, when a key has been
+     *   held long enough, inserts the repeats itself.  The cost is a single timer check per
+     *   call to \ref process while a key is down, and nothing at all on the wire.
+     *   extras/tests/TypematicTest counts the interrupts against a simulated keyboard:
+     *   holding a key for two seconds takes 605 with the keyboard repeating it and 11 (just
+     *   the make) with this class.  Multiply the difference by the cycles the avr-bench
+     *   target reports for the read interrupt to get the time saved on a given board.
+     *
+     *   Since the repeats are generated by the library, they aren't limited to the rates
+     *   in \ref TypematicRate - any delay and interval can be used, and the interval can
+     *   shrink with each repeat (see \ref setAcceleration).
+     *
+     *   As with the keyboard's own typematic, only the last key pressed repeats, and it
+     *   stops when that key is released.  Makes of the held key that come from the keyboard
+     *   (that is, its own typematic) are dropped, so repeats don't double up.  This matters
+     *   in scan code set 2: keyboards only honor \ref Keyboard::disableTypematic in set 3,
+     *   so in set 2, use \ref Keyboard::setTypematicRateAndDelay to set the slowest rate and
+     *   the longest delay to keep the traffic to a minimum.
+     *
+     *   Repeats come back the same way the keyboard would have sent them (e.g. extend
+     *   followed by the key's code), so translators can't tell the difference.
+     *
+     *  \code
+     *   ps2::Keyboard<4,2> ps2Keyboard;
+     *   ps2::TypematicGenerator typematic;
+     *   ps2::UsbTranslator<> keyMapping;
+     *
+     *   void setup() {
+     *     ps2Keyboard.begin();
+     *     ps2Keyboard.setTypematicRateAndDelay(ps2::TypematicRate::slowestRate, ps2::TypematicStartDelay::longestDelay);
+     *     typematic.setRateAndDelay(ps2::TypematicRate::_20_7_cps, ps2::TypematicStartDelay::_0_25_sec);
+     *     typematic.setAcceleration(20, 2);
+     *   }
+     *
+     *   void loop() {
+     *     ps2::KeyboardOutput scanCode = typematic.process(ps2Keyboard.readScanCode());
+     *     if (scanCode != ps2::KeyboardOutput::none) {
+     *       ps2::UsbKeyAction action = keyMapping.translatePs2Keycode(scanCode);
+     *       ...
+     *     }
+     *  \endcode
+     */
+    class TypematicGenerator
+    {
+        static const uint8_t outputSize = 4;
+
+        uint16_t delayMilliseconds;
+        uint16_t startIntervalMilliseconds;
+        uint16_t fastestIntervalMilliseconds;
+        uint16_t accelerationMilliseconds = 0;
+
+        KeyboardOutput heldKey = KeyboardOutput::none;
+        bool isHeldKeyExtended = false;
+        uint32_t lastRepeatMilliseconds;
+        uint16_t waitMilliseconds;
+        uint16_t intervalMilliseconds;
+
+        bool isExtended = false;
+        bool isExtendWithheld = false;
+        bool isUnmake = false;
+        uint8_t pauseBytesRemaining = 0;
+
+        KeyboardOutput output[outputSize];
+        uint8_t outputCount = 0;
+
+        void push(KeyboardOutput code) {
+            if (this->outputCount < outputSize) {
+                this->output[this->outputCount++] = code;
+            }
+        }
+
+        KeyboardOutput pop() {
+            if (this->outputCount == 0) {
+                return KeyboardOutput::none;
+            }
+            KeyboardOutput code = this->output[0];
+            --this->outputCount;
+            for (uint8_t i = 0; i < this->outputCount; ++i) {
+                this->output[i] = this->output[i + 1];
+            }
+            return code;
+        }
+
+        void observe(KeyboardOutput code) {
+            if (code == KeyboardOutput::garbled) {
+                this->stop();
+                this->push(code);
+                return;
+            }
+
+            if (this->pauseBytesRemaining > 0) {
+                // The pause key has no break and doesn't repeat; just let its sequence by.
+                --this->pauseBytesRemaining;
+                this->push(code);
+                return;
+            }
+
+            switch (code) {
+            case KeyboardOutput::extend1:
+                this->pauseBytesRemaining = 7;
+                this->push(code);
+                break;
+            case KeyboardOutput::extend:
+                // Held back until we know whether the code that follows is a repeat we drop.
+                this->isExtended = true;
+                this->isExtendWithheld = true;
+                break;
+            case KeyboardOutput::unmake:
+                if (this->isExtendWithheld) {
+                    this->push(KeyboardOutput::extend);
+                    this->isExtendWithheld = false;
+                }
+                this->push(code);
+                this->isUnmake = true;
+                break;
+            default: {
+                bool isHeldKey = code == this->heldKey && this->isExtended == this->isHeldKeyExtended;
+                if (this->isUnmake) {
+                    if (isHeldKey) {
+                        this->heldKey = KeyboardOutput::none;
+                    }
+                }
+                else if (!isHeldKey) {
+                    this->heldKey = code;
+                    this->isHeldKeyExtended = this->isExtended;
+                    this->lastRepeatMilliseconds = millis();
+                    this->waitMilliseconds = this->delayMilliseconds;
+                    this->intervalMilliseconds = this->startIntervalMilliseconds;
+                }
+
+                if (this->isUnmake || !isHeldKey) {
+                    if (this->isExtendWithheld) {
+                        this->push(KeyboardOutput::extend);
+                    }
+                    this->push(code);
+                }
+                this->isExtended = false;
+                this->isExtendWithheld = false;
+                this->isUnmake = false;
+                break;
+            }
+            }
+        }
+
+        void stop() {
+            this->heldKey = KeyboardOutput::none;
+            this->isExtended = false;
+            this->isExtendWithheld = false;
+            this->isUnmake = false;
+            this->pauseBytesRemaining = 0;
+        }
+
+        void repeatIfDue() {
+            if (this->heldKey == KeyboardOutput::none
+             || this->isExtended || this->isUnmake || this->pauseBytesRemaining > 0) {
+                return;
+            }
+
+            uint32_t now = millis();
+            if (now - this->lastRepeatMilliseconds < this->waitMilliseconds) {
+                return;
+            }
+
+            if (this->isHeldKeyExtended) {
+                this->push(KeyboardOutput::extend);
+            }
+            this->push(this->heldKey);
+
+            this->lastRepeatMilliseconds = now;
+            this->waitMilliseconds = this->intervalMilliseconds;
+            if (this->intervalMilliseconds >= this->fastestIntervalMilliseconds + this->accelerationMilliseconds) {
+                this->intervalMilliseconds -= this->accelerationMilliseconds;
+            }
+            else {
+                this->intervalMilliseconds = this->fastestIntervalMilliseconds;
+            }
+        }
+
+    public:
+        /** \brief Creates a generator that repeats at the keyboard's default rate and delay. */
+        TypematicGenerator() {
+            this->setRateAndDelay(TypematicRate::defaultRate, TypematicStartDelay::defaultDelay);
+        }
+
+        /** \brief Creates a generator with the given delay and interval between repeats. */
+        TypematicGenerator(uint16_t delayMilliseconds, uint16_t intervalMilliseconds) {
+            this->setRateAndDelay(delayMilliseconds, intervalMilliseconds);
+        }
+
+        /** \brief Returns the time between repeats, in milliseconds, for a keyboard rate. */
+        static uint16_t toMilliseconds(TypematicRate rate) {
+            uint8_t r = (uint8_t)rate;
+            return (uint16_t)((((uint32_t)(8 + (r & 7)) << (r >> 3)) * 417 + 50) / 100);
+        }
+
+        /** \brief Returns the time before the first repeat, in milliseconds, for a keyboard delay. */
+        static uint16_t toMilliseconds(TypematicStartDelay startDelay) {
+            return ((uint16_t)startDelay + 1) * 250;
+        }
+
+        /** \brief Sets the time a key has to be held before it repeats and the time between
+         *         repeats after that.  Turns off acceleration.
+         */
+        void setRateAndDelay(uint16_t delayMilliseconds, uint16_t intervalMilliseconds) {
+            this->delayMilliseconds = delayMilliseconds;
+            this->startIntervalMilliseconds = intervalMilliseconds;
+            this->fastestIntervalMilliseconds = intervalMilliseconds;
+            this->accelerationMilliseconds = 0;
+        }
+
+        /** \brief Sets the rate and delay with the same values the keyboard accepts.
+         *         Turns off acceleration.
+         */
+        void setRateAndDelay(TypematicRate rate, TypematicStartDelay startDelay) {
+            this->setRateAndDelay(toMilliseconds(startDelay), toMilliseconds(rate));
+        }
+
+        /** \brief Makes repeats speed up the longer a key is held.
+         *  \details After each repeat, the time to the next one shrinks by stepMilliseconds,
+         *           until it gets down to fastestIntervalMilliseconds.  Call this after
+         *           \ref setRateAndDelay, which sets the starting interval.
+         *  \param fastestIntervalMilliseconds The shortest time between repeats.
+         *  \param stepMilliseconds How much shorter each interval is than the last.
+         */
+        void setAcceleration(uint16_t fastestIntervalMilliseconds, uint16_t stepMilliseconds) {
+            this->fastestIntervalMilliseconds = fastestIntervalMilliseconds < this->startIntervalMilliseconds
+                ? fastestIntervalMilliseconds : this->startIntervalMilliseconds;
+            this->accelerationMilliseconds = stepMilliseconds;
+        }
+
+        /** \brief Passes a scan code through, inserting repeats of the held key when they're due.
+         *  \details Call this once per loop() with the result of \ref Keyboard::readScanCode,
+         *           even when that's \ref KeyboardOutput::none - that's when repeats are
+         *           inserted.  Codes may come back a call or two later than they went in,
+         *           but they always come back in order.  A garbled code stops any repeat.
+         *  \returns The next scan code to translate, or \ref KeyboardOutput::none.
+         */
+        KeyboardOutput process(KeyboardOutput scanCode) {
+            if (scanCode != KeyboardOutput::none) {
+                this->observe(scanCode);
+            }
+            else if (this->outputCount == 0) {
+                this->repeatIfDue();
+            }
+            return this->pop();
+        }
+
+        /** \brief Stops repeating the held key, e.g. when a translator has been reset. */
+        void reset() {
+            this->stop();
+            this->outputCount = 0;
+        }
+    };
+}
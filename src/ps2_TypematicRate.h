@@ -17,8 +17,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 USA
 */
 #pragma once
+#include <stdint.h>
 
 namespace ps2 {
+    /** \brief The rates at which the keyboard repeats a held key, in characters per second.
+     *  \details The time between repeats is (8 + (rate & 7)) * 2^(rate >> 3) * 4.17ms.
+     */
     enum class TypematicRate : uint8_t {
         fastestRate = 0x00,
         slowestRate = 0x1f,
@@ -28,10 +32,33 @@ namespace ps2 {
         _26_7_cps = 0x01,
         _24_0_cps = 0x02,
         _21_8_cps = 0x03,
+        _20_7_cps = 0x04,
+        _18_5_cps = 0x05,
+        _17_1_cps = 0x06,
+        _16_0_cps = 0x07,
+        _15_0_cps = 0x08,
+        _13_3_cps = 0x09,
+        _12_0_cps = 0x0a,
         _10_9_cps = 0x0b,
+        _10_0_cps = 0x0c,
+        _09_2_cps = 0x0d,
+        _08_6_cps = 0x0e,
+        _08_0_cps = 0x0f,
+        _07_5_cps = 0x10,
+        _06_7_cps = 0x11,
+        _06_0_cps = 0x12,
+        _05_5_cps = 0x13,
+        _05_0_cps = 0x14,
+        _04_6_cps = 0x15,
+        _04_3_cps = 0x16,
+        _04_0_cps = 0x17,
+        _03_7_cps = 0x18,
+        _03_3_cps = 0x19,
+        _03_0_cps = 0x1a,
+        _02_7_cps = 0x1b,
+        _02_5_cps = 0x1c,
         _02_3_cps = 0x1d,
         _02_1_cps = 0x1e,
         _02_0_cps = 0x1f,
-        // ... fill this the rest of the way if you care
     };
 }
\ No newline at end of file
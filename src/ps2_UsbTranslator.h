@@ -18,6 +18,8 @@ USA
 */
 #pragma once
 
+#include "ps2_Platform.h"
+#include "ps2_NullDiagnostics.h"
 #include "ps2_KeyboardLeds.h"
 #include "ps2_KeyboardOutput.h"
 
@@ -55,6 +57,8 @@ namespace ps2 {
         UsbTranslator(Diagnostics &diagnostics);
 
         /**  \brief causes it to forget about any scan codes that it has recorded so far and start fresh.
+         *   Call this when \ref Keyboard::readScanCode returns garbled, as a byte of a multi-byte
+         *   sequence may have been lost.
          */
         void reset();
 
@@ -71,7 +75,7 @@ namespace ps2 {
     private:
         bool isSpecial;
         bool isUnmake;
-        int pauseKeySequenceIndex;
+        uint8_t pauseKeySequenceIndex;
         Diagnostics *diagnostics;
     };
 }
@@ -20,12 +20,10 @@ USA
 
 // These translation tables were distilled from here:
 //  http://download.microsoft.com/download/1/6/1/161ba512-40e2-4cc9-843a-923143f3456c/translate.pdf
-// They could certainly be ProgMem, but it's unlikely to matter to anybody,
-// as if you're implementing a PS2->USB conversion on your Arduino, it's
-// unlikely you'll be doing anything else that requires a ton of space,
-// so we'll keep it simple.
+// They live in flash because together they're about 260 bytes, which is more than a tenth
+// of the SRAM on an ATmega32u4.
 
-/*PROGMEM*/ const byte ps2ToUsbMap[] = {
+const byte ps2ToUsbMap[] PROGMEM = {
     0x00, // [00] unused
     0x42, // [01] F9
     0x00, // [02] unused
@@ -161,7 +159,7 @@ USA
 };
 
 // This would probably be tighter as a switch statement.
-/*PROGMEM*/ const byte extPs2ToUsbMap[] = {
+const byte extPs2ToUsbMap[] PROGMEM = {
     0x00, // [00] unused
     0x00, // [01] unused
     0x00, // [02] unused
@@ -292,7 +290,7 @@ USA
     0x00, // [7f] unused
 };
 
-static const byte pauseKeySequence[] {
+static const byte pauseKeySequence[] PROGMEM {
     0xe1, 0x14, 0x77
     //0xe1, 0xfc, 0x00, 0x04, 0x14, 0x77
 };
@@ -310,6 +308,7 @@ template <typename Diagnostics>
 void ps2::UsbTranslator<Diagnostics>::reset() {
     isSpecial = false;
     isUnmake = false;
+    pauseKeySequenceIndex = 0;
 }
 
 template <typename Diagnostics>
@@ -335,7 +334,10 @@ ps2::UsbKeyAction ps2::UsbTranslator<Diagnostics>::translatePs2Keycode(ps2::Keyb
 
     if (ps2Scan == ps2::KeyboardOutput::extend)
     {
+        // The Pause sequence never contains an extend, so if we were part-way through
+        //  matching it, that was garbage.
         this->isSpecial = true;
+        this->pauseKeySequenceIndex = 0;
         return action;
     }
 
@@ -348,7 +350,7 @@ ps2::UsbKeyAction ps2::UsbTranslator<Diagnostics>::translatePs2Keycode(ps2::Keyb
     }
 
     byte usbCode = 0;
-    if ((uint8_t)ps2Scan == pauseKeySequence[pauseKeySequenceIndex]) {
+    if ((uint8_t)ps2Scan == pgm_read_byte(pauseKeySequence + pauseKeySequenceIndex)) {
         ++pauseKeySequenceIndex;
         if (pauseKeySequenceIndex < sizeof(pauseKeySequence))
             return action;
@@ -357,11 +359,11 @@ ps2::UsbKeyAction ps2::UsbTranslator<Diagnostics>::translatePs2Keycode(ps2::Keyb
     }
     else if (this->isSpecial)
     {
-        usbCode = (uint8_t)ps2Scan < sizeof(extPs2ToUsbMap) ? extPs2ToUsbMap[(uint8_t)ps2Scan] : 0;
+        usbCode = (uint8_t)ps2Scan < sizeof(extPs2ToUsbMap) ? pgm_read_byte(extPs2ToUsbMap + (uint8_t)ps2Scan) : 0;
     }
     else
     {
-        usbCode = (uint8_t)ps2Scan < sizeof(ps2ToUsbMap) ? ps2ToUsbMap[(uint8_t)ps2Scan] : 0;
+        usbCode = (uint8_t)ps2Scan < sizeof(ps2ToUsbMap) ? pgm_read_byte(ps2ToUsbMap + (uint8_t)ps2Scan) : 0;
     }
     pauseKeySequenceIndex = 0;
 